@@ -0,0 +1,124 @@
+#include "PPU.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <vector>
+
+/**
+ * Microbenchmark of the Pixel FIFO's ring buffer (PPU::PixelRing) against the std::queue<uint32_t> it replaced, on
+ * the pattern of the pixel fetcher: 8 pixels pushed per tile whenever the FIFO holds 8 or fewer, one pixel popped to
+ * the video buffer per dot otherwise, and the pixels left over drained at the end of each scanline. The queue holds
+ * ARGB colors, converted when pushed, while the ring buffer holds color indices, converted when popped. Both must
+ * produce the same frame.
+ *
+ * Build with -DSTOICGB_BENCHMARKS=ON -DCMAKE_BUILD_TYPE=Release and run ./stoicgb_fifo_bench [frames].
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int WIDTH = 160;
+static constexpr int LINES = 144;
+static constexpr int TILES = WIDTH / 8 + 1; // The fetcher is a tile ahead of the pixels pushed to the video buffer
+
+using Palettes = std::array<std::array<uint32_t, 4>, 3>; // BGP, OBP0, OBP1 (see LCD::updatePalette)
+using Frame    = std::vector<uint32_t>;
+
+/**
+ * Pixels fetched for every scanline of a frame, as the fetcher would mix them from the BG/W and sprite tiles.
+ */
+static std::vector<PPU::FIFOPixel> makeFetched() {
+    std::mt19937 random(0xF1F0);
+    std::vector<PPU::FIFOPixel> fetched(LINES * TILES * 8);
+    for (PPU::FIFOPixel& pixel : fetched) {
+        uint32_t bits = random();
+        pixel.colorIdx = bits & 3;
+        pixel.palette  = (bits >> 2) % 3;
+    }
+    return fetched;
+}
+
+/**
+ * Draws a frame through the std::queue FIFO, as before the ring buffer.
+ */
+static void drawWithQueue(const std::vector<PPU::FIFOPixel>& fetched, const Palettes& palettes, Frame& frame) {
+    std::queue<uint32_t> fifo;
+    for (int ly = 0; ly < LINES; ly++) {
+        const PPU::FIFOPixel* tile = &fetched[ly * TILES * 8];
+        uint32_t*             line = &frame[ly * WIDTH];
+        int                   x    = 0;
+        while (x < WIDTH) {
+            if (fifo.size() <= 8) {
+                for (int i = 0; i < 8; i++, tile++)
+                    fifo.push(palettes[tile->palette][tile->colorIdx]);
+            } else {
+                line[x++] = fifo.front();
+                fifo.pop();
+            }
+        }
+        while (!fifo.empty())
+            fifo.pop();
+    }
+}
+
+/**
+ * Draws a frame through the ring buffer, as PPU::runPixelFIFO does.
+ */
+static void drawWithRing(const std::vector<PPU::FIFOPixel>& fetched, const Palettes& palettes, Frame& frame) {
+    PPU::PixelRing fifo;
+    for (int ly = 0; ly < LINES; ly++) {
+        const PPU::FIFOPixel* tile = &fetched[ly * TILES * 8];
+        uint32_t*             line = &frame[ly * WIDTH];
+        int                   x    = 0;
+        while (x < WIDTH) {
+            if (fifo.size() <= 8) {
+                for (int i = 0; i < 8; i++, tile++)
+                    fifo.push(*tile);
+            } else {
+                PPU::FIFOPixel pixel = fifo.pop();
+                line[x++] = palettes[pixel.palette][pixel.colorIdx];
+            }
+        }
+        fifo.clear();
+    }
+}
+
+/**
+ * @return The average time to draw a frame with 'draw', in microseconds.
+ */
+template<typename Draw>
+static double measure(int frames, Draw draw) {
+    auto start = Clock::now();
+    for (int i = 0; i < frames; i++)
+        draw();
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+}
+
+int main(int argc, char* argv[]) {
+    int frames = argc > 1 ? std::atoi(argv[1]) : 2000;
+    if (frames <= 0)
+        frames = 2000;
+
+    const std::vector<PPU::FIFOPixel> fetched = makeFetched();
+    const Palettes palettes = {{
+        { 0xFFE0F8D0, 0xFF88C070, 0xFF346856, 0xFF081820 },
+        { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 },
+        { 0xFFFFEFCE, 0xFFDE944A, 0xFFAD2921, 0xFF311852 },
+    }};
+
+    // Draw a frame with each first, to warm up the caches and compare the frames.
+    Frame queueFrame(WIDTH * LINES), ringFrame(WIDTH * LINES);
+    drawWithQueue(fetched, palettes, queueFrame);
+    drawWithRing(fetched, palettes, ringFrame);
+    bool match = queueFrame == ringFrame;
+
+    double queueTime = measure(frames, [&] { drawWithQueue(fetched, palettes, queueFrame); });
+    double ringTime  = measure(frames, [&] { drawWithRing(fetched, palettes, ringFrame); });
+
+    printf("%-16s %8.2f us per frame\n", "std::queue", queueTime);
+    printf("%-16s %8.2f us per frame (%4.2fx)%s\n", "PPU::PixelRing", ringTime, queueTime / ringTime,
+           match ? "" : "  OUTPUT MISMATCH");
+    return match ? 0 : 1;
+}
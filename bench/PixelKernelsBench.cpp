@@ -0,0 +1,111 @@
+#include "PixelKernels.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+/**
+ * Microbenchmark of the pixel kernels (see PixelKernels.hpp): runs every implementation the CPU supports on the same
+ * workloads, checks that they produce the same output as the scalar kernels, and reports their speed.
+ *
+ * - decodeRow:    all the rows of the 384 tiles of VRAM, as the tile cache decodes them after VRAM writes.
+ * - applyPalette: 144 scanlines of 160 pixels, as the scanline renderer converts a frame.
+ *
+ * Build with -DSTOICGB_BENCHMARKS=ON -DCMAKE_BUILD_TYPE=Release and run ./stoicgb_kernels_bench [repetitions].
+ */
+
+using Clock          = std::chrono::steady_clock;
+using Implementation = PixelKernels::Implementation;
+
+static constexpr size_t TILE_ROWS = 384 * 8;   // Rows of the tiles in VRAM
+static constexpr size_t PIXELS    = 160 * 144; // Pixels of a frame
+
+struct Workload {
+    std::vector<uint8_t>  tileData;  // 2 bytes per row
+    std::vector<uint8_t>  indices;   // Color indices of a frame
+    PixelKernels::Palette palette = { 0xFFE0F8D0, 0xFF88C070, 0xFF346856, 0xFF081820 };
+};
+
+struct Output {
+    std::vector<uint8_t>  decoded = std::vector<uint8_t>(TILE_ROWS * 8);
+    std::vector<uint32_t> colors  = std::vector<uint32_t>(PIXELS);
+};
+
+/**
+ * Runs both kernels over the workload once.
+ */
+static void run(const Workload& work, Output& out, bool xFlip) {
+    for (size_t row = 0; row < TILE_ROWS; row++)
+        PixelKernels::decodeRow(work.tileData[2 * row], work.tileData[2 * row + 1], &out.decoded[8 * row], xFlip);
+    for (size_t line = 0; line < PIXELS; line += 160)
+        PixelKernels::applyPalette(&work.indices[line], 160, work.palette, &out.colors[line]);
+}
+
+/**
+ * @return The average time of a repetition of 'kernel', in microseconds.
+ */
+template<typename Kernel>
+static double measure(int repetitions, Kernel kernel) {
+    auto start = Clock::now();
+    for (int i = 0; i < repetitions; i++)
+        kernel();
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / repetitions;
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = argc > 1 ? std::atoi(argv[1]) : 2000;
+    if (repetitions <= 0)
+        repetitions = 2000;
+
+    Workload work;
+    std::mt19937 random(0x5701C);
+    work.tileData.resize(TILE_ROWS * 2);
+    work.indices.resize(PIXELS);
+    for (uint8_t& byte : work.tileData)
+        byte = static_cast<uint8_t>(random());
+    for (uint8_t& index : work.indices)
+        index = static_cast<uint8_t>(random() & 3);
+
+    // Reference output of the scalar kernels.
+    Output expected, expectedFlipped;
+    PixelKernels::use(Implementation::scalar);
+    run(work, expected, false);
+    run(work, expectedFlipped, true);
+
+    printf("%-8s %20s %24s\n", "kernels", "decodeRow (384 tiles)", "applyPalette (1 frame)");
+    double scalarDecode = 0, scalarPalette = 0;
+    bool   allMatch     = true;
+    for (auto impl : { Implementation::scalar, Implementation::sse2, Implementation::avx2 }) {
+        if (!PixelKernels::use(impl)) {
+            printf("%-8s %20s %24s\n", PixelKernels::name(impl), "unsupported", "unsupported");
+            continue;
+        }
+
+        Output out, outFlipped;
+        run(work, out, false);
+        run(work, outFlipped, true);
+        bool match = out.decoded == expected.decoded && outFlipped.decoded == expectedFlipped.decoded
+                  && out.colors == expected.colors;
+        allMatch &= match;
+
+        double decode = measure(repetitions, [&] {
+            for (size_t row = 0; row < TILE_ROWS; row++)
+                PixelKernels::decodeRow(work.tileData[2 * row], work.tileData[2 * row + 1], &out.decoded[8 * row]);
+        });
+        double palette = measure(repetitions, [&] {
+            for (size_t line = 0; line < PIXELS; line += 160)
+                PixelKernels::applyPalette(&work.indices[line], 160, work.palette, &out.colors[line]);
+        });
+        if (impl == Implementation::scalar) {
+            scalarDecode  = decode;
+            scalarPalette = palette;
+        }
+
+        printf("%-8s %11.2f us (%4.2fx) %15.2f us (%4.2fx)%s\n", PixelKernels::name(impl), decode,
+               scalarDecode / decode, palette, scalarPalette / palette, match ? "" : "  OUTPUT MISMATCH");
+    }
+
+    return allMatch ? 0 : 1;
+}
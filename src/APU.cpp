@@ -1,39 +1,56 @@
 #include "APU.hpp"
-
-APU::APU()
-: audioBuffer(SAMPLE_SIZE, 0) {
+#include <algorithm>
+
+APU::APU(Scheduler* s)
+: leftBuffer()
+, rightBuffer()
+, audioBuffer()
+, audioRing()
+, scheduler(s) {
     // Needs access to APU members.
     pulseChannel1.apu = this;
     pulseChannel2.apu = this;
     waveChannel.apu   = this;
     noiseChannel.apu  = this;
 
+    pulseChannel1.id = 0;
+    pulseChannel2.id = 1;
+
     // When length == 0, NR52's respective channel length status bit is set cleared.
     pulseChannel1.statusBitNR52 = 1 << 0;
     pulseChannel2.statusBitNR52 = 1 << 1;
     waveChannel.statusBitNR52   = 1 << 2;
     noiseChannel.statusBitNR52  = 1 << 3;
 
-    // Reserve space in the audio buffer to improve performance by avoiding reallocations
-    audioBuffer.reserve(SAMPLE_SIZE);
-
     // Initialize SDL audio specifications
     SDL_AudioSpec audioSpec;
     audioSpec.freq     = AUDIO_SAMPLE_RATE; // 44100 Hz
     audioSpec.format   = AUDIO_F32SYS;      // Floating point, system byte order
     audioSpec.channels = 2;                 // Stereo
-    audioSpec.samples  = SAMPLE_SIZE;       // Number of samples for the audio buffer (might need to be tweaked)
-    audioSpec.callback = nullptr;           // No callback function used, audio is queued manually
+    audioSpec.samples  = DEVICE_SAMPLES;    // Number of samples for the audio buffer (might need to be tweaked)
+    audioSpec.callback = audioCallback;     // Pulls the samples from the ring buffer on the audio thread
     audioSpec.userdata = this;              // User data is a pointer to the APU object
 
-    // Open the audio device with the desired specifications (audioSpec)
-    SDL_AudioSpec obtainedSpec;               // Structure to store the obtained audio specifications
-    SDL_OpenAudio(&audioSpec, &obtainedSpec); // obtainedSpec is filled with the actual specifications
-    SDL_PauseAudio(0);                        // Start playing audio (audio is initially paused)
+    // Open the audio device with the desired specifications (audioSpec), except for the sample rate, which the device
+    // may choose (e.g. 48 kHz): the band-limited buffers resample to any rate for free. It stays paused until the ring
+    // buffer has been filled up to the latency for the first time (see APU::endFrame).
+    SDL_AudioSpec obtainedSpec; // Structure to store the obtained audio specifications
+    audioDevice = SDL_OpenAudioDevice(nullptr, 0, &audioSpec, &obtainedSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    audioOpen   = audioDevice != 0; // Without a device, the audio is simply discarded
+    if (audioOpen)
+        sampleRate = obtainedSpec.freq;
+
+    leftBuffer.setRates(CLOCK_RATE, sampleRate);
+    rightBuffer.setRates(CLOCK_RATE, sampleRate);
+    audioBuffer.reserve(2 * BlipBuffer::MAX_SAMPLES); // Avoids reallocations
+
+    // Register the first frame sequencer step.
+    scheduler->schedule(Scheduler::Event::apu, scheduler->now() + (8192 - ticks));
 }
 
 APU::~APU() {
-    SDL_CloseAudio();
+    if (audioOpen)
+        SDL_CloseAudioDevice(audioDevice);
 }
 
 /**
@@ -58,7 +75,9 @@ APU::~APU() {
  *
  * @note: All unused bits are set to 1.
  */
-uint8_t APU::read(uint16_t addr) const {
+uint8_t APU::read(uint16_t addr) {
+    sync(scheduler->now()); // Bring the channels' status (NR52) up to date
+
     switch (addr) {
         // Pulse channel 1
         case 0xFF10: return nr10 | 0x80;
@@ -104,6 +123,22 @@ uint8_t APU::read(uint16_t addr) const {
  * @param data The data to write to the register or Wave RAM.
  */
 void APU::write(uint16_t addr, uint8_t data) {
+    // Catch up first so that the write takes effect at the right T-cycle.
+    sync(scheduler->now());
+
+    writeRegister(addr, data);
+
+    // The write may have changed the channels' outputs (volume, panning, trigger, Wave RAM, ...).
+    updateOutputs(lastTick);
+}
+
+/**
+ * Writes to the APU registers and the Wave RAM, at the T-cycle the APU has been advanced to.
+ *
+ * @param addr The address to write to.
+ * @param data The data to write to the register or Wave RAM.
+ */
+void APU::writeRegister(uint16_t addr, uint8_t data) {
     // If power is off, ignore writes to registers except NR41, NR52, Wave RAM.
     if (!control.power && addr < 0xFF26 && addr != 0xFF20)
         return;
@@ -180,31 +215,83 @@ void APU::init() {
     nr50 = 0x77; control.update(0, nr50);
     nr51 = 0xF3; control.update(1, nr51);
     nr52 = 0xF1; control.update(2, nr52);
+
+    updateOutputs(lastTick);
+}
+
+/**
+ * Handles the APU's scheduled event: catches the APU up to the current T-cycle, which steps the frame sequencer,
+ * and registers the next frame sequencer step. The APU is otherwise only advanced when its registers are accessed
+ * and when a frame ends (see APU::endFrame), which it does by itself if nobody ends frames (e.g. while paused).
+ */
+void APU::handleEvent() {
+    sync(scheduler->now());
+    if (lastTick - frameStart >= MAX_FRAME_CLOCKS)
+        endFrame();
+    scheduler->schedule(Scheduler::Event::apu, lastTick + (8192 - ticks));
 }
 
 /**
- * Updates the entire audio processing unit each cycle.
+ * Catches the APU up to the given T-cycle.
  *
- * This method is responsible for advancing the state of the APU by one tick, which involves
- * updating the frame sequencer, stepping each audio channel, and mixing and queuing audio
- * for playback. It is designed to be called regularly as part of the main emulation loop to simulate
- * the progression of audio processing in the Game Boy.
+ * Between two frame sequencer steps, the channels' frequency timers run freely, so they are advanced in bulk, and
+ * each channel only reports the T-cycles on which its output changes (see APU::updateOutput). On the T-cycle the
+ * frame sequencer is stepped, it is stepped before the channels, as if the APU had been ticked on every T-cycle.
+ *
+ * @param until The T-cycle to catch up to.
  */
-void APU::tick() {
-    // Step the frame sequencer if enough T-cycles have passed.
-    if (++ticks == 8192) {
-        ticks = 0;
-        frameSequencerTick();
+void APU::sync(uint64_t until) {
+    while (lastTick < until) {
+        uint64_t next   = std::min(lastTick + (8192 - ticks), until);
+        auto     cycles = static_cast<int>(next - lastTick);
+        bool     step   = (ticks += cycles) == 8192; // Is the frame sequencer stepped on T-cycle 'next'?
+
+        // Free-running T-cycles (up to 'next', unless the frame sequencer is stepped on it).
+        tickChannels(step ? cycles - 1 : cycles, lastTick);
+
+        if (step) {
+            ticks = 0;
+            frameSequencerTick();
+            tickChannels(1, next - 1);
+            updateOutputs(next); // The step may have changed volumes or disabled channels
+        }
+        lastTick = next;
     }
+}
+
+/**
+ * @param cycles The number of T-cycles to advance the channels by.
+ * @param start The T-cycle the channels have been advanced to.
+ */
+void APU::tickChannels(int cycles, uint64_t start) {
+    if (cycles <= 0)
+        return;
+
+    pulseChannel1.tick(cycles, start);
+    pulseChannel2.tick(cycles, start);
+    waveChannel.tick(cycles, start);
+    noiseChannel.tick(cycles, start);
+}
 
-    // Step the channels.
-    pulseChannel1.tick();
-    pulseChannel2.tick();
-    waveChannel.tick();
-    noiseChannel.tick();
+/**
+ * Decrements a channel's frequency timer by a number of T-cycles in one go. This is equivalent to decrementing
+ * the timer once per T-cycle and reloading it as soon as it reaches 0, as described by the channels' tick methods.
+ *
+ * @param frequencyTimer The channel's frequency timer.
+ * @param reload The value the timer is reloaded with when it expires (always positive).
+ * @param cycles The number of T-cycles to advance by.
+ * @return The number of times the timer expired.
+ */
+int APU::advanceFrequencyTimer(int& frequencyTimer, int reload, int cycles) {
+    int first = std::max(frequencyTimer, 1); // T-cycles until the timer first expires
+    if (cycles < first) {
+        frequencyTimer -= cycles;
+        return 0;
+    }
 
-    // Mix and queue the audio.
-    mixAndQueueAudio();
+    int remaining = cycles - first; // T-cycles left after the first reload
+    frequencyTimer = reload - remaining % reload;
+    return 1 + remaining / reload;
 }
 
 /**
@@ -270,53 +357,119 @@ void APU::frameSequencerTick() {
 }
 
 /**
- * Mixes audio samples from all channels, downsamples them, and queues them for playback.
+ * Mixes a channel's current sample into the left and right outputs, and adds the change of its contribution since it
+ * last changed to the band-limited buffers. A channel whose output stays the same costs nothing.
  *
- * This function aggregates audio samples from each of the Game Boy's sound channels (two pulse channels,
- * a wave channel, and a noise channel), applies volume settings, downsamples the mixed audio, and queues
- * it for playback. It is designed to be called at the rate the audio hardware processes sound samples.
+ * @param channel The channel's index (0-3, as in NR51).
+ * @param time The T-cycle on which the channel's output took its current value.
  */
-void APU::mixAndQueueAudio() {
-    // Check and update downsample timer
-    if (--downSampleTimer <= 0) {
-        downSampleTimer = 90; // Reset downsample timer
-
-        float leftSample = 0.0f, rightSample = 0.0f;
-        // Check if power is on and mix audio samples for left and right channels
-        if (control.power) {
-            // Mix audio samples for left channel
-            if (control.leftChannel1Enable) leftSample += pulseChannel1.getSample();
-            if (control.leftChannel2Enable) leftSample += pulseChannel2.getSample();
-            if (control.leftChannel3Enable) leftSample += waveChannel.getSample();
-            if (control.leftChannel4Enable) leftSample += noiseChannel.getSample();
-            // Mix audio samples for right channel
-            if (control.rightChannel1Enable) rightSample += pulseChannel1.getSample();
-            if (control.rightChannel2Enable) rightSample += pulseChannel2.getSample();
-            if (control.rightChannel3Enable) rightSample += waveChannel.getSample();
-            if (control.rightChannel4Enable) rightSample += noiseChannel.getSample();
+void APU::updateOutput(int channel, uint64_t time) {
+    float left = 0.0f, right = 0.0f;
+
+    if (control.power) {
+        float sample = 0.0f;
+        switch (channel) {
+            case 0: sample = pulseChannel1.getSample(); break;
+            case 1: sample = pulseChannel2.getSample(); break;
+            case 2: sample = waveChannel.getSample();   break;
+            case 3: sample = noiseChannel.getSample();  break;
+            default: break;
         }
 
-        // Normalize volumes and apply overall volume settings (15=max volume).
-        leftSample = (leftSample / 4.0f) * ((float) control.leftVolume / 15.0f);
-        rightSample = (rightSample / 4.0f) * ((float) control.rightVolume / 15.0f);
+        // Apply the panning (NR51), normalize volumes and apply overall volume settings (15=max volume).
+        if (nr51 & (0x10 << channel)) left  = (sample / 4.0f) * ((float) control.leftVolume / 15.0f);
+        if (nr51 & (0x01 << channel)) right = (sample / 4.0f) * ((float) control.rightVolume / 15.0f);
+    }
 
-        // Add processed samples to audio buffer.
-        audioBuffer.push_back(leftSample);
-        audioBuffer.push_back(rightSample);
+    auto clocks = static_cast<uint32_t>(time - frameStart);
+    if (left != leftOutputs[channel]) {
+        leftBuffer.addDelta(clocks, left - leftOutputs[channel]);
+        leftOutputs[channel] = left;
+    }
+    if (right != rightOutputs[channel]) {
+        rightBuffer.addDelta(clocks, right - rightOutputs[channel]);
+        rightOutputs[channel] = right;
     }
+}
 
-    // Check if audio buffer needs to be queued for playback.
-    if (audioBuffer.size() >= SAMPLE_SIZE) {
-        // Delay execution to let the audio queue drain to about a frame's worth of audio
-        while ((SDL_GetQueuedAudioSize(1)) > SAMPLE_SIZE * sizeof(float))
-            SDL2Timing::delay(std::chrono::milliseconds(1));
-        // Queue audio data for playback
-        SDL_QueueAudio(1, audioBuffer.data(), SAMPLE_SIZE * sizeof(float));
-        // Clear the buffer for next cycle
-        audioBuffer.clear();
+/**
+ * Brings all the channels' contributions to the outputs up to date, after something that may change any of them.
+ *
+ * @param time The T-cycle on which the change happened.
+ */
+void APU::updateOutputs(uint64_t time) {
+    for (int channel = 0; channel < 4; channel++)
+        updateOutput(channel, time);
+}
+
+/**
+ * Ends the current audio frame at the current T-cycle (called once per video frame, see GB::frameComplete): turns
+ * its output changes into samples at the audio device's rate, in one batch, and queues them for playback.
+ */
+void APU::endFrame() {
+    sync(scheduler->now());
+
+    auto clocks = static_cast<uint32_t>(lastTick - frameStart);
+    leftBuffer.endFrame(clocks);
+    rightBuffer.endFrame(clocks);
+    frameStart = lastTick;
+
+    // Both buffers hold the same number of samples, which are interleaved (left first).
+    size_t count = leftBuffer.samplesAvail();
+    audioBuffer.resize(2 * count);
+    leftBuffer.readSamples(audioBuffer.data(), count, 2);
+    rightBuffer.readSamples(audioBuffer.data() + 1, count, 2);
+
+    // Hand the samples over to the audio thread without ever waiting for it. If the emulation runs too far ahead
+    // of the audio device (the frame pacer keeps the ring buffer at the latency when it follows the audio clock,
+    // see FramePacer), whatever doesn't fit is dropped.
+    if (audioRing.write(audioBuffer.data(), audioBuffer.size()) < audioBuffer.size())
+        overruns.fetch_add(1, std::memory_order_relaxed);
+
+    // Start playing once there's enough audio buffered to absorb the emulation's irregularities.
+    if (audioOpen && !audioPlaying && queuedAudioMs() >= audioLatency) {
+        SDL_PauseAudioDevice(audioDevice, 0);
+        audioPlaying = true;
+    }
+}
+
+/**
+ * Called by SDL on the audio thread whenever the audio device needs more samples. Takes them from the ring buffer,
+ * and plays silence for whatever the emulation hasn't produced in time.
+ *
+ * @param userdata The APU.
+ * @param stream Destination of the samples (32-bit floats, left and right interleaved).
+ * @param len Size of the destination, in bytes.
+ */
+void APU::audioCallback(void* userdata, Uint8* stream, int len) {
+    auto*  apu     = static_cast<APU*>(userdata);
+    auto*  samples = reinterpret_cast<float*>(stream);
+    size_t count   = len / sizeof(float);
+
+    size_t read = apu->audioRing.read(samples, count);
+    if (read < count) {
+        std::fill(samples + read, samples + count, 0.0f);
+        apu->underruns.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
+/**
+ * @return The audio written to the ring buffer and not played yet, in milliseconds.
+ */
+uint32_t APU::queuedAudioMs() const {
+    // 2 channels per audio frame.
+    return audioRing.size() / 2 * 1000 / sampleRate;
+}
+
+/**
+ * @param ms How many milliseconds of audio to keep buffered between the emulation and the audio device. Lower is
+ *           more responsive, higher is more resilient to hiccups. Limited to 3/4 of the ring buffer's capacity.
+ */
+void APU::setAudioLatency(uint32_t ms) {
+    uint32_t maxLatency = AudioRing::CAPACITY / 2 * 1000 / sampleRate * 3 / 4;
+    audioLatency = std::min(ms, maxLatency);
+}
+
 /**
  * Clears most of the APU registers after powering off
  * (after clearing NR52's power bit 7).
@@ -449,14 +602,29 @@ void APU::PulseChannel::update(uint8_t offset, uint8_t data) {
  * This method is responsible for progressing the state of the pulse channel by decrementing the frequency timer
  * and updating the wave duty position accordingly. It is designed to be called regularly to simulate the
  * progression of the wave duty cycle in the audio playback.
+ *
+ * While the channel is audible, the output is updated on every step of the wave duty position, at the T-cycle the
+ * step happens; while it is silent, the position is advanced in one go.
+ *
+ * @param cycles The number of T-cycles to advance by (the frequency must not change in the meantime).
+ * @param start The T-cycle the channel has been advanced to.
  */
-void APU::PulseChannel::tick() {
+void APU::PulseChannel::tick(int cycles, uint64_t start) {
     // "The role of frequency timer is to step wave generation. Each T-cycle the frequency timer is decremented by 1.
     // As soon as it reaches 0, it is reloaded with a value calculated using the below formula, and the wave duty
     // position register is incremented by 1." - https://nightshade256.github.io/2021/03/27/gb-sound-emulation.html
-    if (--frequencyTimer <= 0) {
-        frequencyTimer = (2048 - ((frequencyMSB << 8) | frequencyLSB)) * 4; // Reload the timer
-        waveDutyPosition = (waveDutyPosition + 1) & 0x7;                    // Increment the wave duty position
+    int reload = (2048 - ((frequencyMSB << 8) | frequencyLSB)) * 4;
+    uint64_t time = start + std::max(frequencyTimer, 1); // T-cycle of the first expiration
+    int expirations = advanceFrequencyTimer(frequencyTimer, reload, cycles);
+
+    if (!enable || !dacEnable || currentVolume == 0) {
+        waveDutyPosition = (waveDutyPosition + expirations) & 0x7; // Increment the wave duty position
+        return;
+    }
+
+    for (; expirations > 0; expirations--, time += reload) {
+        waveDutyPosition = (waveDutyPosition + 1) & 0x7; // Increment the wave duty position
+        apu->updateOutput(id, time);
     }
 }
 
@@ -701,11 +869,26 @@ void APU::WaveChannel::update(uint8_t offset, uint8_t data) {
  *   should be accessed.
  * - The WRAM position is incremented and wrapped around to stay within the 32-byte boundary
  *   (0x1F in hexadecimal or 31 in decimal), ensuring the wave pattern loops correctly.
+ *
+ * While the channel is audible, the output is updated on every step of the WRAM position, at the T-cycle the step
+ * happens; while it is silent, the position is advanced in one go.
+ *
+ * @param cycles The number of T-cycles to advance by (the frequency must not change in the meantime).
+ * @param start The T-cycle the channel has been advanced to.
  */
-void APU::WaveChannel::tick() {
-    if (--frequencyTimer <= 0) {
-        frequencyTimer = (2048 - ((frequencyMSB << 8) | frequencyLSB)) * 2;
+void APU::WaveChannel::tick(int cycles, uint64_t start) {
+    int reload = (2048 - ((frequencyMSB << 8) | frequencyLSB)) * 2;
+    uint64_t time = start + std::max(frequencyTimer, 1); // T-cycle of the first expiration
+    int expirations = advanceFrequencyTimer(frequencyTimer, reload, cycles);
+
+    if (!enable || !dacEnable || volumeCode == 0) {
+        wramPosition = (wramPosition + expirations) & 0x1F;
+        return;
+    }
+
+    for (; expirations > 0; expirations--, time += reload) {
         wramPosition = (wramPosition + 1) & 0x1F;
+        apu->updateOutput(2, time);
     }
 }
 
@@ -789,15 +972,14 @@ void APU::WaveChannel::disableChannel() {
  *       The WRAM stores 4-bit samples, so for even positions, the high nibble is used, and for
  *       odd positions, the low nibble is used since high nibbles are played before low nibbles.
  *       The volume of the sample is then adjusted based on the 'volumeCode'. If 'volumeCode' is 0,
- *       the output is muted. Otherwise, the volume is adjusted by multiplying the sample by a factor
- *       determined by 'volumeCode', specifically 1 shifted left by (volumeCode - 1).
+ *       the output is muted. Otherwise, the volume is adjusted by shifting the sample right by (volumeCode - 1).
  */
 float APU::WaveChannel::getSample() {
     if (!enable || !dacEnable) return 0.0f;
 
     uint8_t sample = wram[wramPosition / 2];
     sample = (wramPosition & 1) ? (sample & 0xF) : (sample >> 4); // odd=low nibble, even=high nibble
-    return ((float) sample / 15.0f) * (float) (volumeCode == 0 ? 0 : 1 << (volumeCode - 1));
+    return volumeCode == 0 ? 0.0f : (float) (sample >> (volumeCode - 1)) / 15.0f;
 }
 // =====================================================================================================================
 
@@ -850,11 +1032,19 @@ void APU::NoiseChannel::update(uint8_t offset, uint8_t data) {
  *     3. The LFSR is shifted right by one bit and the above XOR result is stored in bit 14.
  *     4. If the width mode bit is set, the XOR result is also stored in bit 6."
  * - https://nightshade256.github.io/2021/03/27/gb-sound-emulation.html
+ *
+ * While the channel is audible, the output is updated after every shift of the LFSR, at the T-cycle it happens.
+ *
+ * @param cycles The number of T-cycles to advance by (NR43 must not change in the meantime).
+ * @param start The T-cycle the channel has been advanced to.
  */
-void APU::NoiseChannel::tick() {
-    if (--frequencyTimer <= 0) {
-        frequencyTimer = divisors[divisorCode] << clockShift; // Reload the timer
+void APU::NoiseChannel::tick(int cycles, uint64_t start) {
+    int reload = divisors[divisorCode] << clockShift; // Reload value of the timer
+    uint64_t time = start + std::max(frequencyTimer, 1); // T-cycle of the first expiration
+    int expirations = advanceFrequencyTimer(frequencyTimer, reload, cycles);
+    bool audible = enable && dacEnable && currentVolume != 0;
 
+    for (; expirations > 0; expirations--, time += reload) {
         uint8_t xorResult = (lfsr & 0x1) ^ ((lfsr >> 1) & 0x1);
         lfsr = (xorResult << 14) | (lfsr >> 1);
 
@@ -862,6 +1052,9 @@ void APU::NoiseChannel::tick() {
             lfsr &= ~(1 << 6);
             lfsr |= xorResult << 6;
         }
+
+        if (audible)
+            apu->updateOutput(3, time);
     }
 }
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "common.hpp"
+#include "Scheduler.hpp"
+#include "AudioRing.hpp"
+#include "BlipBuffer.hpp"
 #include <SDL.h>
 
 // I am no expert on the Game Boy's audio system, nor am I an expert on audio in general,
@@ -24,14 +27,31 @@ class APU {
     friend class NoiseChannel;
 
 public:
-    APU();
+    APU(Scheduler* s);
     ~APU();
 
 public:
-    void    tick();
+    void    handleEvent(); // Catches up and steps the frame sequencer (scheduled every 8192 T-cycles)
     void    init();
-    uint8_t read(uint16_t addr) const;
+    uint8_t read(uint16_t addr);
     void    write(uint16_t addr, uint8_t data);
+    void    endFrame();    // Turns the frame's output changes into samples and queues them (once per video frame)
+
+    bool     isAudioOpen() const { return audioOpen; }
+    uint32_t queuedAudioMs() const;               // Audio waiting in the ring buffer, in milliseconds
+    void     setAudioLatency(uint32_t ms);        // Target fill level of the ring buffer (see FramePacer)
+    uint32_t audioLatencyMs() const { return audioLatency; }
+    uint32_t audioUnderruns() const { return underruns.load(std::memory_order_relaxed); }
+    uint32_t audioOverruns() const  { return overruns.load(std::memory_order_relaxed); }
+
+private:
+    void     sync(uint64_t until);                     // Catches the APU up to the given T-cycle
+    void     tickChannels(int cycles, uint64_t start); // Advances the channels' frequency timers from T-cycle 'start'
+    void     writeRegister(uint16_t addr, uint8_t data);
+    uint64_t lastTick = 0;                             // The T-cycle up to which the APU has been advanced
+
+    // Decrements a channel's frequency timer by a number of T-cycles, reloading it every time it expires.
+    static int advanceFrequencyTimer(int& frequencyTimer, int reload, int cycles);
 
 private:
     // Audio registers ========================================================
@@ -176,8 +196,10 @@ private:
         uint8_t statusBitNR52 = 0x00;  // Bit 0 is the status bit for channel 1, bit 1 is the status bit for channel 2
         bool    negateModeUsed  = false;
 
+        uint8_t id = 0; // The channel's index in NR51 and in the APU's outputs (0 or 1)
+
         // The description of these functions are provided in their implementations.
-        void  tick();
+        void  tick(int cycles, uint64_t start);
         void  sweepTick();
         void  sweepFreqCalculation(bool update);
         void  envelopeTick();
@@ -239,7 +261,7 @@ private:
         uint8_t wramPosition = 0x00;
 
         // The description of these functions are provided in their implementations.
-        void  tick();
+        void  tick(int cycles, uint64_t start);
         void  lengthTick();
         void  trigger();
         void  update(uint8_t offset, uint8_t data);
@@ -283,7 +305,7 @@ private:
 
 
         // The description of these functions are provided in their implementations.
-        void  tick();
+        void  tick(int cycles, uint64_t start);
         void  envelopeTick();
         void  lengthTick();
         void  trigger();
@@ -302,9 +324,33 @@ private:
 
 
 private:
-    void mixAndQueueAudio(); // Mixes the audio channels and queues the audio buffer
-    static const int AUDIO_SAMPLE_RATE = 44100; // 44.1 kHz
-    static const int SAMPLE_SIZE       = 4096;  // (4 bytes per sample) * (1024 samples per buffer)
-    int downSampleTimer = 90; // Decremented every CPU cycle; when it reaches 0, the audio is outputted to the speakers
-    std::vector<float> audioBuffer; // Buffer for mixed audio samples
+    // Instead of being sampled, the channels' outputs are mixed every time one of them changes, and the changes
+    // (deltas) of the left and right outputs are handed to band-limited buffers (see BlipBuffer) at the T-cycle they
+    // occur.
+    void updateOutput(int channel, uint64_t time); // Adds the change of a channel's contribution at a T-cycle
+    void updateOutputs(uint64_t time);             // Same, for all the channels (after a register write, ...)
+    static void audioCallback(void* userdata, Uint8* stream, int len); // Feeds the audio device from the ring buffer
+    static const int        AUDIO_SAMPLE_RATE = 44100;     // 44.1 kHz (the device may ask for another rate)
+    static const int        DEVICE_SAMPLES    = 512;       // Stereo frames the audio device asks for at once (11.6 ms)
+    static const uint32_t   MAX_FRAME_CLOCKS  = 4 * 70224; // Audio frames longer than 4 video frames are ended early
+    static constexpr double CLOCK_RATE        = 4194304.0; // T-cycles per second
+
+    BlipBuffer           leftBuffer;         // Band-limited left output
+    BlipBuffer           rightBuffer;        // Band-limited right output
+    std::array<float, 4> leftOutputs  {};    // Each channel's last contribution to the left output
+    std::array<float, 4> rightOutputs {};    // Each channel's last contribution to the right output
+    uint64_t             frameStart   = 0;   // The T-cycle the current audio frame started on
+    int                  sampleRate   = AUDIO_SAMPLE_RATE; // The rate the audio device actually plays at
+    std::vector<float>   audioBuffer;        // A frame's samples (left and right interleaved), for the ring buffer
+
+    AudioRing             audioRing;           // Mixed samples on their way to the audio device
+    SDL_AudioDeviceID     audioDevice  = 0;     // 0 if no audio device could be opened
+    bool                  audioOpen    = false; // Was an audio device opened?
+    bool                  audioPlaying = false; // Set once the ring buffer was first filled up to the latency
+    uint32_t              audioLatency = 40;    // Milliseconds of audio kept in the ring buffer (see FramePacer)
+    std::atomic<uint32_t> underruns    { 0 };   // Callbacks that found fewer samples than asked for
+    std::atomic<uint32_t> overruns     { 0 };   // Buffers that didn't entirely fit in the ring buffer
+
+private:
+    Scheduler* scheduler; // For scheduling the frame sequencer and knowing the current T-cycle
 };
\ No newline at end of file
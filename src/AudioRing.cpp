@@ -0,0 +1,58 @@
+#include "AudioRing.hpp"
+
+#include <algorithm>
+
+AudioRing::AudioRing()
+: buffer() {}
+
+AudioRing::~AudioRing() = default;
+
+/**
+ * Appends samples to the ring, as many as there is room for.
+ *
+ * @param samples The samples to write.
+ * @param count The number of samples.
+ * @return The number of samples written, less than count if the ring is full.
+ */
+size_t AudioRing::write(const float* samples, size_t count) {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    size_t n = std::min(count, CAPACITY - (h - t));
+
+    // The samples may wrap around the end of the buffer.
+    size_t first = std::min(n, CAPACITY - (h & MASK));
+    std::copy_n(samples, first, &buffer[h & MASK]);
+    std::copy_n(samples + first, n - first, buffer.data());
+
+    head.store(h + n, std::memory_order_release);
+    return n;
+}
+
+/**
+ * Takes the oldest samples out of the ring, as many as are available.
+ *
+ * @param samples Destination of the samples.
+ * @param count The number of samples wanted.
+ * @return The number of samples read, less than count if the ring ran dry.
+ */
+size_t AudioRing::read(float* samples, size_t count) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    size_t n = std::min(count, h - t);
+
+    size_t first = std::min(n, CAPACITY - (t & MASK));
+    std::copy_n(&buffer[t & MASK], first, samples);
+    std::copy_n(buffer.data(), n - first, samples + first);
+
+    tail.store(t + n, std::memory_order_release);
+    return n;
+}
+
+/**
+ * @return The number of samples written and not read yet.
+ */
+size_t AudioRing::size() const {
+    size_t t = tail.load(std::memory_order_acquire);
+    size_t h = head.load(std::memory_order_acquire);
+    return h - t;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <atomic>
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer carrying audio samples from the CPU thread (the APU) to the
+ * SDL audio callback, which runs on SDL's audio thread.
+ *
+ * The producer only ever moves 'head' and the consumer only ever moves 'tail', both counting every sample that went
+ * through the ring so far (the position in the ring is the count modulo its power-of-two capacity). Each side loads
+ * the other's counter to know how much it may write or read, copies the samples, then publishes its own counter with
+ * a release store, so neither side ever waits for the other. Writing to a full ring or reading from an empty one
+ * simply moves fewer samples, which the caller counts as an overrun or an underrun.
+ */
+class AudioRing {
+public:
+    AudioRing();
+    ~AudioRing();
+
+public:
+    static constexpr size_t CAPACITY = 1 << 14; // Samples (8192 stereo frames, 186 ms at 44.1 kHz)
+
+    // Producer (CPU thread)
+    size_t write(const float* samples, size_t count); // Returns how many samples fit (all of them unless full)
+
+    // Consumer (audio thread)
+    size_t read(float* samples, size_t count);        // Returns how many samples were available (at most count)
+
+    size_t size() const; // Samples waiting to be read (from either thread)
+
+private:
+    static constexpr size_t MASK = CAPACITY - 1;
+
+    std::array<float, CAPACITY> buffer;
+
+    // On separate cache lines, so that each thread's writes don't slow the other thread's reads down.
+    alignas(64) std::atomic<size_t> head { 0 }; // Samples written so far (only moved by the producer)
+    alignas(64) std::atomic<size_t> tail { 0 }; // Samples read so far (only moved by the consumer)
+};
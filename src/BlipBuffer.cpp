@@ -0,0 +1,111 @@
+#include "BlipBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+BlipBuffer::BlipBuffer()
+: kernel()
+, buffer(MAX_SAMPLES + WIDTH, 0.0f) {
+    // Each phase's impulse is a sinc low-pass filter, shaped by a Blackman window to WIDTH samples, and delayed by
+    // WIDTH/2 samples so that it only ever spreads forward from the sample the delta falls on.
+    const double pi = std::acos(-1.0);
+    for (int phase = 0; phase < PHASES; phase++) {
+        double sum = 0.0;
+        for (int i = 0; i < WIDTH; i++) {
+            double x = i - WIDTH / 2 - static_cast<double>(phase) / PHASES; // Distance from the delta, in samples
+            double t = 2.0 * CUTOFF * x;
+            double sinc   = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+            double window = 0.42 + 0.5 * std::cos(2.0 * pi * x / WIDTH) + 0.08 * std::cos(4.0 * pi * x / WIDTH);
+            kernel[phase][i] = static_cast<float>(sinc * window);
+            sum += sinc * window;
+        }
+
+        // Normalize, so that the impulses integrate to a step of exactly the delta.
+        for (float& tap : kernel[phase])
+            tap = static_cast<float>(tap / sum);
+    }
+}
+
+BlipBuffer::~BlipBuffer() = default;
+
+/**
+ * @param clockRate The rate of the clock the deltas are timed with (T-cycles per second).
+ * @param sampleRate The rate of the samples to produce.
+ */
+void BlipBuffer::setRates(double clockRate, double sampleRate) {
+    factor = static_cast<uint64_t>(std::llround(sampleRate / clockRate * static_cast<double>(1ull << FRAC_BITS)));
+    clear();
+}
+
+/**
+ * Discards all the deltas and samples, and starts a new frame at the position of the first sample.
+ */
+void BlipBuffer::clear() {
+    std::fill(buffer.begin(), buffer.end(), 0.0f);
+    offset     = 0;
+    avail      = 0;
+    integrator = 0.0f;
+    prevInput  = 0.0f;
+    prevOutput = 0.0f;
+}
+
+/**
+ * Adds a band-limited step to the output.
+ *
+ * @param time When the output changes, in clocks from the start of the frame.
+ * @param delta By how much the output changes.
+ */
+void BlipBuffer::addDelta(uint32_t time, float delta) {
+    uint64_t fixed = offset + time * factor;
+    size_t   pos   = fixed >> FRAC_BITS;
+    int      phase = static_cast<int>((fixed >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1));
+
+    // A frame too long for the buffer loses its end rather than overflowing it.
+    if (pos + WIDTH > buffer.size())
+        return;
+
+    const auto& impulse = kernel[phase];
+    float*      out     = &buffer[pos];
+    for (int i = 0; i < WIDTH; i++)
+        out[i] += impulse[i] * delta;
+}
+
+/**
+ * Ends the current frame, making its samples available to read (see readSamples), and starts the next frame there.
+ *
+ * @param clocks The length of the frame, in clocks. Deltas must no longer be added before that time.
+ */
+void BlipBuffer::endFrame(uint32_t clocks) {
+    offset += clocks * factor;
+    avail   = std::min<size_t>(offset >> FRAC_BITS, MAX_SAMPLES);
+}
+
+/**
+ * Integrates the deltas of the oldest available samples into the output, removing its DC offset, and takes them out of
+ * the buffer.
+ *
+ * @param out Destination of the samples.
+ * @param count The number of samples wanted.
+ * @param stride The distance between two samples in 'out' (2 to interleave the samples of a stereo output).
+ * @return The number of samples read, at most samplesAvail().
+ */
+size_t BlipBuffer::readSamples(float* out, size_t count, size_t stride) {
+    size_t n = std::min(count, avail);
+
+    for (size_t i = 0; i < n; i++) {
+        integrator += buffer[i];
+
+        // One-pole high-pass filter (DC blocker).
+        float sample = integrator - prevInput + HIGH_PASS * prevOutput;
+        prevInput    = integrator;
+        prevOutput   = sample;
+        out[i * stride] = sample;
+    }
+
+    // Shift what's left (including the tails of the impulses added past the frame) to the start of the buffer.
+    std::copy(buffer.begin() + n, buffer.end(), buffer.begin());
+    std::fill(buffer.end() - n, buffer.end(), 0.0f);
+    avail  -= n;
+    offset -= static_cast<uint64_t>(n) << FRAC_BITS;
+    return n;
+}
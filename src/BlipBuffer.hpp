@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common.hpp"
+
+/**
+ * Band-limited synthesis buffer, in the style of Shay Green's blip_buf library.
+ *
+ * Instead of sampling the channels' outputs at the output sample rate, which aliases everything above half of it
+ * (square waves have harmonics far above 22 kHz), the APU only tells the buffer when an output changes and by how
+ * much (a delta), at the exact T-cycle it changes. Each delta is added to the buffer as a band-limited step: a
+ * windowed sinc impulse, picked among PHASES precomputed ones by where the delta falls between two output samples.
+ * Reading the samples integrates the impulses back into steps (and removes the DC offset, as the Game Boy's output
+ * capacitor does). The work is then proportional to the number of changes, not to the number of T-cycles.
+ *
+ * Time is counted in clocks (T-cycles) from the start of the current frame. endFrame makes the samples up to the end
+ * of the frame available to read, and starts the next frame there.
+ */
+class BlipBuffer {
+public:
+    BlipBuffer();
+    ~BlipBuffer();
+
+public:
+    static constexpr size_t MAX_SAMPLES = 8192; // Samples a frame may produce, plus those not read yet
+
+    void setRates(double clockRate, double sampleRate); // Also clears the buffer
+    void clear();
+
+    void   addDelta(uint32_t time, float delta); // The output changes by 'delta' 'time' clocks into the frame
+    void   endFrame(uint32_t clocks);            // Ends the frame 'clocks' clocks after its start
+    size_t samplesAvail() const { return avail; }
+    size_t readSamples(float* out, size_t count, size_t stride); // Takes up to 'count' samples, 'stride' apart
+
+private:
+    static constexpr int    PHASE_BITS = 6;
+    static constexpr int    PHASES     = 1 << PHASE_BITS; // Positions of a delta between two samples
+    static constexpr int    WIDTH      = 16;              // Samples a single step is spread over
+    static constexpr int    FRAC_BITS  = 32;              // Fractional bits of the sample positions
+    static constexpr double CUTOFF     = 0.45;            // Low-pass cutoff, relative to the sample rate
+    static constexpr float  HIGH_PASS  = 0.999f;          // DC blocker's pole (about 7 Hz at 44.1 kHz)
+
+    std::array<std::array<float, WIDTH>, PHASES> kernel; // Band-limited impulses, by phase
+    std::vector<float> buffer;                           // Deltas waiting to be integrated
+
+    uint64_t factor = 0; // Sample positions (FRAC_BITS fixed point) per clock
+    uint64_t offset = 0; // Fractional sample position of the start of the frame
+    size_t   avail  = 0; // Samples before the start of the frame, ready to be read
+
+    float integrator = 0.0f; // Sum of all the deltas read so far (the unfiltered output)
+    float prevInput  = 0.0f; // DC blocker's state
+    float prevOutput = 0.0f;
+};
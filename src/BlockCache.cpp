@@ -0,0 +1,126 @@
+#include "BlockCache.hpp"
+#include "Bus.hpp"
+
+BlockCache::BlockCache(Cartridge* c)
+: cartridge(c) {}
+
+BlockCache::~BlockCache() = default;
+
+/**
+ * Finds the block starting at the given address in the current memory map.
+ *
+ * @param pc The address of the block's first opcode.
+ * @return The cached block, or nullptr if there is none (yet).
+ */
+BlockCache::Block* BlockCache::lookup(uint16_t pc) {
+    if (pc < 0x8000) {
+        auto it = romBlocks.find(romKey(pc));
+        return it == romBlocks.end() ? nullptr : &it->second;
+    }
+    auto it = ramBlocks.find(pc);
+    return it == ramBlocks.end() ? nullptr : &it->second;
+}
+
+/**
+ * Stores a newly decoded block. The bytes of WRAM/HRAM blocks are remembered so that writing to
+ * any of them drops the block (see BlockCache::onRAMWrite), and so are their pages, which the bus
+ * then stops writing to directly.
+ *
+ * @param pc The address of the block's first opcode (must be cacheable, see BlockCache::isCacheable).
+ * @param block The decoded block (must not be empty).
+ * @return A pointer to the stored block, valid until the next generation.
+ */
+BlockCache::Block* BlockCache::insert(uint16_t pc, Block&& block) {
+    if (pc < 0x8000)
+        return &(romBlocks[romKey(pc)] = std::move(block));
+
+    bool newPage = false;
+    for (const Op& op : block.ops) {
+        for (int i = 0; i < op.length; i++) {
+            auto addr = static_cast<uint16_t>(op.pc + i);
+            ramCode.set(addr);
+            if (!codePages.test(addr >> 8)) {
+                codePages.set(addr >> 8);
+                newPage = true;
+            }
+        }
+    }
+    if (newPage && bus)
+        bus->mapWRAM();
+    return &(ramBlocks[pc] = std::move(block));
+}
+
+/**
+ * Checks if code at the given address may be cached, i.e., if it's in ROM (but not in the boot ROM), WRAM or HRAM.
+ * Code executed from anywhere else (VRAM, external RAM, OAM, I/O) is always interpreted.
+ *
+ * @param addr The address to check.
+ * @return True if code at the address may be cached.
+ */
+bool BlockCache::isCacheable(uint16_t addr) const {
+    if (addr < 0x0100)
+        return !cartridge->isBootROMEnabled();
+    return addr < 0x8000 || (0xC000 <= addr && addr < 0xE000) || (0xFF80 <= addr && addr < 0xFFFF);
+}
+
+/**
+ * Returns the end of the memory region containing the given (cacheable) address. Blocks never cross a region
+ * boundary, as the next region may be mapped independently (e.g., the switchable ROM bank after bank 0).
+ *
+ * @param addr The address to check.
+ * @return The first address past the region.
+ */
+uint16_t BlockCache::regionEnd(uint16_t addr) const {
+    if (addr < 0x4000) return 0x4000; // ROM bank 0
+    if (addr < 0x8000) return 0x8000; // Switchable ROM bank
+    if (addr < 0xE000) return 0xE000; // WRAM
+    return 0xFFFF;                    // HRAM
+}
+
+/**
+ * Called whenever the MBC registers are written to (or the boot ROM is disabled). The blocks of the previously
+ * mapped bank stay cached, but the CPU must not carry on executing a block from it.
+ */
+void BlockCache::onBankSwitch() {
+    gen++;
+}
+
+/**
+ * Called whenever WRAM or HRAM is written to. If the byte belongs to a cached block, all WRAM/HRAM blocks
+ * are dropped (code in RAM is rarely rewritten, so there's no point in being more selective).
+ *
+ * @param addr The address written to.
+ */
+void BlockCache::onRAMWrite(uint16_t addr) {
+    if (!ramCode.test(addr))
+        return;
+    ramBlocks.clear();
+    ramCode.reset();
+    codePages.reset();
+    gen++;
+    if (bus)
+        bus->mapWRAM();
+}
+
+/**
+ * Forgets the native code of all blocks once the JIT has flushed its code buffer. The blocks themselves stay
+ * cached and are translated again once they are hot.
+ */
+void BlockCache::dropTranslations() {
+    auto drop = [](Block& block) {
+        block.hits       = 0;
+        block.translated = false;
+        block.native     = nullptr;
+    };
+    for (auto& entry : romBlocks) drop(entry.second);
+    for (auto& entry : ramBlocks) drop(entry.second);
+}
+
+/**
+ * @param pc An address in ROM.
+ * @return The key of the address in the current memory map: (0, PC) for bank 0 and (bank, PC) otherwise.
+ */
+uint32_t BlockCache::romKey(uint16_t pc) const {
+    uint32_t bank = pc < 0x4000 ? 0 : cartridge->romBank();
+    return (bank << 16) | pc;
+}
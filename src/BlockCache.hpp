@@ -0,0 +1,78 @@
+#pragma once
+
+#include "common.hpp"
+#include "Cartridge.hpp"
+
+#include <unordered_map>
+#include <bitset>
+
+class Bus; // To avoid circular dependency
+
+/**
+ * Cache of predecoded basic blocks for the CPU (see SM83::fetch).
+ *
+ * A block is a straight-line run of instructions, ending at the first branch (or HALT/STOP), whose opcode and
+ * immediate operand bytes have been read from memory once and stored in a compact array. Executing an instruction
+ * from a block still emulates every M-cycle of its fetches, it just doesn't go through the bus and re-decode it.
+ *
+ * ROM blocks are keyed by (ROM bank, PC), so switching banks never throws any code away: the CPU simply looks up
+ * blocks of the newly mapped bank from then on. WRAM and HRAM blocks are keyed by PC and are all dropped as soon
+ * as one of the bytes they were decoded from is written to (self-modifying code, HRAM DMA routines being copied).
+ * Either event bumps a generation counter, so that the CPU stops executing from a block that may be stale.
+ * WRAM pages holding cached code are reported to the bus, which only watches writes to those pages (see Bus::mapWRAM).
+ */
+class BlockCache {
+public:
+    BlockCache(Cartridge* c);
+    ~BlockCache();
+
+public:
+    // A single predecoded instruction.
+    struct Op {
+        uint16_t               pc;      // Address of the opcode
+        uint8_t                opcode;  // Opcode byte (0xCB for CB-prefixed instructions)
+        uint8_t                length;  // Number of bytes (1-3), including the opcode
+        std::array<uint8_t, 2> operand; // Immediate bytes following the opcode (if any)
+    };
+
+    // A straight-line run of predecoded instructions.
+    struct Block {
+        std::vector<Op> ops;
+        uint32_t        hits        = 0;       // Times the block was entered from its start (see SM83::runNative)
+        bool            translated  = false;   // Has the JIT already attempted to translate the block?
+        const void*     native      = nullptr; // Native code for the block's translatable prefix (see JIT.hpp)
+        uint8_t         maxCycles   = 0;       // Maximum M-cycles spent in the native code
+        bool            idleChecked = false;   // Has the block been checked for a polling loop?
+        uint8_t         idleCycles  = 0;       // M-cycles of an iteration if it's a polling loop (0 otherwise)
+    };
+
+    static constexpr size_t MAX_BLOCK_LENGTH = 64; // Maximum number of instructions in a block
+
+public:
+    Block*   lookup(uint16_t pc);               // Finds the block starting at PC in the current memory map
+    Block*   insert(uint16_t pc, Block&& block); // Stores a newly decoded block starting at PC
+    bool     isCacheable(uint16_t addr) const;  // Checks if code at an address may be cached
+    uint16_t regionEnd(uint16_t addr) const;    // First address past the memory region containing addr
+    uint32_t generation() const { return gen; } // Bumped whenever a block may have become stale
+
+    bool hasCodeOnPage(uint8_t page) const { return codePages.test(page); } // Was code decoded from a RAM page?
+
+    void ConnectBus(Bus* b) { bus = b; }
+
+    void onBankSwitch();            // Called on writes to the MBC registers (ROM area)
+    void onRAMWrite(uint16_t addr); // Called on writes to WRAM and HRAM
+    void dropTranslations();        // Forgets the native code of all blocks (see JIT::flush)
+
+private:
+    uint32_t romKey(uint16_t pc) const; // (ROM bank, PC) key of a ROM address
+
+    std::unordered_map<uint32_t, Block> romBlocks; // Blocks in ROM, keyed by (ROM bank, PC)
+    std::unordered_map<uint16_t, Block> ramBlocks; // Blocks in WRAM/HRAM, keyed by PC
+    std::bitset<0x10000>                ramCode;   // WRAM/HRAM bytes that blocks were decoded from
+    std::bitset<0x100>                  codePages; // WRAM/HRAM pages (addr >> 8) that blocks were decoded from
+    uint32_t                            gen = 0;   // Generation counter (see BlockCache::generation)
+
+private:
+    Cartridge* cartridge;     // For keying ROM blocks by the currently mapped bank
+    Bus*       bus = nullptr; // Remaps WRAM pages when they start or stop holding code
+};
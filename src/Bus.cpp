@@ -20,103 +20,187 @@
 * Source: https://gbdev.io/pandocs/Memory_Map.html#memory-map
 */
 
-Bus::Bus(PPU* p, Cartridge* c, IO* i, InterruptHandler* ih, Timer* t, DMA* d)
-    : ppu(p), cartridge(c), io(i), intHandler(ih), timer(t), ram(), dma(d) {}
+Bus::Bus(PPU* p, Cartridge* c, IO* i, InterruptHandler* ih, Timer* t, DMA* d, BlockCache* bc)
+    : ppu(p), cartridge(c), io(i), intHandler(ih), timer(t), ram(), dma(d), blockCache(bc) {
+    // Pages that never change. VRAM can be read directly as the PPU never writes to it, but writes go through
+    // the PPU so that it is caught up first. ROM, external RAM and WRAM writes depend on the cartridge and on
+    // the block cache.
+    mapPages(readMap,  0x8000, 0xA000, ppu->vramData(), Device::ppu);
+    mapPages(writeMap, 0x8000, 0xA000, nullptr,         Device::ppu);
+    mapPages(readMap,  0xC000, 0xE000, ram.wramData(),  Device::wram);
+    mapPages(readMap,  0xE000, 0xFE00, nullptr,         Device::unusable);
+    mapPages(writeMap, 0xE000, 0xFE00, nullptr,         Device::unusable);
+    mapPages(readMap,  0xFE00, 0xFF00, nullptr,         Device::oam);
+    mapPages(writeMap, 0xFE00, 0xFF00, nullptr,         Device::oam);
+    mapPages(readMap,  0xFF00, 0x0000, nullptr,         Device::high);
+    mapPages(writeMap, 0xFF00, 0x0000, nullptr,         Device::high);
+    mapCartridge();
+    mapWRAM();
+}
 
 Bus::~Bus() = default;
 
+/**
+ * Reads a byte through the memory map. Plain memory (ROM, VRAM, WRAM and external RAM without side effects)
+ * is read straight from its host memory, everything else goes through the device handling the page.
+ *
+ * @param addr Address to read from.
+ * @return The byte read.
+ */
 uint8_t Bus::read(uint16_t addr) {
-    if (addr < 0x8000) // ROM data
-        return cartridge->read(addr);
-
-    if (addr < 0xA000) // VRAM (Video RAM)
-        return ppu->read(addr);
-
-    if (addr < 0xC000) // Cartridge External RAM
-        return cartridge->read(addr);
-
-    if (addr < 0xE000) // WRAM (Working RAM)
-        return ram.readWRAM(addr);
-
-    if (addr < 0xFE00) // Reserved Echo RAM (unusable)
-        return 0;
-
-    if (addr < 0xFEA0) // OAM (Object Attribute Memory)
-        return dma->isTransferring() ? 0xFF : ppu->read(addr);
-
-    if (addr < 0xFF00) // Reserved (unusable)
-        return 0;
-
-    if (addr < 0xFF80) // I/O Registers
-        return io->read(addr);
-
-    if (addr < 0xFFFF) // HRAM (High RAM)
-        return ram.readHRAM(addr);
-
-    if (addr == 0xFFFF) // Interrupt Enable register (IE)
-        return intHandler->read(addr);
-
-    printf("UNSUPPORTED bus_read(%04X)\n", addr);
-    return 0xFF;
+    const Page& page = readMap[addr >> 8];
+    if (page.mem)
+        return page.mem[addr & 0xFF];
+    return readDevice(page.device, addr);
 }
 
+/**
+ * Writes a byte through the memory map (see Bus::read).
+ *
+ * @param addr Address to write to.
+ * @param data Byte to write.
+ */
 void Bus::write(uint16_t addr, uint8_t data) {
-    if (addr < 0x8000) { // ROM data
-        cartridge->write(addr, data);
+    const Page& page = writeMap[addr >> 8];
+    if (page.mem) {
+        page.mem[addr & 0xFF] = data;
         return;
     }
+    writeDevice(page.device, addr, data);
+}
 
-    if (addr < 0xA000) { // VRAM (Video RAM)
-        ppu->write(addr, data);
-        return;
-    }
+/**
+ * Maps ROM and external RAM according to the current state of the cartridge. Called whenever the MBC registers
+ * are written to (they select the ROM/RAM banks and enable the RAM) and when the boot ROM is disabled.
+ */
+void Bus::mapCartridge() {
+    mapPages(readMap,  0x0000, 0x4000, cartridge->mappedROM(0x0000), Device::cartridge);
+    mapPages(readMap,  0x4000, 0x8000, cartridge->mappedROM(0x4000), Device::cartridge);
+    mapPages(writeMap, 0x0000, 0x8000, nullptr,                      Device::cartridge);
+    if (cartridge->isBootROMEnabled())
+        readMap[0x00].mem = nullptr;
+
+    // Writes to battery-backed RAM have to flag the cartridge for saving.
+    uint8_t* ram = cartridge->mappedRAM();
+    mapPages(readMap,  0xA000, 0xC000, ram,                                    Device::cartridge);
+    mapPages(writeMap, 0xA000, 0xC000, cartridge->hasBattery() ? nullptr : ram, Device::cartridge);
+}
 
-    if (addr < 0xC000) { // Cartridge External RAM
-        cartridge->write(addr, data);
-        return;
+/**
+ * Maps the WRAM pages for writing. Pages holding cached code go through Bus::writeDevice, so that the
+ * block cache is told about the write, the others are written to directly.
+ */
+void Bus::mapWRAM() {
+    for (int page = 0xC0; page < 0xE0; page++) {
+        uint8_t* mem = blockCache->hasCodeOnPage(page) ? nullptr : ram.wramData() + ((page - 0xC0) << 8);
+        writeMap[page] = { mem, Device::wram };
     }
+}
 
-    if (addr < 0xE000) { // WRAM (Working RAM)
-        ram.writeWRAM(addr, data);
-        return;
-    }
+/**
+ * Maps a range of pages to consecutive host memory, or to a device only if mem is nullptr.
+ *
+ * @param map The read or write map.
+ * @param start The first address of the range (page-aligned).
+ * @param end The first address past the range (page-aligned, 0x0000 for the end of the address space).
+ * @param mem Host memory of the first page, or nullptr.
+ * @param device The device handling the pages if they are not plain memory.
+ */
+void Bus::mapPages(std::array<Page, 0x100>& map, uint16_t start, uint16_t end, uint8_t* mem, Device device) {
+    int last = end ? end >> 8 : 0x100;
+    for (int page = start >> 8; page < last; page++)
+        map[page] = { mem ? mem + ((page - (start >> 8)) << 8) : nullptr, device };
+}
 
-    if (addr < 0xFE00) { // Reserved Echo RAM (unusable)
-        return;
+/**
+ * Reads a byte from a page that is not plain memory.
+ *
+ * @param device The device handling the page.
+ * @param addr Address to read from.
+ * @return The byte read.
+ */
+uint8_t Bus::readDevice(Device device, uint16_t addr) {
+    switch (device) {
+        case Device::cartridge: // Boot ROM, External RAM
+            return cartridge->read(addr);
+
+        case Device::ppu:       // VRAM (Video RAM)
+            return ppu->read(addr);
+
+        case Device::wram:      // WRAM (Working RAM)
+            return ram.readWRAM(addr);
+
+        case Device::oam:       // OAM (Object Attribute Memory)
+            if (addr < 0xFEA0)
+                return dma->isTransferring() ? 0xFF : ppu->read(addr);
+            return 0;           // Reserved (unusable)
+
+        case Device::high:
+            if (addr < 0xFF80)  // I/O Registers
+                return io->read(addr);
+            if (addr < 0xFFFF)  // HRAM (High RAM)
+                return ram.readHRAM(addr);
+            return intHandler->read(addr); // Interrupt Enable register (IE)
+
+        case Device::unusable:  // Reserved Echo RAM (unusable)
+        default:
+            return 0;
     }
+}
 
-    if (addr < 0xFEA0) { // OAM (Object Attribute Memory)
-        // See https://gbdev.io/pandocs/OAM_DMA_Transfer.html#oam-dma-bus-conflicts
-        if (!dma->isTransferring())
+/**
+ * Writes a byte to a page that is not plain memory.
+ *
+ * @param device The device handling the page.
+ * @param addr Address to write to.
+ * @param data Byte to write.
+ */
+void Bus::writeDevice(Device device, uint16_t addr, uint8_t data) {
+    switch (device) {
+        case Device::cartridge:
+            cartridge->write(addr, data);
+            if (addr < 0x8000) {        // MBC registers
+                blockCache->onBankSwitch();
+                mapCartridge();
+            }
+            return;
+
+        case Device::ppu:               // VRAM (Video RAM)
             ppu->write(addr, data);
-        return;
-    }
-
-    if (addr < 0xFF00) { // Reserved (unusable)
-        return;
-    }
-
-    if (addr == 0xFF50) { // Boot ROM disable
-        cartridge->write(addr, data);
-        return;
+            return;
+
+        case Device::wram:              // WRAM (Working RAM)
+            ram.writeWRAM(addr, data);
+            blockCache->onRAMWrite(addr);
+            return;
+
+        case Device::oam:               // OAM (Object Attribute Memory)
+            // See https://gbdev.io/pandocs/OAM_DMA_Transfer.html#oam-dma-bus-conflicts
+            if (addr < 0xFEA0 && !dma->isTransferring())
+                ppu->write(addr, data);
+            return;
+
+        case Device::high:
+            if (addr == 0xFF50) {       // Boot ROM disable
+                cartridge->write(addr, data);
+                blockCache->onBankSwitch();
+                mapCartridge();
+                return;
+            }
+            if (addr < 0xFF80) {        // I/O Registers
+                io->write(addr, data);
+                return;
+            }
+            if (addr < 0xFFFF) {        // HRAM (High RAM)
+                ram.writeHRAM(addr, data);
+                blockCache->onRAMWrite(addr);
+                return;
+            }
+            intHandler->write(addr, data); // Interrupt Enable register (IE)
+            return;
+
+        case Device::unusable:          // Reserved Echo RAM (unusable)
+        default:
+            return;
     }
-
-    if (addr < 0xFF80) { // I/O Registers
-        io->write(addr, data);
-        return;
-    }
-
-    if (addr < 0xFFFF) { // HRAM (High RAM)
-        ram.writeHRAM(addr, data);
-        return;
-    }
-
-    if (addr == 0xFFFF) { // Interrupt Enable register (IE)
-        intHandler->write(addr, data);
-        return;
-    }
-
-    printf("UNSUPPORTED bus_write(%04X)\n", addr);
 }
-
-
@@ -8,16 +8,46 @@
 #include "Timer.hpp"
 #include "PPU.hpp"
 #include "DMA.hpp"
+#include "BlockCache.hpp"
 
 class Bus {
 public:
-    Bus(PPU* p, Cartridge* c, IO* i, InterruptHandler* ih, Timer* t, DMA* d);
+    Bus(PPU* p, Cartridge* c, IO* i, InterruptHandler* ih, Timer* t, DMA* d, BlockCache* bc);
     ~Bus();
 
 public: // Bus Read and Write
     uint8_t read(uint16_t addr);
     void    write(uint16_t addr, uint8_t data);
 
+public: // Memory map (see Bus::read)
+    void mapCartridge(); // Remaps ROM and external RAM after a bank switch or the boot ROM being disabled
+    void mapWRAM();      // Remaps WRAM after pages started or stopped holding cached code (see BlockCache)
+
+private:
+    // Devices handling the accesses to pages that are not plain memory.
+    enum class Device : uint8_t {
+        unusable,  // Echo RAM and the prohibited area after OAM (reads return 0, writes are ignored)
+        cartridge, // Boot ROM, MBC registers and external RAM that is disabled or has side effects
+        ppu,       // VRAM writes (the PPU is caught up first)
+        wram,      // WRAM writes to pages holding cached code
+        oam,       // OAM (blocked during DMA) and the prohibited area after it
+        high,      // I/O registers, HRAM and IE
+    };
+
+    // One 256-byte page of the address space. Plain memory is accessed through a host pointer to the start
+    // of the page, everything else through the device handling the page.
+    struct Page {
+        uint8_t* mem    = nullptr;
+        Device   device = Device::unusable;
+    };
+
+    std::array<Page, 0x100> readMap;  // Pages for reads, indexed by addr >> 8
+    std::array<Page, 0x100> writeMap; // Pages for writes, indexed by addr >> 8
+
+    uint8_t readDevice(Device device, uint16_t addr);
+    void    writeDevice(Device device, uint16_t addr, uint8_t data);
+    void    mapPages(std::array<Page, 0x100>& map, uint16_t start, uint16_t end, uint8_t* mem, Device device);
+
 private: // Devices on the bus
     PPU* ppu;
     Cartridge* cartridge;
@@ -26,4 +56,5 @@ private: // Devices on the bus
     Timer* timer;
     RAM ram;
     DMA* dma;
+    BlockCache* blockCache; // Notified of writes that may invalidate cached code
 };
\ No newline at end of file
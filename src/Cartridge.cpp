@@ -155,6 +155,34 @@ uint8_t Cartridge::read(uint16_t addr) {
 }
 
 
+/**
+ * @return The number of the ROM bank currently mapped to 0x4000-0x7FFF.
+ */
+uint16_t Cartridge::romBank() const {
+    return mbc->romBank();
+}
+
+/**
+ * Returns the host memory of the ROM bank mapped at the given address (see Bus::mapCartridge). The boot ROM,
+ * while enabled, overlays the first 256 bytes and is not part of it.
+ *
+ * @param addr An address in ROM (0x0000-0x7FFF).
+ * @return Pointer to the first byte of the 16KB bank containing the address.
+ */
+uint8_t* Cartridge::mappedROM(uint16_t addr) const {
+    return mbc->mappedROM(addr);
+}
+
+/**
+ * Returns the host memory of the external RAM bank mapped to 0xA000-0xBFFF, if reading and writing it has no
+ * other effect than accessing that memory (see Bus::mapCartridge).
+ *
+ * @return Pointer to the first byte of the 8KB bank, or nullptr if the RAM is disabled or has to go through the MBC.
+ */
+uint8_t* Cartridge::mappedRAM() const {
+    return mbc->mappedRAM();
+}
+
 /**
  * Writes a byte to the cartridge's memory bank controller (if any).
  * ROM is read-only, so writing to ROM will do nothing.
@@ -23,6 +23,12 @@ public:
     bool hasBattery();        // Check if the cartridge has a battery
     void save();              // Save the cartridge to disk
 
+public:
+    uint16_t romBank() const;                                    // ROM bank currently mapped to 0x4000-0x7FFF
+    uint8_t* mappedROM(uint16_t addr) const;                     // ROM bank mapped at a ROM address
+    uint8_t* mappedRAM() const;                                  // RAM bank mapped to 0xA000-0xBFFF (if plain memory)
+    bool     isBootROMEnabled() const { return bootROMEnabled; } // Is the boot ROM mapped to 0x0000-0x00FF?
+
 private:
     // See: https://gbdev.io/pandocs/The_Cartridge_Header.html
     struct Header {                          // <Address range>: <Description>
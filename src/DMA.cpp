@@ -1,9 +1,10 @@
 #include "DMA.hpp"
 #include "Bus.hpp"
 
-DMA::DMA(Bus* b, PPU* p)
+DMA::DMA(Bus* b, PPU* p, Scheduler* s)
 : bus(b)
-, ppu(p) {}
+, ppu(p)
+, scheduler(s) {}
 
 DMA::~DMA() = default;
 
@@ -20,10 +21,13 @@ void DMA::startTransfer(uint8_t addr) {
     isActive = true;      // Set flag to indicate that DMA transfer is now active.
     addrLowerByte = 0;    // Initialize lower byte of address to start from beginning.
     addrUpperByte = addr; // Set the upper byte of the source address for the transfer.
+
+    // The first byte is copied at the end of the next M-cycle.
+    scheduler->schedule(Scheduler::Event::dma, scheduler->now() + 4);
 }
 
 /**
- * Executes a single tick (cycle) of the DMA transfer.
+ * Executes a single tick (cycle) of the DMA transfer, scheduled by the event scheduler once per M-cycle.
  * This function progresses the DMA transfer by one byte per call. It sequentially transfers
  * data from the source address to OAM. Once all 160 bytes (from $XX00-$XX9F) are transferred
  * (to $FE00-$FE9F), it deactivates the DMA transfer process. Once started, the DMA transfer
@@ -36,6 +40,9 @@ void DMA::tick() {
     if (!isActive)
         return;
 
+    // Catch the PPU up before touching OAM behind its back.
+    ppu->sync();
+
     // Perform the actual byte transfer from the source address to OAM.
     ppu->writeOAM(
         0xFE00 | addrLowerByte,                          // $FE00-$FE9F (OAM address to write to)
@@ -44,6 +51,8 @@ void DMA::tick() {
 
     // Increment the address byte and check if transfer is complete.
     isActive = ++addrLowerByte < 0xA0;
+    if (isActive) // Copy the next byte in 4 T-cycles
+        scheduler->schedule(Scheduler::Event::dma, scheduler->now() + 4);
 }
 
 /**
@@ -4,6 +4,7 @@
 #include <thread>
 #include <chrono>
 #include "PPU.hpp"
+#include "Scheduler.hpp"
 
 // Forward declaration of Bus class to prevent circular inclusions.
 class Bus;
@@ -12,7 +13,7 @@ class DMA {
     friend class LCD; // Needs to read the last written value to the DMA register (addrUpperByte)
 
 public:
-    DMA(Bus* b, PPU* p);
+    DMA(Bus* b, PPU* p, Scheduler* s);
     ~DMA();
 
 public:
@@ -31,4 +32,5 @@ private:
 private: // Devices connected to the DMA
     Bus* bus = nullptr; // Memory bus for reading data
     PPU* ppu = nullptr; // PPU for writing to OAM
+    Scheduler* scheduler = nullptr; // For scheduling the byte transfers (one per M-cycle)
 };
\ No newline at end of file
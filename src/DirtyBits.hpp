@@ -0,0 +1,41 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <atomic>
+
+/**
+ * Set of N flags, one per item (a tile, a tile map entry, a sprite...), marked by the CPU thread when an item is
+ * written and taken by the UI thread to redraw only what changed (see UI::updateDebugWindow).
+ *
+ * Marking an item that is already marked is a plain load, so repeated writes to the same item (e.g. a tile being
+ * copied into VRAM byte by byte) cost next to nothing. Taking the flags clears them in the same atomic exchange, so
+ * no mark is ever lost between the two threads.
+ */
+template <size_t N>
+class DirtyBits {
+public:
+    static constexpr size_t WORDS = (N + 63) / 64;
+    using Snapshot = std::array<uint64_t, WORDS>; // The flags taken at once, see DirtyBits::test
+
+    // Marks an item as changed (producer).
+    void mark(size_t i) {
+        std::atomic<uint64_t>& word = words[i / 64];
+        uint64_t bit = 1ULL << (i % 64);
+        if (!(word.load(std::memory_order_relaxed) & bit))
+            word.fetch_or(bit, std::memory_order_release);
+    }
+
+    // Takes the items changed since the last call and clears them (consumer).
+    Snapshot take() {
+        Snapshot taken;
+        for (size_t w = 0; w < WORDS; w++)
+            taken[w] = words[w].exchange(0, std::memory_order_acquire);
+        return taken;
+    }
+
+    static bool test(const Snapshot& taken, size_t i) { return (taken[i / 64] >> (i % 64)) & 1; }
+
+private:
+    std::array<std::atomic<uint64_t>, WORDS> words{};
+};
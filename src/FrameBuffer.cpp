@@ -0,0 +1,45 @@
+#include "FrameBuffer.hpp"
+
+FrameBuffer::FrameBuffer()
+: buffers() {}
+
+FrameBuffer::~FrameBuffer() = default;
+
+/**
+ * Publishes the frame in the back buffer as the newest complete frame, and takes the buffer in between as the new
+ * back buffer. The release order makes the frame's pixels visible to the UI thread before the exchange is.
+ * If the UI had already acquired the previous frame, it is notified that a new one is waiting. Otherwise the
+ * previous frame is dropped, and the notification sent for it also covers this one.
+ */
+void FrameBuffer::publish() {
+    uint8_t prev = middle.exchange(backIdx | FRESH, std::memory_order_acq_rel);
+    backIdx = prev & ~FRESH;
+
+    if (prev & FRESH)
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    else if (notify)
+        notify(notifyData);
+}
+
+/**
+ * @return True if a frame was published since the last call to acquire.
+ */
+bool FrameBuffer::hasNewFrame() const {
+    return middle.load(std::memory_order_relaxed) & FRESH;
+}
+
+/**
+ * Takes the newest published frame, or keeps the current one if nothing was published since the last call.
+ * The returned frame stays untouched until the next call.
+ *
+ * @return The frame to present.
+ */
+const FrameBuffer::Frame& FrameBuffer::acquire() {
+    if (!hasNewFrame()) {
+        repeated.fetch_add(1, std::memory_order_relaxed);
+        return buffers[frontIdx];
+    }
+
+    frontIdx = middle.exchange(frontIdx, std::memory_order_acq_rel) & ~FRESH;
+    return buffers[frontIdx];
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <atomic>
+
+/**
+ * Lock-free triple buffer handing completed frames from the CPU thread (the PPU) to the UI thread.
+ *
+ * The PPU only ever draws into the back buffer, and the UI only ever reads the front buffer. The third buffer sits
+ * in between: publishing a frame swaps it with the back buffer, and acquiring one swaps it with the front buffer,
+ * both with a single atomic exchange of its index and a flag telling whether it holds a frame the UI hasn't seen.
+ * Neither side ever waits for the other, the UI can't see a frame that is still being drawn, and it always gets the
+ * newest complete one. A frame published before the previous one was acquired is dropped, and acquiring without a
+ * new frame repeats the previous one; both are counted.
+ *
+ * So that the UI doesn't have to poll for frames, a notification can be set, which the producer calls whenever it
+ * publishes a frame while none is waiting to be acquired (at most once per acquire).
+ */
+class FrameBuffer {
+public:
+    FrameBuffer();
+    ~FrameBuffer();
+
+public:
+    using Frame  = std::array<uint32_t, 160 * 144>; // ARGB pixels, row by row
+    using Notify = void (*)(void* userdata);       // Called on the producer's thread, see FrameBuffer::setNotify
+
+    // Producer (CPU thread)
+    Frame& back() { return buffers[backIdx]; } // The frame being drawn
+    void   publish();                          // Hands the back buffer over to the UI
+
+    // Consumer (UI thread)
+    bool         hasNewFrame() const;          // Was a frame published since the last acquire?
+    const Frame& acquire();                    // The newest complete frame
+
+    void setNotify(Notify fn, void* userdata) { notify = fn; notifyData = userdata; } // Before the producer starts
+
+    uint32_t framesDropped() const  { return dropped.load(std::memory_order_relaxed); }
+    uint32_t framesRepeated() const { return repeated.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint8_t FRESH = 1 << 2; // Set in 'middle' while it holds a frame that hasn't been acquired
+
+    std::array<Frame, 3> buffers;
+    uint8_t              backIdx  = 0; // Only used by the producer
+    uint8_t              frontIdx = 1; // Only used by the consumer
+    std::atomic<uint8_t> middle   { 2 }; // Index of the buffer in between (plus FRESH)
+
+    Notify notify     = nullptr; // Tells the consumer a frame is waiting
+    void*  notifyData = nullptr;
+
+    std::atomic<uint32_t> dropped  { 0 }; // Frames overwritten before the UI acquired them
+    std::atomic<uint32_t> repeated { 0 }; // Acquires that found no new frame
+};
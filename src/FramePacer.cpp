@@ -0,0 +1,116 @@
+#include "FramePacer.hpp"
+
+#include <cstring>
+
+FramePacer::FramePacer(APU* a)
+: apu(a) {
+    setSpeed(1.0);
+    secondStart = Clock::now();
+}
+
+FramePacer::~FramePacer() = default;
+
+/**
+ * @param m The pacing strategy (see FramePacer).
+ */
+void FramePacer::setMode(Mode m) {
+    mode    = m;
+    restart = true;
+}
+
+/**
+ * @param multiplier The emulation speed relative to a real Game Boy, in 'speed' and 'precise' modes.
+ */
+void FramePacer::setSpeed(double multiplier) {
+    speed       = multiplier > 0 ? multiplier : 1.0;
+    framePeriod = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / (GB_FRAME_RATE * speed)));
+    restart     = true;
+}
+
+/**
+ * Called on the CPU thread after the PPU completed a frame. Waits until the next frame is due, and counts the frames
+ * completed every second.
+ *
+ * @return True if a second has elapsed since the FPS were last measured (see FramePacer::fps).
+ */
+bool FramePacer::frameComplete() {
+    bool useAudio = mode == Mode::audio && apu->isAudioOpen();
+
+    if (mode != Mode::uncapped && !useAudio) {
+        Clock::time_point now = Clock::now();
+        if (restart || now > nextDeadline + MAX_LATENESS)
+            nextDeadline = now;
+        restart = false;
+
+        nextDeadline += framePeriod;
+        waitUntil(nextDeadline, mode != Mode::speed);
+    } else if (useAudio) {
+        waitForAudio();
+    }
+
+    framesThisSecond++;
+    Clock::time_point now = Clock::now();
+    if (now - secondStart < std::chrono::seconds(1))
+        return false;
+
+    measuredFPS      = framesThisSecond;
+    framesThisSecond = 0;
+    secondStart      = now;
+    return true;
+}
+
+/**
+ * Blocks the calling thread until the given time.
+ *
+ * @param deadline When to return.
+ * @param spin Whether to busy-wait for the last SPIN_MARGIN instead of trusting the OS to wake the thread up on time.
+ */
+void FramePacer::waitUntil(Clock::time_point deadline, bool spin) {
+    if (!spin) {
+        std::this_thread::sleep_until(deadline);
+        return;
+    }
+
+    if (deadline - Clock::now() > SPIN_MARGIN)
+        std::this_thread::sleep_until(deadline - SPIN_MARGIN);
+    while (Clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+/**
+ * Blocks the calling thread while the APU's ring buffer holds more than its target latency, i.e. until the audio
+ * device has played enough of it for the emulation to produce the next frame's audio. The device drains the buffer
+ * in real time, so the thread sleeps for exactly the excess.
+ */
+void FramePacer::waitForAudio() {
+    uint32_t queued;
+    while ((queued = apu->queuedAudioMs()) > apu->audioLatencyMs())
+        std::this_thread::sleep_for(std::chrono::milliseconds(queued - apu->audioLatencyMs()));
+}
+
+/**
+ * @param m A pacing strategy.
+ * @return Its name, as accepted by --pacing.
+ */
+const char* FramePacer::modeName(Mode m) {
+    switch (m) {
+        case Mode::uncapped: return "uncapped";
+        case Mode::speed:    return "speed";
+        case Mode::precise:  return "precise";
+        case Mode::audio:    return "audio";
+    }
+    return "";
+}
+
+/**
+ * @param name The name of a pacing strategy, as returned by modeName.
+ * @return The strategy, or 'audio' if there is none with that name.
+ */
+FramePacer::Mode FramePacer::modeFromName(const char* name) {
+    for (Mode m : { Mode::uncapped, Mode::speed, Mode::precise }) {
+        if (std::strcmp(name, modeName(m)) == 0)
+            return m;
+    }
+    return Mode::audio;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "common.hpp"
+#include "APU.hpp"
+
+/**
+ * Keeps the emulation running at the speed of a real Game Boy (or a multiple of it), one frame at a time.
+ *
+ * The PPU only counts the frames it completes (including the frames it would have displayed while the LCD is off),
+ * and the CPU thread hands each of them to FramePacer::frameComplete (see GB::cpuRun), which waits according to the
+ * selected strategy:
+ * - uncapped: Never waits, for benchmarks and running many instances.
+ * - speed:    Sleeps until the frame's deadline, 59.73 Hz times the speed multiplier. Cheap, but only as precise as
+ *             the OS scheduler.
+ * - precise:  Sleeps until shortly before the deadline and spins for the rest, to hit it within microseconds.
+ * - audio:    Waits until the APU's ring buffer has drained down to its target latency, so that the audio device's
+ *             clock sets the pace and the audio never underruns nor piles up. Without an audio device, it behaves
+ *             like 'precise'.
+ * Deadlines follow each other by exactly one frame period, so sleeping too long on one frame is made up for on the
+ * next ones, but after a stall (e.g. a file dialog, or a breakpoint) the pacer starts over instead of racing ahead.
+ */
+class FramePacer {
+public:
+    FramePacer(APU* a);
+    ~FramePacer();
+
+public:
+    enum class Mode { uncapped, speed, precise, audio };
+
+    static constexpr double GB_FRAME_RATE = 4194304.0 / 70224.0; // 59.7275 Hz: T-cycles per second / per frame
+
+    void   setMode(Mode m);
+    Mode   getMode() const { return mode; }
+    void   setSpeed(double multiplier); // Used by 'speed' and 'precise' (1 = real Game Boy speed)
+    double getSpeed() const { return speed; }
+
+    bool     frameComplete();           // Waits for the frame's deadline; returns true once per second (see fps())
+    uint32_t fps() const { return measuredFPS; } // Frames completed during the last second
+
+    static const char* modeName(Mode m);
+    static Mode        modeFromName(const char* name); // The default mode (audio) if the name is unknown
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr auto SPIN_MARGIN  = std::chrono::milliseconds(2);  // Left to spin on in 'precise' mode
+    static constexpr auto MAX_LATENESS = std::chrono::milliseconds(50); // Lateness after which pacing starts over
+
+    void waitUntil(Clock::time_point deadline, bool spin);
+    void waitForAudio();
+
+    Mode   mode  = Mode::audio;
+    double speed = 1.0;
+
+    Clock::duration   framePeriod;  // Time between two frames at the current speed
+    Clock::time_point nextDeadline; // When the next frame is due (speed and precise modes)
+    bool              restart = true; // Set when the next deadline has to be measured from now
+
+    Clock::time_point secondStart;       // Start of the second in which the FPS are counted
+    uint32_t          framesThisSecond = 0;
+    uint32_t          measuredFPS      = 0;
+
+private:
+    APU* apu; // For the ring buffer's fill level
+};
@@ -140,25 +140,31 @@ GB::GB() {
 
 
     // Connect all components
+    scheduler = new Scheduler();
     intHandler = new InterruptHandler();
-    timer = new Timer(intHandler);
+    timer = new Timer(intHandler, scheduler);
     joypad = new Joypad(intHandler);
-    serial = new Serial(intHandler, timer);
+    serial = new Serial(intHandler, timer, scheduler);
 
     lcd = new LCD(nullptr, intHandler);
-    ppu = new PPU(cartridge, lcd, intHandler);
+    ppu = new PPU(cartridge, lcd, intHandler, scheduler);
     lcd->ConnectPPU(ppu);
 
-    dma = new DMA(nullptr, ppu);
+    dma = new DMA(nullptr, ppu, scheduler);
     lcd->ConnectDMA(dma);
 
-    apu = new APU();
+    apu = new APU(scheduler);
     io = new IO(intHandler, timer, dma, lcd, joypad, apu, serial);
 
-    bus = new Bus(ppu, cartridge, io, intHandler, timer, dma);
+    blockCache = new BlockCache(cartridge);
+    bus = new Bus(ppu, cartridge, io, intHandler, timer, dma, blockCache);
     dma->ConnectBus(bus);
+    blockCache->ConnectBus(bus);
 
-    cpu = new SM83(bus, intHandler, timer, this);
+    jit = new JIT();
+    cpu = new SM83(bus, intHandler, timer, this, blockCache, jit);
+
+    pacer = new FramePacer(apu);
 
     ui = new UI(bus, ppu, this, joypad);
 }
@@ -185,11 +191,74 @@ void GB::cpuRun() {
         serial->init();
     }
 
-    // Run the game ROM.
+    // Run the game ROM, pacing it whenever the PPU completes a frame.
+    uint32_t pacedFrames = ppu->framesRendered;
     while (running) {
         if (!cpu->step())
             printf("CPU STOPPED\n");
+
+        if (ppu->framesRendered != pacedFrames) {
+            pacedFrames = ppu->framesRendered;
+            frameComplete();
+        }
+    }
+}
+
+/**
+ * Called on the CPU thread after the PPU completed a frame. Queues the frame's audio, waits until the next frame is
+ * due (see FramePacer), and once per second, logs the frame rate and other statistics and saves the cartridge's RAM
+ * if it changed.
+ */
+void GB::frameComplete() {
+    runCommands(); // Apply the settings changed from the UI between two frames
+
+    apu->endFrame(); // Queue the frame's audio before waiting, so that the audio pacing sees it
+
+    if (!pacer->frameComplete())
+        return;
+
+    printf("FPS: %u\n", pacer->fps());
+    if (ppu->getFrameSkip()) // Log how many frames were actually drawn.
+        printf("Frames drawn: %u, skipped: %u\n", ppu->framesDrawn(), ppu->framesSkipped());
+    if (ppu->frameBuffer.framesDropped() || ppu->frameBuffer.framesRepeated()) // Log the frames the UI missed.
+        printf("Frames dropped: %u, repeated: %u\n", ppu->frameBuffer.framesDropped(),
+               ppu->frameBuffer.framesRepeated());
+    if (apu->audioUnderruns() || apu->audioOverruns()) // Log the audio the device missed or the APU dropped.
+        printf("Audio underruns: %u, overruns: %u\n", apu->audioUnderruns(), apu->audioOverruns());
+    uint64_t idleCycles = cpu->idleCyclesSkipped();
+    if (cpu->isIdleSkipEnabled() && pacer->fps()) // Log the M-cycles skipped in polling loops, averaged per frame.
+        printf("Idle M-cycles skipped per frame: %llu\n",
+               static_cast<unsigned long long>((idleCycles - loggedIdleCycles) / pacer->fps()));
+    loggedIdleCycles = idleCycles;
+
+    if (cartridge->needsToSave()) // Save the cartridge if it needs to be saved.
+        cartridge->save();
+}
+
+/**
+ * Hands a command to the CPU thread, which runs it between two frames (see GB::frameComplete). The CPU, the PPU and
+ * the frame pacer are only ever touched from the CPU thread while it runs, so this is how the UI changes their
+ * settings: a switch of renderer or of interpreter then never happens in the middle of a scanline or of a block.
+ *
+ * @param command The command to run on the CPU thread.
+ */
+void GB::post(std::function<void()> command) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(std::move(command));
+}
+
+/**
+ * Runs the commands posted since the last frame, in the order they were posted.
+ */
+void GB::runCommands() {
+    std::vector<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        pending.swap(commands);
     }
+
+    for (auto& command : pending)
+        command();
 }
 
 /**
@@ -205,14 +274,26 @@ void GB::emuRun() {
     cpuThread = std::thread(&GB::cpuRun, this);
 
     // Main loop.
-    uint32_t prevFramesRendered = 0;
+    bool readyForFrame = true; // Whether the last frame was presented since a frame was last requested
     while (!die) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        ui->handleEvents();
-        // Update the UI if a new frame has been rendered.
-        if (prevFramesRendered != ppu->framesRendered)
+        // Request the next frame once the last one was presented, so that with the 'unrequested' frame skip the PPU
+        // only draws the frames the UI gets to show (see PPU::SKIP_UNREQUESTED). Other frame skips ignore it.
+        if (readyForFrame) {
+            post([ppu = ppu] {
+                if (ppu->getFrameSkip() == PPU::SKIP_UNREQUESTED)
+                    ppu->requestFrame();
+            });
+            readyForFrame = false;
+        }
+
+        // Sleep until there's input, the PPU publishes a frame, or the debug window is due for a refresh.
+        ui->handleEvents(ui->idleTimeout());
+        // Update the UI if the PPU has published a new frame (skipped frames aren't published).
+        if (ppu->frameBuffer.hasNewFrame()) {
             ui->update();
-        prevFramesRendered = ppu->framesRendered;
+            readyForFrame = true;
+        }
+        ui->updateDebugWindow(); // Throttled to its own refresh rate (see UI::setDebugRefreshRate)
     }
 
     // Stop the CPU thread.
@@ -225,19 +306,31 @@ void GB::emuRun() {
 *
 * The Game Boy CPU operates at 4.194304 MHz (~4 million cycles per second), with each machine
 * cycle (M-cycle) consisting of four clock cycles (T-cycles). This function advances the Game
-* Boy's hardware components by the specified number of M-cycles, with each component being updated
-* accordingly. Each call to a component's tick method represents the passage of one T-cycle.
+* Boy's hardware components by the specified number of M-cycles.
+*
+* Instead of ticking every component on every T-cycle, the components register the T-cycle of their
+* next interesting event with the scheduler (see Scheduler.hpp), and only the events that fall within
+* the emulated cycles are dispatched, in chronological order. The PPU and the timer are only woken up
+* when they may request an interrupt and are otherwise caught up lazily whenever their registers or
+* memory are accessed (see PPU::sync and Timer::sync).
 *
 * @param mCycles The number of M-cycles to emulate. Each M-cycle is four T-cycles.
 */
 void GB::emulateCycles(int mCycles) {
-    for (int m = 0; m < mCycles; m++) {
-        for (int t = 0; t < 4; ++t, ++ticks) {
-            timer->tick();
-            ppu->tick();
-            apu->tick();
-            serial->tick();
+    uint64_t target = ticks + 4 * mCycles;
+
+    while (scheduler->nextEventTime() <= target) {
+        Scheduler::Event event = scheduler->popNextEvent();
+        switch (event) {
+            case Scheduler::Event::timer:  timer->handleEvent();  break;
+            case Scheduler::Event::ppu:    ppu->step(scheduler->now()); break;
+            case Scheduler::Event::apu:    apu->handleEvent();    break;
+            case Scheduler::Event::serial: serial->handleEvent(); break;
+            case Scheduler::Event::dma:    dma->tick();           break;
+            default:                                              break;
         }
-        dma->tick();
     }
+
+    ticks = target;
+    scheduler->advanceTo(target);
 }
@@ -14,9 +14,15 @@
 #include "Joypad.hpp"
 #include "APU.hpp"
 #include "Serial.hpp"
+#include "Scheduler.hpp"
+#include "BlockCache.hpp"
+#include "JIT.hpp"
+#include "FramePacer.hpp"
 
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <functional>
 
 class SM83;
 
@@ -31,6 +37,15 @@ public:
     void cpuRun();
     void emuRun();
     void emulateCycles(int cpuCycles);
+    void post(std::function<void()> command); // Runs a command on the CPU thread once the current frame is complete
+
+private:
+    void frameComplete(); // Paces the emulation and does the once-per-second chores after the PPU completed a frame
+    void runCommands();   // Runs the commands posted since the last frame
+
+    std::mutex                         commandMutex; // Guards 'commands'
+    std::vector<std::function<void()>> commands;     // Posted by other threads (see GB::post)
+    uint64_t loggedIdleCycles = 0; // SM83::idleCyclesSkipped() when the stats were last logged
 
 public:
     bool die       = false;
@@ -51,4 +66,8 @@ public:
     Joypad* joypad;
     APU* apu;
     Serial* serial;
+    Scheduler* scheduler;
+    BlockCache* blockCache;
+    JIT* jit;
+    FramePacer* pacer;
 };
@@ -9,76 +9,75 @@ IO::IO(InterruptHandler* ih, Timer* t, DMA* d, LCD* l, Joypad* j, APU* a, Serial
 , lcd(l)
 , joypad(j)
 , apu(a)
-, serial(s) {}
+, serial(s) {
+    mapRegisters();
+}
 
 IO::~IO() = default;
 
-// See: https://gbdev.io/pandocs/Hardware_Reg_List.html
-uint8_t IO::read(uint16_t addr) {
-    if (addr == 0xFF00)
-        return joypad->read();
-
-    if (addr < 0xFF03)
-        return serial->read(addr);
-
-    if (addr == 0xFF03)
-        printf("UNMAPPED I/O read(%04X) \n", addr);
-
-
-    if (0xFF04 <= addr && addr <= 0xFF07)
-        return timer->read(addr);
-
-    if (addr == 0xFF0F)
-        return intHandler->read(addr);
-
-    if (0xFF10 <= addr && addr <= 0xFF3F)
-        return apu->read(addr);
-
-    if (0xFF40 <= addr && addr <= 0xFF4B)
-        return lcd->read(addr);
-
-//    printf("UNSUPPORTED I/O read(%04X) \n", addr);
-    return 0xFF;
+/**
+ * Builds the table that maps each I/O register to the functions reading and writing it, bound to the device
+ * they're called on. The registers games poll the most (JOYP, DIV, IF, STAT and LY) get functions of their own,
+ * so that reading them is a single indirect call rather than a range check here and a switch in the device.
+ * See: https://gbdev.io/pandocs/Hardware_Reg_List.html
+ */
+void IO::mapRegisters() {
+    // Unmapped registers read 0xFF and ignore writes.
+    map(0xFF00, 0xFF7F, nullptr,
+        [](void*, uint16_t) -> uint8_t { return 0xFF; },
+        [](void*, uint16_t, uint8_t) {});
+
+    map(0xFF00, 0xFF00, joypad, // JOYP
+        [](void* d, uint16_t) { return static_cast<Joypad*>(d)->read(); },
+        [](void* d, uint16_t, uint8_t data) { static_cast<Joypad*>(d)->write(data); });
+
+    map(0xFF01, 0xFF02, serial, // SB, SC
+        [](void* d, uint16_t addr) { return static_cast<Serial*>(d)->read(addr); },
+        [](void* d, uint16_t addr, uint8_t data) { static_cast<Serial*>(d)->write(addr, data); });
+
+    map(0xFF03, 0xFF03, nullptr,
+        [](void*, uint16_t addr) -> uint8_t { printf("UNMAPPED I/O read(%04X) \n", addr); return 0xFF; },
+        [](void*, uint16_t addr, uint8_t) { printf("UNMAPPED I/O write(%04X)\n", addr); });
+
+    map(0xFF04, 0xFF07, timer, // DIV, TIMA, TMA, TAC
+        [](void* d, uint16_t addr) { return static_cast<Timer*>(d)->read(addr); },
+        [](void* d, uint16_t addr, uint8_t data) { static_cast<Timer*>(d)->write(addr, data); });
+
+    map(0xFF04, 0xFF04, this,   // DIV
+        [](void* d, uint16_t) { return static_cast<IO*>(d)->timer->readDIV(); },
+        [](void* d, uint16_t addr, uint8_t data) {
+            // The serial clock is derived from the system clock, so it has to know before DIV is reset.
+            auto* io = static_cast<IO*>(d);
+            io->serial->onDIVReset();
+            io->timer->write(addr, data);
+        });
+
+    map(0xFF0F, 0xFF0F, intHandler, // IF
+        [](void* d, uint16_t) { return static_cast<InterruptHandler*>(d)->readIF(); },
+        [](void* d, uint16_t addr, uint8_t data) { static_cast<InterruptHandler*>(d)->write(addr, data); });
+
+    map(0xFF10, 0xFF3F, apu,    // Audio registers and wave RAM
+        [](void* d, uint16_t addr) { return static_cast<APU*>(d)->read(addr); },
+        [](void* d, uint16_t addr, uint8_t data) { static_cast<APU*>(d)->write(addr, data); });
+
+    map(0xFF40, 0xFF4B, lcd,    // LCDC, STAT, SCY, SCX, LY, LYC, DMA, BGP, OBP0, OBP1, WY, WX
+        [](void* d, uint16_t addr) { return static_cast<LCD*>(d)->read(addr); },
+        [](void* d, uint16_t addr, uint8_t data) { static_cast<LCD*>(d)->write(addr, data); });
+
+    registers[0x41].read = [](void* d, uint16_t) { return static_cast<LCD*>(d)->readSTAT(); };
+    registers[0x44].read = [](void* d, uint16_t) { return static_cast<LCD*>(d)->readLY(); };
 }
 
-void IO::write(uint16_t addr, uint8_t data) {
-    if (addr == 0xFF00) {
-        joypad->write(data);
-        return;
-    }
-
-    if (addr < 0xFF03) {
-        serial->write(addr, data);
-        return;
-    }
-
-    if (addr == 0xFF03) {
-        printf("UNMAPPED I/O write(%04X)\n", addr);
-        return;
-    }
-
-    if (0xFF04 <= addr && addr <= 0xFF07) {
-        timer->write(addr, data);
-        return;
-    }
-
-    if (addr == 0xFF0F) {
-        intHandler->write(addr, data);
-        return;
-    }
-
-    if (0xFF10 <= addr && addr <= 0xFF3F) {
-        apu->write(addr, data);
-        return;
-    }
-
-    if (0xFF40 <= addr && addr <= 0xFF4B) {
-        lcd->write(addr, data);
-        return;
-    }
-
-//    printf("UNSUPPORTED I/O write(%04X)\n", addr);
+/**
+ * Maps a range of I/O registers to the same functions.
+ *
+ * @param first The address of the first register.
+ * @param last The address of the last register (inclusive).
+ * @param device The device the functions are called on.
+ * @param read The function reading a register of the range.
+ * @param write The function writing a register of the range.
+ */
+void IO::map(uint16_t first, uint16_t last, void* device, ReadFn read, WriteFn write) {
+    for (uint16_t addr = first; addr <= last; addr++)
+        registers[addr & 0x7F] = { read, write, device };
 }
-
-
-
@@ -15,8 +15,15 @@ public:
     ~IO();
 
 public:
-    uint8_t read(uint16_t addr);
-    void    write(uint16_t addr, uint8_t data);
+    // Dispatches straight to the register's handler (see IO::mapRegisters).
+    uint8_t read(uint16_t addr) {
+        const Register& reg = registers[addr & 0x7F];
+        return reg.read(reg.device, addr);
+    }
+    void write(uint16_t addr, uint8_t data) {
+        const Register& reg = registers[addr & 0x7F];
+        reg.write(reg.device, addr, data);
+    }
 
 private:
     Timer* timer;
@@ -26,4 +33,20 @@ private:
     Joypad* joypad;
     APU* apu;
     Serial* serial;
-};
\ No newline at end of file
+
+private:
+    using ReadFn  = uint8_t (*)(void* device, uint16_t addr);
+    using WriteFn = void    (*)(void* device, uint16_t addr, uint8_t data);
+
+    // An I/O register (0xFF00-0xFF7F): the functions reading and writing it, and the device they're bound to.
+    struct Register {
+        ReadFn  read;
+        WriteFn write;
+        void*   device;
+    };
+
+    std::array<Register, 0x80> registers; // Indexed by addr & 0x7F
+
+    void mapRegisters(); // Builds the register table
+    void map(uint16_t first, uint16_t last, void* device, ReadFn read, WriteFn write);
+};
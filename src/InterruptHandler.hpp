@@ -13,6 +13,7 @@ public:
 public:
     uint8_t read(uint16_t addr) const;          // Read IF and IE registers
     void    write(uint16_t addr, uint8_t data); // Write IF and IE registers
+    uint8_t readIF() const { return IF | 0b11100000; } // Read IF (bits 5-7 are unused)
 
     // Enumerates the different interrupt types and their corresponding bits in the IF and
     // IE registers. Each type is associated with a specific memory address (source address)
@@ -0,0 +1,356 @@
+#include "JIT.hpp"
+
+#include <cstddef>
+
+#if JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+namespace {
+    // Offsets of the registers in JIT::State, used as 8-bit displacements from RDI (the state pointer).
+    constexpr uint8_t OFF_F  = offsetof(JIT::State, f);
+    constexpr uint8_t OFF_A  = offsetof(JIT::State, a);
+    constexpr uint8_t OFF_SP = offsetof(JIT::State, sp);
+    constexpr uint8_t OFF_PC = offsetof(JIT::State, pc);
+
+    // Offsets of the 8-bit registers in SM83 encoding order: B, C, D, E, H, L, (HL), A.
+    constexpr std::array<int, 8> REG8 = {
+        offsetof(JIT::State, b), offsetof(JIT::State, c), offsetof(JIT::State, d), offsetof(JIT::State, e),
+        offsetof(JIT::State, h), offsetof(JIT::State, l), -1,                      offsetof(JIT::State, a),
+    };
+
+    // Offsets of the 16-bit registers in SM83 encoding order: BC, DE, HL, SP.
+    constexpr std::array<uint8_t, 4> REG16 = {
+        offsetof(JIT::State, c), offsetof(JIT::State, e), offsetof(JIT::State, l), OFF_SP,
+    };
+
+    // x86 opcodes of the 8-bit ALU operations in SM83 encoding order (ADD, ADC, SUB, SBC, AND, XOR, OR, CP),
+    // with a memory operand ('op al, [rdi+disp8]') and with an immediate operand ('op al, imm8').
+    constexpr std::array<uint8_t, 8> ALU_MEM = { 0x02, 0x12, 0x2A, 0x1A, 0x22, 0x32, 0x0A, 0x3A };
+    constexpr std::array<uint8_t, 8> ALU_IMM = { 0x04, 0x14, 0x2C, 0x1C, 0x24, 0x34, 0x0C, 0x3C };
+}
+
+JIT::JIT() {
+#if JIT_SUPPORTED
+    void* mem = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        std::cerr << "JIT: Failed to allocate code buffer, falling back to the interpreter" << std::endl;
+        return;
+    }
+    code = static_cast<uint8_t*>(mem);
+    capacity = CODE_SIZE;
+    mprotect(code, capacity, PROT_READ | PROT_EXEC);
+#endif
+}
+
+JIT::~JIT() {
+#if JIT_SUPPORTED
+    if (code)
+        munmap(code, capacity);
+#endif
+}
+
+/**
+ * Translates the longest translatable prefix of a block into native code. If the prefix is followed by a JR/JP
+ * to a constant address (the block's last instruction), the branch is translated as well. The generated function
+ * updates the registers in the JIT::State passed to it, sets PC to the address of the next instruction to
+ * execute, and returns the number of M-cycles the instructions would have taken on the interpreter.
+ *
+ * @param block The block to translate.
+ * @param maxCycles Set to the maximum number of M-cycles the translated code may take.
+ * @return The native code, or nullptr if the block's prefix is too short to be worth translating.
+ */
+const void* JIT::translate(const BlockCache::Block& block, uint8_t& maxCycles) {
+    if (!code || !hasSpace())
+        return nullptr;
+
+    size_t count = 0;
+    while (count < block.ops.size() && isTranslatable(block.ops[count]))
+        count++;
+    bool branch = count < block.ops.size() && isBranch(block.ops[count]);
+    if (count + branch < MIN_OPS)
+        return nullptr;
+
+#if JIT_SUPPORTED
+    mprotect(code, capacity, PROT_READ | PROT_WRITE);
+#endif
+    pos = used;
+    uint8_t cycles = 0;
+    for (size_t i = 0; i < count; i++) {
+        emitOp(block.ops[i]);
+        cycles += cyclesOf(block.ops[i]);
+    }
+    if (branch) {
+        maxCycles = cycles + (block.ops[count].opcode & 0x80 ? 4 : 3); // Taken JP nn (4) or JR e (3)
+        emitBranch(block.ops[count], cycles);
+    } else {
+        maxCycles = cycles;
+        const BlockCache::Op& last = block.ops[count - 1];
+        emitExit(last.pc + last.length, cycles);
+    }
+#if JIT_SUPPORTED
+    mprotect(code, capacity, PROT_READ | PROT_EXEC);
+#endif
+
+    const void* entry = code + used;
+    used = (pos + 15) & ~static_cast<size_t>(15); // Keep blocks 16-byte aligned
+    return entry;
+}
+
+/**
+ * Runs translated code on the given registers.
+ *
+ * @param native The code returned by JIT::translate.
+ * @param state The registers to operate on.
+ * @return The number of M-cycles the executed instructions take.
+ */
+uint32_t JIT::run(const void* native, State& state) const {
+    auto fn = reinterpret_cast<uint32_t (*)(State*)>(const_cast<void*>(native));
+    return fn(&state);
+}
+
+/**
+ * @return True if the buffer can hold another block, false if it needs to be flushed first.
+ */
+bool JIT::hasSpace() const {
+    return capacity - used >= MAX_BLOCK_CODE;
+}
+
+/**
+ * Drops all translated code. The caller must forget every pointer returned by JIT::translate.
+ */
+void JIT::flush() {
+    used = 0;
+}
+
+/**
+ * Checks if an instruction only operates on registers, i.e., if it can be translated without having to
+ * go through the bus and without affecting control flow.
+ *
+ * @param op The instruction to check.
+ * @return True if the instruction can be translated.
+ */
+bool JIT::isTranslatable(const BlockCache::Op& op) {
+    uint8_t opc = op.opcode;
+    uint8_t dst = (opc >> 3) & 7;
+    uint8_t src = opc & 7;
+
+    switch (opc) {
+        case 0x00:                                  // NOP
+        case 0x07: case 0x0F: case 0x17: case 0x1F: // RLCA, RRCA, RLA, RRA
+        case 0x2F: case 0x37: case 0x3F:            // CPL, SCF, CCF
+            return true;
+        default:
+            break;
+    }
+
+    if (opc < 0x40) {
+        switch (opc & 0xCF) {
+            case 0x01: case 0x03: case 0x0B: return true;         // LD rr,d16 / INC rr / DEC rr
+            default:                         break;
+        }
+        switch (opc & 0xC7) {
+            case 0x04: case 0x05: case 0x06: return dst != 6;     // INC r / DEC r / LD r,d8
+            default:                         return false;
+        }
+    }
+    if (opc < 0x80)
+        return opc != 0x76 && src != 6 && dst != 6;               // LD r,r (HALT is 0x76)
+    if (opc < 0xC0)
+        return src != 6;                                          // ALU A,r
+    return (opc & 0xC7) == 0xC6;                                  // ALU A,d8
+}
+
+/**
+ * @param op The instruction to check.
+ * @return True if the instruction is a JR e, JR cc,e, JP nn or JP cc,nn.
+ */
+bool JIT::isBranch(const BlockCache::Op& op) {
+    uint8_t opc = op.opcode;
+    return opc == 0x18 || opc == 0xC3 || (opc & 0xE7) == 0x20 || (opc & 0xE7) == 0xC2;
+}
+
+/**
+ * @param op A translatable instruction (see JIT::isTranslatable).
+ * @return The M-cycles the instruction takes: one per byte fetched, plus one for 16-bit INC/DEC.
+ */
+uint8_t JIT::cyclesOf(const BlockCache::Op& op) {
+    uint8_t opc = op.opcode;
+    if (opc < 0x40 && ((opc & 0xCF) == 0x03 || (opc & 0xCF) == 0x0B))
+        return 2;
+    return op.length;
+}
+
+// Emitters ============================================================================================================
+// The generated code follows the System V calling convention: RDI holds the JIT::State pointer, only the
+// caller-saved registers EAX, ECX and EDX are used, and the M-cycles are returned in EAX. Each SM83 instruction
+// operates on the state in memory, so there's no register allocation to speak of. Flags are taken from the
+// x86 flags right after the equivalent x86 instruction: ZF, AF and CF match Z, H and C bit for bit (including
+// ADC/SBC, where the carry in is loaded into CF first), and N is known from the instruction itself.
+
+void JIT::emit(std::initializer_list<uint8_t> bytes) {
+    for (uint8_t b : bytes)
+        code[pos++] = b;
+}
+
+void JIT::emitOp(const BlockCache::Op& op) {
+    uint8_t opc = op.opcode;
+    uint8_t dst = (opc >> 3) & 7;
+    uint8_t src = opc & 7;
+    uint8_t imm = op.operand[0];
+
+    switch (opc) {
+        case 0x00: // NOP
+            return;
+        case 0x07: case 0x0F: case 0x17: case 0x1F: // RLCA, RRCA, RLA, RRA: Z=0, N=0, H=0, C=bit shifted out
+            if (opc >= 0x17)
+                emit({ 0x0F, 0xB6, 0x4F, OFF_F, 0x0F, 0xBA, 0xE1, 0x04 }); // movzx ecx, [F] ; bt ecx, 4
+            emit({ 0x0F, 0xB6, 0x47, OFF_A });                             // movzx eax, [A]
+            emit({ 0xD0, static_cast<uint8_t>(0xC0 | dst << 3) });         // rol/ror/rcl/rcr al, 1
+            emit({ 0x0F, 0x92, 0xC2, 0x0F, 0xB6, 0xD2, 0xC1, 0xE2, 0x04 }); // setc dl ; movzx edx, dl ; shl edx, 4
+            emit({ 0x88, 0x47, OFF_A });                                   // mov [A], al
+            emitStoreFlags();
+            return;
+        case 0x2F: // CPL: N=1, H=1
+            emit({ 0xF6, 0x57, OFF_A, 0x80, 0x4F, OFF_F, 0x60 });          // not [A] ; or [F], 0x60
+            return;
+        case 0x37: // SCF: N=0, H=0, C=1
+            emit({ 0x80, 0x67, OFF_F, 0x8F, 0x80, 0x4F, OFF_F, 0x10 });    // and [F], 0x8F ; or [F], 0x10
+            return;
+        case 0x3F: // CCF: N=0, H=0, C=!C
+            emit({ 0x80, 0x67, OFF_F, 0x9F, 0x80, 0x77, OFF_F, 0x10 });    // and [F], 0x9F ; xor [F], 0x10
+            return;
+        default:
+            break;
+    }
+
+    if (opc < 0x40) {
+        uint8_t rr = REG16[opc >> 4];
+        switch (opc & 0xCF) {
+            case 0x01: emit({ 0x66, 0xC7, 0x47, rr, op.operand[0], op.operand[1] }); return; // mov word [rr], d16
+            case 0x03: emit({ 0x66, 0xFF, 0x47, rr });                               return; // inc word [rr]
+            case 0x0B: emit({ 0x66, 0xFF, 0x4F, rr });                               return; // dec word [rr]
+            default:   break;
+        }
+
+        auto r = static_cast<uint8_t>(REG8[dst]);
+        switch (opc & 0xC7) {
+            case 0x06: // LD r,d8
+                emit({ 0xC6, 0x47, r, imm });                    // mov byte [r], d8
+                return;
+            case 0x04: case 0x05: // INC r / DEC r: Z, N and H are set, C is preserved
+                emit({ 0xFE, static_cast<uint8_t>(opc & 1 ? 0x4F : 0x47), r });  // inc/dec byte [r]
+                emit({ 0x9F, 0x0F, 0xB6, 0xCC, 0x83, 0xE1, 0x50, 0x01, 0xC9 });  // lahf ; movzx ecx, ah ;
+                                                                                 // and ecx, 0x50 ; add ecx, ecx
+                if (opc & 1)
+                    emit({ 0x83, 0xC9, 0x40 });                                  // or ecx, 0x40 (N)
+                emit({ 0x0F, 0xB6, 0x57, OFF_F, 0x83, 0xE2, 0x1F, 0x09, 0xCA }); // movzx edx, [F] ; and edx, 0x1F ;
+                emit({ 0x88, 0x57, OFF_F });                                     // or edx, ecx ; mov [F], dl
+                return;
+            default:
+                return;
+        }
+    }
+
+    if (opc < 0x80) { // LD r,r
+        emit({ 0x0F, 0xB6, 0x47, static_cast<uint8_t>(REG8[src]) }); // movzx eax, [src]
+        emit({ 0x88, 0x47, static_cast<uint8_t>(REG8[dst]) });       // mov [dst], al
+        return;
+    }
+
+    emitALU(dst, opc < 0xC0 ? REG8[src] : -1, imm);
+}
+
+/**
+ * Emits an 8-bit ALU operation on A.
+ *
+ * @param alu The operation in SM83 encoding order (ADD, ADC, SUB, SBC, AND, XOR, OR, CP).
+ * @param src The offset of the source register, or -1 for the immediate operand.
+ * @param imm The immediate operand.
+ */
+void JIT::emitALU(uint8_t alu, int src, uint8_t imm) {
+    if (alu == 1 || alu == 3)
+        emit({ 0x0F, 0xB6, 0x4F, OFF_F, 0x0F, 0xBA, 0xE1, 0x04 }); // movzx ecx, [F] ; bt ecx, 4 (CF = C)
+    emit({ 0x0F, 0xB6, 0x47, OFF_A });                             // movzx eax, [A]
+    if (src < 0)
+        emit({ ALU_IMM[alu], imm });                               // op al, d8
+    else
+        emit({ ALU_MEM[alu], 0x47, static_cast<uint8_t>(src) });   // op al, [src]
+
+    if (alu >= 4 && alu <= 6) { // AND, XOR, OR: Z is set, N=0, C=0, H=1 for AND and 0 otherwise
+        emit({ 0x0F, 0x94, 0xC2, 0x0F, 0xB6, 0xD2, 0xC1, 0xE2, 0x07 }); // setz dl ; movzx edx, dl ; shl edx, 7
+        if (alu == 4)
+            emit({ 0x83, 0xCA, 0x20 });                                  // or edx, 0x20 (H)
+    } else {
+        emitArithmeticFlags(alu >= 2);
+    }
+
+    if (alu != 7) // CP only sets the flags
+        emit({ 0x88, 0x47, OFF_A });                                     // mov [A], al
+    emitStoreFlags();
+}
+
+/**
+ * Emits the conversion of the x86 flags to the Z, N, H and C flags in EDX.
+ *
+ * @param subtract The value of N.
+ */
+void JIT::emitArithmeticFlags(bool subtract) {
+    emit({ 0x9F, 0x0F, 0xB6, 0xCC });             // lahf ; movzx ecx, ah   (SF ZF 0 AF 0 PF 1 CF)
+    emit({ 0x89, 0xCA, 0x83, 0xE2, 0x50 });       // mov edx, ecx ; and edx, 0x50
+    emit({ 0x01, 0xD2 });                         // add edx, edx            (ZF -> Z, AF -> H)
+    emit({ 0x83, 0xE1, 0x01, 0xC1, 0xE1, 0x04 }); // and ecx, 1 ; shl ecx, 4 (CF -> C)
+    emit({ 0x09, 0xCA });                         // or edx, ecx
+    if (subtract)
+        emit({ 0x83, 0xCA, 0x40 });               // or edx, 0x40            (N)
+}
+
+/**
+ * Emits the store of the flags in EDX to F, keeping the (unused) lower nibble of F as it is.
+ */
+void JIT::emitStoreFlags() {
+    emit({ 0x0F, 0xB6, 0x4F, OFF_F, 0x83, 0xE1, 0x0F }); // movzx ecx, [F] ; and ecx, 0x0F
+    emit({ 0x09, 0xCA, 0x88, 0x57, OFF_F });             // or edx, ecx ; mov [F], dl
+}
+
+/**
+ * Emits the return to the interpreter.
+ *
+ * @param pc The address of the next instruction to execute.
+ * @param cycles The M-cycles taken by the translated instructions.
+ */
+void JIT::emitExit(uint16_t pc, uint8_t cycles) {
+    emit({ 0x66, 0xC7, 0x47, OFF_PC, static_cast<uint8_t>(pc & 0xFF), static_cast<uint8_t>(pc >> 8) }); // mov [PC], pc
+    emit({ 0xB8, cycles, 0x00, 0x00, 0x00 });                                                             // mov eax, cycles
+    emit({ 0xC3 });                                                                                       // ret
+}
+
+/**
+ * Emits a JR/JP to a constant address, followed by the return to the interpreter.
+ *
+ * @param op The branch instruction (see JIT::isBranch).
+ * @param cycles The M-cycles taken by the translated instructions before the branch.
+ */
+void JIT::emitBranch(const BlockCache::Op& op, uint8_t cycles) {
+    uint8_t  opc     = op.opcode;
+    bool     jp      = opc & 0x80;
+    auto     next    = static_cast<uint16_t>(op.pc + op.length);
+    uint16_t target  = jp ? static_cast<uint16_t>(op.operand[0] | op.operand[1] << 8)
+                          : static_cast<uint16_t>(next + static_cast<int8_t>(op.operand[0]));
+    auto     taken   = static_cast<uint8_t>(cycles + (jp ? 4 : 3));
+    auto     skipped = static_cast<uint8_t>(cycles + (jp ? 3 : 2));
+
+    if (opc == 0x18 || opc == 0xC3) {
+        emitExit(target, taken);
+        return;
+    }
+
+    // Conditions NZ, Z, NC, C: Exit to the next instruction unless the condition holds.
+    uint8_t cond = (opc >> 3) & 3;
+    uint8_t mask = cond < 2 ? 0x80 : 0x10;
+    emit({ 0x66, 0xC7, 0x47, OFF_PC, static_cast<uint8_t>(next & 0xFF), static_cast<uint8_t>(next >> 8) }); // mov [PC], next
+    emit({ 0xB8, skipped, 0x00, 0x00, 0x00 });                                                                // mov eax, skipped
+    emit({ 0xF6, 0x47, OFF_F, mask });                                                                        // test [F], mask
+    emit({ static_cast<uint8_t>(cond & 1 ? 0x74 : 0x75), 0x0B });                                             // jz/jnz to the ret
+    emitExit(target, taken);                                                                                  // (11 bytes + ret)
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "common.hpp"
+#include "BlockCache.hpp"
+
+// The recompiler emits x86-64 machine code into memory mapped with mmap. On any other target it is compiled out
+// and the CPU always interprets (see JIT::isSupported).
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define JIT_SUPPORTED true
+#else
+#define JIT_SUPPORTED false
+#endif
+
+/**
+ * Dynamic recompiler translating hot blocks of the block cache (see BlockCache.hpp) into native x86-64 code.
+ *
+ * Only instructions that work on registers alone are translated: 8/16-bit loads of registers and immediates,
+ * 8-bit ALU operations, INC/DEC, the accumulator rotates, CPL/SCF/CCF and NOP, optionally followed by a JR/JP
+ * (conditional or not) to a constant address. A block is translated up to its first instruction that accesses
+ * memory, I/O, the stack or the interrupt flags, where the native code returns and the interpreter takes over.
+ * Since none of the translated instructions can be observed by the rest of the system, the M-cycles of a whole
+ * translated block can be accumulated and emulated in one go afterwards, as long as no interrupt could have been
+ * dispatched in between (see SM83::runNative). Bank switches and writes to RAM code invalidate blocks through the
+ * block cache's generation counter, exactly as for interpreted blocks.
+ *
+ * Translated code is stored in a fixed-size buffer. When it's full, all translations are dropped and blocks are
+ * translated again as they become hot.
+ */
+class JIT {
+public:
+    JIT();
+    ~JIT();
+
+public:
+    // The CPU registers as seen by native code. The 8-bit registers are laid out so that BC, DE, HL and AF are
+    // little-endian 16-bit words, which lets 16-bit register instructions operate on the pairs directly.
+    struct State {
+        uint8_t  c, b, e, d, l, h, f, a;
+        uint16_t sp, pc;
+    };
+
+    static constexpr uint32_t HOT_THRESHOLD  = 16;      // Times a block is entered before it is translated
+    static constexpr size_t   MIN_OPS        = 2;       // Minimum number of instructions worth translating
+    static constexpr size_t   CODE_SIZE      = 4 << 20; // Size of the buffer holding translated code (4 MiB)
+    static constexpr size_t   MAX_BLOCK_CODE = 4096;    // Upper bound of the code emitted for a single block
+
+public:
+    static bool isSupported() { return JIT_SUPPORTED; }
+
+    const void* translate(const BlockCache::Block& block, uint8_t& maxCycles); // Translates a block's prefix
+    uint32_t    run(const void* code, State& state) const;                    // Runs native code, returns M-cycles
+    bool        hasSpace() const;                                              // Room for another block?
+    void        flush();                                                       // Drops all translated code
+
+private:
+    static bool    isTranslatable(const BlockCache::Op& op); // Can an instruction be translated?
+    static bool    isBranch(const BlockCache::Op& op);       // JR/JP to a constant address?
+    static uint8_t cyclesOf(const BlockCache::Op& op);       // M-cycles of a (non-branch) instruction
+
+    // Emitters
+    void emit(std::initializer_list<uint8_t> bytes);
+    void emitOp(const BlockCache::Op& op);
+    void emitALU(uint8_t alu, int src, uint8_t imm);
+    void emitArithmeticFlags(bool subtract);
+    void emitStoreFlags();
+    void emitExit(uint16_t pc, uint8_t cycles);
+    void emitBranch(const BlockCache::Op& op, uint8_t cycles);
+
+private:
+    uint8_t* code     = nullptr; // Executable buffer
+    size_t   capacity = 0;       // Size of the buffer
+    size_t   used     = 0;       // Bytes of the buffer already taken by translated blocks
+    size_t   pos      = 0;       // Write position while translating a block
+};
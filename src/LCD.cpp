@@ -1,5 +1,6 @@
 #include "LCD.hpp"
 #include "DMA.hpp"
+#include "PPU.hpp"
 
 LCD::LCD(DMA* dma, InterruptHandler* ih)
 : dma(dma)
@@ -14,6 +15,7 @@ LCD::~LCD() = default;
  * @return The data at the given address.
  */
 uint8_t LCD::read(uint16_t addr) const {
+    ppu->sync(); // STAT and LY are only current once the PPU has caught up
     switch (addr) {
         case 0xFF40: return lcdControl;
         case 0xFF41: return lcdStatus | 0x80; // Bit 7 is unused
@@ -31,6 +33,22 @@ uint8_t LCD::read(uint16_t addr) const {
     }
 }
 
+/**
+ * @return The LCD Status Register (STAT), once the PPU has caught up.
+ */
+uint8_t LCD::readSTAT() const {
+    ppu->sync();
+    return lcdStatus | 0x80; // Bit 7 is unused
+}
+
+/**
+ * @return The current scanline (LY), once the PPU has caught up.
+ */
+uint8_t LCD::readLY() const {
+    ppu->sync();
+    return ly;
+}
+
 /**
  * Writes to LCD Registers.
  *
@@ -38,9 +56,22 @@ uint8_t LCD::read(uint16_t addr) const {
  * @param data The data to write.
  */
 void LCD::write(uint16_t addr, uint8_t data) {
+    ppu->sync(); // The PPU must render up to this point with the old values
+
+    // Registers affecting the pixels of a scanline that may already have been drawn (see PPU::fallBackToFIFO).
+    if (addr != 0xFF41 && addr != 0xFF44 && addr != 0xFF45 && addr != 0xFF46)
+        ppu->fallBackToFIFO();
+
     switch (addr) {
-        case 0xFF40: lcdControl = data; break;
-        case 0xFF41: lcdStatus  = data; break;
+        case 0xFF40:
+            lcdControl = data;
+            ppu->setLCDEnabled(data & lcdPPUEnable); // Turning the LCD off or on stops or restarts the PPU
+            break;
+        case 0xFF41:
+            // Bits 0-2 (PPU mode and LY=LYC flag) are read-only.
+            // The PPU keeps its mode there, so a write must not clobber them.
+            lcdStatus = (data & ~0x07) | (lcdStatus & 0x07);
+            break;
         case 0xFF42: scrollY    = data; break;
         case 0xFF43: scrollX    = data; break;
         case 0xFF44:                    break; // LY is read-only; do nothing
@@ -64,6 +95,10 @@ void LCD::write(uint16_t addr, uint8_t data) {
         case 0xFF4B: wx = data; break;
         default:                break;
     }
+
+    // STAT interrupt sources and LYC determine when the PPU may next request an interrupt.
+    if (addr == 0xFF41 || addr == 0xFF45)
+        ppu->scheduleNextEvent();
 }
 
 void LCD::init() {
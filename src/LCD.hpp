@@ -19,6 +19,8 @@ public:
     void    init();
     uint8_t read(uint16_t addr) const;
     void    write(uint16_t addr, uint8_t data);
+    uint8_t readSTAT() const; // Read STAT without going through LCD::read (polled a lot, see IO::mapRegisters)
+    uint8_t readLY() const;   // Read LY without going through LCD::read (polled a lot, see IO::mapRegisters)
 
 public:
     void ConnectPPU(PPU* n) { ppu = n; }
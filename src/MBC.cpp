@@ -2,7 +2,12 @@
 #include "Cartridge.hpp"
 #include "Battery.hpp"
 
-MBC::MBC(uint8_t* pRom, Cartridge* pCartridge) : rom(pRom), cartridge(pCartridge), ramBanks() {}
+// Without an MBC, the 32KB of ROM are mapped as is: 0x4000-0x7FFF always holds bank 01.
+MBC::MBC(uint8_t* pRom, Cartridge* pCartridge)
+: rom(pRom)
+, romBankX(pRom + 0x4000)
+, cartridge(pCartridge)
+, ramBanks() {}
 
 MBC::MBC(uint8_t *pRom, int nRomBanks, int nRamBanks, Cartridge* pCartridge)
 : rom(pRom)
@@ -31,6 +36,18 @@ MBC::MBC(uint8_t *pRom, int nRomBanks, int nRamBanks, Cartridge* pCartridge)
 
 MBC::~MBC() = default;
 
+/**
+ * Returns the ROM bank mapped at the given address, for accessing it directly (see Bus::mapCartridge).
+ *
+ * @param addr An address in ROM (0x0000-0x7FFF).
+ * @return Pointer to the first byte of the 16KB bank containing the address.
+ */
+uint8_t* MBC::mappedROM(uint16_t addr) const {
+    if (addr < 0x4000) // Bank 00
+        return rom;
+    return romBankX;
+}
+
 // MBC0 (No MBC) =======================================================================================================
 uint8_t MBC0::read(uint16_t addr) const {
     if (addr < 0x8000)
@@ -17,8 +17,11 @@ public:
     ~MBC();
 
 public:
-    virtual uint8_t read(uint16_t addr) const = 0;
-    virtual void    write(uint16_t addr, uint8_t data) = 0;
+    virtual uint8_t  read(uint16_t addr) const = 0;
+    virtual void     write(uint16_t addr, uint8_t data) = 0;
+    uint16_t         romBank() const { return (romBankX - rom) / 0x4000; } // Bank mapped to 0x4000-0x7FFF
+    uint8_t*         mappedROM(uint16_t addr) const;                      // ROM bank mapped at a ROM address
+    virtual uint8_t* mappedRAM() const { return nullptr; }               // Plain RAM mapped to 0xA000-0xBFFF
 
 protected:
     uint8_t* rom;
@@ -49,8 +52,9 @@ public:
     using MBC::MBC; // Inherit constructors from MBC
 
 public:
-    uint8_t read(uint16_t addr) const override;
-    void    write(uint16_t addr, uint8_t data) override;
+    uint8_t  read(uint16_t addr) const override;
+    void     write(uint16_t addr, uint8_t data) override;
+    uint8_t* mappedRAM() const override { return ramEnabled ? ramBank : nullptr; }
 
 protected:
     bool ramEnabled = false;    // RAM enable/disable
@@ -65,8 +69,9 @@ public:
 
 public:
 
-    uint8_t read(uint16_t addr) const override;
-    void    write(uint16_t addr, uint8_t data) override;
+    uint8_t  read(uint16_t addr) const override;
+    void     write(uint16_t addr, uint8_t data) override;
+    uint8_t* mappedRAM() const override { return nullptr; } // Half-byte RAM, always goes through MBC2::read
 
 public:
     uint8_t ram[512]; // Internal RAM (512 half-bytes)
@@ -1,19 +1,23 @@
 #include "PPU.hpp"
 
-PPU::PPU(Cartridge* c, LCD* l, InterruptHandler* ih)
-: cartridge(c)
-, lcd(l)
-, intHandler(ih)
-, pixelFifo()
+#include <algorithm>
+#include <limits>
+
+PPU::PPU(Cartridge* c, LCD* l, InterruptHandler* ih, Scheduler* s)
+: frameBuffer()
+, scanlineOAMBuffer()
 , fetchedSprites()
-, oam()
+, pixelFifo()
 , vram()
-, videoBuffer()
-, scanlineOAMBuffer() {
+, oam()
+, cartridge(c)
+, lcd(l)
+, intHandler(ih)
+, scheduler(s) {
     setMode(PPUMode::oam);
     std::fill(oam.begin(), oam.end(), Sprite());
     std::fill(vram.begin(), vram.end(), 0);
-    std::fill(videoBuffer.begin(), videoBuffer.end(), 0);
+    scheduleNextEvent();
 }
 
 PPU::~PPU() = default;
@@ -25,6 +29,7 @@ PPU::~PPU() = default;
  * @return The byte of data at the specified address.
  */
 uint8_t PPU::read(uint16_t addr) {
+    sync();
     if (addr >= 0x8000 && addr <= 0x9FFF) // VRAM
         return readVRAM(addr);
     else if (addr >= 0xFE00 && addr <= 0xFE9F) // OAM
@@ -40,8 +45,11 @@ uint8_t PPU::read(uint16_t addr) {
  * @param data The byte of data to write to the specified address.
  */
 void PPU::write(uint16_t addr, uint8_t data) {
-    if (addr >= 0x8000 && addr <= 0x9FFF) // VRAM
+    sync();
+    if (addr >= 0x8000 && addr <= 0x9FFF) { // VRAM
+        fallBackToFIFO(); // The rest of the scanline must be drawn with the new data
         writeVRAM(addr, data);
+    }
     else if (addr >= 0xFE00 && addr <= 0xFE9F) // OAM
         writeOAM(addr, data);
     else
@@ -77,6 +85,12 @@ uint8_t PPU::readVRAM(uint16_t addr) {
  */
 void PPU::writeVRAM(uint16_t addr, uint8_t data) {
     vram[addr - 0x8000] = data;
+    if (addr < 0x9800) {
+        tileCache.update(vram.data(), addr);
+        dirtyTiles.mark((addr - 0x8000) / 16);
+    } else {
+        dirtyMap.mark(addr - 0x9800);
+    }
 }
 
 /**
@@ -104,7 +118,34 @@ uint8_t PPU::readOAM(uint16_t addr) {
  */
 void PPU::writeOAM(uint16_t addr, uint8_t data) {
     auto* p = reinterpret_cast<uint8_t*>(&oam);
-    p[addr - 0xFE00] = data;
+    uint8_t offset = addr - 0xFE00;
+
+    // Byte 0 of an entry is its Y position: move the sprite to the scanlines it now overlaps.
+    if (offset % 4 == 0 && p[offset] != data)
+        updateSpritesOnLine(offset / 4, p[offset], data);
+
+    p[offset] = data;
+    dirtySprites.mark(offset / 4);
+}
+
+/**
+ * Updates the scanline index (see PPU::spritesOnLine) after a sprite's Y position changed. Both sprite heights are
+ * indexed, since the height can be switched at any time through LCDC.
+ *
+ * @param sprite The sprite's index in OAM (0-39).
+ * @param oldY The sprite's previous Y position (screen Y + 16).
+ * @param newY The sprite's new Y position (screen Y + 16).
+ */
+void PPU::updateSpritesOnLine(uint8_t sprite, uint8_t oldY, uint8_t newY) {
+    uint64_t bit = 1ull << sprite;
+
+    for (int tall = 0; tall < 2; tall++) {
+        int height = tall ? 16 : 8;
+        for (int line = std::max(oldY - 16, 0); line < std::min(oldY - 16 + height, +LCD::Y_RESOLUTION); line++)
+            spritesOnLine[tall][line] &= ~bit;
+        for (int line = std::max(newY - 16, 0); line < std::min(newY - 16 + height, +LCD::Y_RESOLUTION); line++)
+            spritesOnLine[tall][line] |= bit;
+    }
 }
 
 /**
@@ -126,6 +167,151 @@ uint8_t PPU::getMode() const {
     return lcd->lcdStatus & 0b11;
 }
 
+/**
+ * Returns the number of dots until the current mode next does something, i.e., until PPU::tick would do more
+ * than increment the dot counter. Mode 3 (Transfer) runs the pixel fetcher on every dot, whereas modes 2, 0 and 1
+ * only act on a few specific dots of the scanline (see the mode handlers below).
+ *
+ * @return The number of dots until the next step of the PPU state machine (at least 1).
+ */
+uint16_t PPU::dotsUntilNextStep() const {
+    switch (getMode()) {
+        case static_cast<uint8_t>(PPUMode::oam):
+            if (dots < 1)  return 1 - dots;  // OAM scan
+            if (dots < 80) return 80 - dots; // Transition to Transfer Mode
+            break;
+        case static_cast<uint8_t>(PPUMode::hBlank):
+            if (firstLineAfterOn && dots < 80) return 80 - dots; // Transition to Transfer Mode (see PPU::setLCDEnabled)
+            [[fallthrough]];
+        case static_cast<uint8_t>(PPUMode::vBlank):
+            if (dots < DOTS_PER_SCANLINE) return DOTS_PER_SCANLINE - dots; // End of scanline (LCD on or off)
+            break;
+        case static_cast<uint8_t>(PPUMode::xfer):
+            // Once the scanline is drawn (at once, or by the FIFO), only the end of Transfer Mode remains.
+            if ((lineDrawn || pixelFifo.pushedX >= LCD::X_RESOLUTION) && dots < xferEndDot)
+                return xferEndDot - dots;
+            break;
+        default:
+            break;
+    }
+    return 1; // Transfer Mode (or an unexpected state): step dot by dot
+}
+
+/**
+ * Returns the number of dots until the PPU may next request an interrupt. Between interrupts, the PPU can only be
+ * observed through its registers and memory (see PPU::sync), so it doesn't need to be woken up any sooner.
+ *
+ * The VBlank interrupt and the OAM, VBlank and LY=LYC STAT interrupts are all requested at the end of a scanline,
+ * which is known in advance. The HBlank STAT interrupt is requested at the end of Transfer Mode, whose length is
+ * known once Transfer Mode starts (see PPU::xferLength); before that, it can't start any sooner than 80 dots of OAM
+ * scan plus the 160 pixels of the scanline.
+ *
+ * @return The number of dots until the next possible interrupt request (at least 1).
+ */
+uint32_t PPU::dotsUntilNextInterrupt() const {
+    uint32_t untilLineEnd = dots < DOTS_PER_SCANLINE ? DOTS_PER_SCANLINE - dots : 1;
+
+    // No interrupts while the LCD is off, but frames are still paced (see PPU::tickLCDOff).
+    if (!lcdEnabled)
+        return untilLineEnd + (SCANLINES_PER_FRAME - 1 - linesWhileOff) * DOTS_PER_SCANLINE;
+
+    uint8_t mode = getMode();
+    bool scanning = mode == static_cast<uint8_t>(PPUMode::oam) || firstLineAfterOn;
+    bool drawing  = scanning || mode == static_cast<uint8_t>(PPUMode::xfer);
+
+    // Mode 0: HBlank STAT interrupt (lower bound, see above).
+    if (drawing && lcd->interruptEnabled(LCD::LCDStatusInterrupt::hBlank)) {
+        if (scanning)
+            return std::max(80 - dots, 0) + LCD::X_RESOLUTION;
+        return std::max(xferEndDot - dots, 1);
+    }
+
+    // Number of scanlines between the current one and the given one (whose end is when LY becomes line + 1).
+    auto linesUntilEndOf = [this](int line) {
+        return static_cast<uint32_t>((line - lcd->ly + SCANLINES_PER_FRAME) % SCANLINES_PER_FRAME);
+    };
+
+    // Entering VBlank always requests the VBlank interrupt (and the Mode 1 STAT interrupt if enabled).
+    uint32_t lines = linesUntilEndOf(LCD::Y_RESOLUTION - 1);
+
+    // Mode 2: OAM STAT interrupt, and the next scanline's HBlank STAT interrupt (once it's drawing again).
+    if (lcd->interruptEnabled(LCD::LCDStatusInterrupt::oam) || lcd->interruptEnabled(LCD::LCDStatusInterrupt::hBlank))
+        lines = std::min(lines, lcd->ly < LCD::Y_RESOLUTION - 1 ? 0u : linesUntilEndOf(SCANLINES_PER_FRAME - 1));
+
+    // LY=LYC STAT interrupt (LY is compared when incremented, i.e., LYC = 1-154, see LCD::incrementLY).
+    if (lcd->interruptEnabled(LCD::LCDStatusInterrupt::lyc) && lcd->lyCompare >= 1 && lcd->lyCompare <= SCANLINES_PER_FRAME)
+        lines = std::min(lines, linesUntilEndOf(lcd->lyCompare - 1));
+
+    return untilLineEnd + lines * DOTS_PER_SCANLINE;
+}
+
+/**
+ * Registers the PPU's next event with the scheduler, i.e., the next T-cycle at which it may request an interrupt.
+ * Must be called whenever something that affects PPU::dotsUntilNextInterrupt changes (see LCD::write).
+ */
+void PPU::scheduleNextEvent() {
+    scheduler->schedule(Scheduler::Event::ppu, lastTick + dotsUntilNextInterrupt());
+}
+
+/**
+ * Advances the PPU up to (and including) the given T-cycle and registers its next event with the scheduler.
+ * Stretches of dots during which the current mode merely waits (see PPU::dotsUntilNextStep) are skipped by
+ * adding them to the dot counter in one go, while every dot that matters is processed by PPU::tick exactly
+ * as if the PPU had been ticked on every T-cycle.
+ *
+ * @param until The T-cycle to advance to (one dot per T-cycle).
+ */
+void PPU::step(uint64_t until) {
+    while (lastTick < until) {
+        uint64_t next = lastTick + dotsUntilNextStep();
+        if (next > until) { // Nothing happens before 'until'
+            dots += until - lastTick;
+            lastTick = until;
+            break;
+        }
+        dots += next - lastTick - 1; // Skip the idle dots...
+        lastTick = next;
+        tick();                      // ...and process the one that matters
+    }
+    scheduleNextEvent();
+}
+
+/**
+ * Lazily catches the PPU up to the current T-cycle. The PPU is only woken up by the scheduler when it may request
+ * an interrupt, so anything that observes or affects its state in between (LCD registers, VRAM, OAM and OAM DMA)
+ * has to bring it up to date first. This is a no-op if the PPU is already current.
+ */
+void PPU::sync() {
+    if (lastTick < scheduler->now())
+        step(scheduler->now());
+}
+
+/**
+ * Returns the earliest T-cycle at which LY or STAT may change on their own (used for skipping polling loops, see
+ * SM83::skipIdleLoop). LY (and the LY=LYC flag) only changes at the end of a scanline, whereas the mode in STAT also
+ * changes when Transfer Mode starts and ends, the latter being known once it starts (see PPU::xferLength).
+ *
+ * @param addr The address of the register: 0xFF41 (STAT) or 0xFF44 (LY).
+ * @return The T-cycle of the next possible change.
+ */
+uint64_t PPU::nextRegisterChange(uint16_t addr) {
+    sync();
+    if (!lcdEnabled) // LY and STAT are frozen until the LCD is turned back on
+        return Scheduler::NEVER;
+
+    uint32_t untilLineEnd = dots < DOTS_PER_SCANLINE ? DOTS_PER_SCANLINE - dots : 1;
+    if (addr == 0xFF44)
+        return lastTick + untilLineEnd;
+    if (firstLineAfterOn)
+        return lastTick + (dots < 80 ? 80 - dots : 1);
+
+    switch (getMode()) {
+        case static_cast<uint8_t>(PPUMode::oam):  return lastTick + (dots < 80 ? 80 - dots : 1);
+        case static_cast<uint8_t>(PPUMode::xfer): return lastTick + std::max(xferEndDot - dots, 1);
+        default:                                  return lastTick + untilLineEnd;
+    }
+}
+
 /**
  * Advances the PPU state by one tick (one dot on the screen).
  * The Game Boy PPU operates on a cycle that processes scan-lines to render frames.
@@ -133,6 +319,11 @@ uint8_t PPU::getMode() const {
  */
 void PPU::tick() {
     dots++;
+    if (!lcdEnabled) {
+        tickLCDOff();
+        return;
+    }
+
     switch (getMode()) {
         case static_cast<uint8_t>(PPUMode::oam):    handleModeOAM();    break;
         case static_cast<uint8_t>(PPUMode::xfer):   handleModeXfer();   break;
@@ -192,56 +383,71 @@ void PPU::handleModeOAM() {
         scanOAM();
 
     // OAM Mode lasts for 80 dots.
-    if (dots == 80) {
-        // Transition from OAM Mode to Transfer (Xfer) Mode.
-        // In Transfer Mode, the PPU fetches both background and sprite data for rendering the scanline.
-        setMode(PPUMode::xfer);
-
-        // Reset the pixel fetcher state and coordinates for fetching operations in the new scanline.
-        // The pixel fetcher is responsible for retrieving pixel data from VRAM & OAM and feeding it to the Pixel FIFO.
-        pixelFifo.fetcherState = getTileNumber; // Begin fetching tile data for the background/window.
-        pixelFifo.lyX      = 0x00;     // Reset the X-coordinate for the scanline.
-        pixelFifo.fetcherX = 0x00;     // Reset the X-coordinate for fetch operations.
-        pixelFifo.pushedX  = 0x00;     // Reset the X-coordinate for pixels pushed to the FIFO.
-        pixelFifo.fifoX    = 0x00;     // Reset the X-coordinate within the FIFO.
-    }
+    if (dots == 80)
+        enterXfer();
+}
+
+/**
+ * Transitions from OAM Mode to Transfer (Xfer) Mode, on dot 80 of a visible scanline.
+ * In Transfer Mode, the PPU fetches both background and sprite data for rendering the scanline.
+ */
+void PPU::enterXfer() {
+    setMode(PPUMode::xfer);
+
+    resetPixelFIFO();
+
+    // Either draw the whole scanline right away, or push it through the Pixel FIFO dot by dot. Either way, Transfer
+    // Mode lasts the same number of dots, so HBlank, its STAT interrupt, and the mode seen in STAT don't depend on the
+    // renderer. A skipped frame draws nothing at all, the dots just run out to the end of Transfer Mode.
+    lineDrawn = useScanlineRenderer || !drawingFrame;
+    if (lineDrawn && drawingFrame)
+        renderScanline();
+    xferEndDot = 80 + xferLength();
+}
+
+/**
+ * Resets the pixel fetcher state and coordinates for fetching operations in a new scanline.
+ * The pixel fetcher is responsible for retrieving pixel data from VRAM & OAM and feeding it to the Pixel FIFO.
+ */
+void PPU::resetPixelFIFO() {
+    pixelFifo.fetcherState = getTileNumber; // Begin fetching tile data for the background/window.
+    pixelFifo.lyX      = 0x00;     // Reset the X-coordinate for the scanline.
+    pixelFifo.fetcherX = 0x00;     // Reset the X-coordinate for fetch operations.
+    pixelFifo.pushedX  = 0x00;     // Reset the X-coordinate for pixels pushed to the FIFO.
+    pixelFifo.fifoX    = 0x00;     // Reset the X-coordinate within the FIFO.
+    pixelFifo.fifo.clear();
 }
 
 /**
  * Loads sprites that are visible on the current scanline into a buffer for processing.
- * This function examines the sprite attributes in the Object Attribute Memory (OAM)
- * to determine which sprites are visible on the current scanline and should be considered
- * for rendering. It respects the Game Boy hardware limitation of a maximum of 10 sprites
+ * This function looks up which sprites of the Object Attribute Memory (OAM) are visible
+ * on the current scanline in the scanline index (see PPU::updateSpritesOnLine) rather than
+ * examining every OAM entry. It respects the Game Boy hardware limitation of a maximum of 10 sprites
  * per scanline and sorts visible sprites by their X-coordinate.
  */
 void PPU::scanOAM() {
     // Clear the OAM buffer for the current scanline.
     scanlineOAMBuffer.clear();
 
-    // Determine the height of sprite: Either 8 pixels (normal) or 16 pixels (tall sprites).
-    uint8_t spriteHeight = lcd->readLCDC(LCD::objHeight);
-
-    // Scan OAM to find sprites that are visible on the current scanline.
-    for (auto& sprite : oam) {
-        if (sprite.yPos == 0 || sprite.yPos >= LCD::Y_RESOLUTION + 16) // Sprite hidden (real y = yPos - 16)
-            continue;
-
-        if (sprite.yPos <= lcd->ly + 16 && lcd->ly + 16 < sprite.yPos + spriteHeight) { // Visible on current scanline
-            // Sort by X-coordinate to ensure sprites are drawn in the correct order.
-            // If X-coordinates are equal, the sprite located first in OAM has priority.
-            // See https://gbdev.io/pandocs/OAM.html#selection-priority
-            auto it = std::upper_bound(
-                    scanlineOAMBuffer.begin(),
-                    scanlineOAMBuffer.end(),
-                    sprite,
-                    [](const Sprite& a, const Sprite& b) { return a.xPos < b.xPos; }
-            );
-            scanlineOAMBuffer.insert(it, sprite);
-
-            if (scanlineOAMBuffer.size() >= 10) // Max 10 sprites per scanline
-                break;
-
-        }
+    // Look up the sprites overlapping the current scanline for the current sprite height: either 8 pixels (normal)
+    // or 16 pixels (tall sprites). Hidden sprites (Y = 0 or Y >= 160, real y = yPos - 16) never overlap a scanline.
+    uint64_t visible = spritesOnLine[lcd->readLCDC(LCD::objHeight) == 16][lcd->ly];
+
+    // Take them in OAM order, since only the first 10 are selected.
+    while (visible && !scanlineOAMBuffer.full()) { // Max 10 sprites per scanline
+        const Sprite& sprite = oam[lowestSetBit(visible)];
+        visible &= visible - 1;
+
+        // Sort by X-coordinate to ensure sprites are drawn in the correct order.
+        // If X-coordinates are equal, the sprite located first in OAM has priority.
+        // See https://gbdev.io/pandocs/OAM.html#selection-priority
+        auto it = std::upper_bound(
+                scanlineOAMBuffer.begin(),
+                scanlineOAMBuffer.end(),
+                sprite,
+                [](const Sprite& a, const Sprite& b) { return a.xPos < b.xPos; }
+        );
+        scanlineOAMBuffer.insert(it, sprite);
     }
 }
 
@@ -249,9 +455,34 @@ void PPU::scanOAM() {
  * MODE 3: Handles the Transfer (Xfer) Mode of the PPU, during which the PPU is
  * actively drawing the GB screen's contents - background, window, and sprites
  * (sending pixels to the LCD) This mode follows OAM and lasts between 172 and 289 dots.
+ * Its length is computed when it starts (see PPU::xferLength), whichever renderer draws the scanline.
  * See: https://gbdev.io/pandocs/Rendering.html#mode-3-length
  */
 void PPU::handleModeXfer() {
+    // Push the scanline through the Pixel FIFO, unless it has already been drawn in one go (see PPU::renderScanline).
+    if (!lineDrawn && pixelFifo.pushedX < LCD::X_RESOLUTION)
+        runPixelFIFO();
+
+    if (dots < xferEndDot)
+        return;
+
+    // Should the FIFO still have pixels left to draw at the end of Transfer Mode, they are drawn right away.
+    if (!lineDrawn) {
+        uint16_t currentDot = dots;
+        while (pixelFifo.pushedX < LCD::X_RESOLUTION && dots < DOTS_PER_SCANLINE) {
+            dots++;
+            runPixelFIFO();
+        }
+        dots = currentDot;
+    }
+
+    enterHBlank();
+}
+
+/**
+ * Runs the pixel fetcher and pushes a pixel to the video buffer for the current dot of Transfer Mode.
+ */
+void PPU::runPixelFIFO() {
     // Only run Pixel Fetcher every other tick to simulate the PPU's clock cycle behavior.
     // "The Game Boy CPU and PPU run in parallel. The 4.2 MHz master clock is also the dot clock.
     // It's divided by 2 to form the PPU's 2.1 MHz memory access clock, and divided by 4 to form
@@ -262,23 +493,23 @@ void PPU::handleModeXfer() {
 
     // Push pixels to the video buffer for rendering.
     updateVideoBuffer();
+}
 
-    // Check if the X-coordinate of the last pixel pushed to the FIFO has reached the screen's width.
-    // This indicates that the visible portion of the current scanline has been processed.
-    if (pixelFifo.pushedX >= LCD::X_RESOLUTION) {
-        // Clear the FIFO to prepare for processing the next scanline.
-        while (!pixelFifo.fifo.empty())
-            pixelFifo.fifo.pop();
-
-        // Transition to the Horizontal Blank (H-Blank) mode.
-        // This occurs when the PPU has finished drawing a scanline and is "resting" before starting the next one.
-        setMode(PPUMode::hBlank);
-
-        // Check if the H-Blank interrupt is enable in the LCD Status register.
-        // If enabled, triggered the LCD STAT interrupt to inform the CPU that H-Blank has started.
-        if (lcd->interruptEnabled(LCD::LCDStatusInterrupt::hBlank))
-            intHandler->irq(InterruptHandler::InterruptType::lcdStat);
-    }
+/**
+ * Ends Transfer Mode once the visible portion of the current scanline has been processed.
+ */
+void PPU::enterHBlank() {
+    // Clear the FIFO to prepare for processing the next scanline.
+    pixelFifo.fifo.clear();
+
+    // Transition to the Horizontal Blank (H-Blank) mode.
+    // This occurs when the PPU has finished drawing a scanline and is "resting" before starting the next one.
+    setMode(PPUMode::hBlank);
+
+    // Check if the H-Blank interrupt is enable in the LCD Status register.
+    // If enabled, triggered the LCD STAT interrupt to inform the CPU that H-Blank has started.
+    if (lcd->interruptEnabled(LCD::LCDStatusInterrupt::hBlank))
+        intHandler->irq(InterruptHandler::InterruptType::lcdStat);
 }
 
 /**
@@ -287,8 +518,7 @@ void PPU::handleModeXfer() {
  */
 void PPU::updateVideoBuffer() {
     if (pixelFifo.fifo.size() > 8) { // Has enough pixels to render part of the scanline
-        uint32_t pixelData = pixelFifo.fifo.front();
-        pixelFifo.fifo.pop();
+        FIFOPixel pixel = pixelFifo.fifo.pop();
 
         // The scrollX register value affects the starting point of the visible region on the scanline.
         // 'lyX' is used to track the current position on the scanline being processed.
@@ -297,7 +527,7 @@ void PPU::updateVideoBuffer() {
             // Calculate the index in the video buffer where the pixel data should be placed.
             // Note that we are using row-major order to store the pixel data in the video buffer,
             // where the column='pushedX', row='ly', and width='X-RESOLUTION' (https://stackoverflow.com/a/2151141).
-            videoBuffer[pixelFifo.pushedX + (lcd->ly * LCD::X_RESOLUTION)] = pixelData;
+            frameBuffer.back()[pixelFifo.pushedX + (lcd->ly * LCD::X_RESOLUTION)] = toARGB(pixel);
 
             // Increment the pushedX counter, indicating the next position for the subsequent pixel on this scanline.
             pixelFifo.pushedX++;
@@ -314,6 +544,16 @@ void PPU::updateVideoBuffer() {
  * This mode lasts until the remaining time of the 456-tick scanline cycle.
  */
 void PPU::handleModeHBlank() {
+    // The first line after turning the LCD on stays in mode 0 instead of entering OAM Mode (see PPU::setLCDEnabled).
+    if (firstLineAfterOn) {
+        if (dots == 80) {
+            firstLineAfterOn = false;
+            scanOAM();
+            enterXfer();
+        }
+        return;
+    }
+
     if (dots == DOTS_PER_SCANLINE) {
         lcd->incrementLY(); // Increment LY for the next scanline.
 
@@ -326,8 +566,16 @@ void PPU::handleModeHBlank() {
             if (lcd->interruptEnabled(LCD::LCDStatusInterrupt::vBlank))
                 intHandler->irq(InterruptHandler::lcdStat);
 
-            // Calculate and print FPS for monitoring performance.
-            calculateFPS();
+            // Hand the completed frame over to the UI (skipped frames left the back buffer untouched).
+            if (drawingFrame) {
+                frameBuffer.publish();
+                drawnFrames++;
+            } else {
+                skippedFrames++;
+            }
+
+            // Report the frame as complete, the CPU thread paces the emulation from there (see GB::cpuRun).
+            framesRendered++;
         } else {
             // If still within the visible scan-lines, switch back to OAM mode.
             setMode(PPUMode::oam);
@@ -339,44 +587,6 @@ void PPU::handleModeHBlank() {
     }
 }
 
-// Constants for frame timing control.
-constexpr int TARGET_FPS = 60;                               // Target frame rate in frames per second.
-constexpr int TARGET_FRAME_DURATION = 1000 / TARGET_FPS - 1; // Target duration of a single frame.
-
-// Variables for FPS calculation and frame timing.
-static uint64_t currFrameDuration = 0;
-static uint64_t currTimestamp     = 0;
-static uint64_t prevTimestamp     = 0;
-static uint64_t fpsCalcStartTime  = 0;
-static uint64_t framesThisSecond  = 0;
-static uint32_t fps               = 0;
-
-/**
- * Computes and logs the frames per second (FPS) and enforces frame timing to maintain roughly 60 fps.
- */
-void PPU::calculateFPS() {
-    framesRendered++; // Increment total frame count.
-
-    // Calculate time taken for the current frame.
-    currTimestamp = SDL2Timing::getTicks();
-    currFrameDuration = currTimestamp - prevTimestamp;
-
-    if (currFrameDuration < TARGET_FRAME_DURATION)
-        SDL2Timing::delay(std::chrono::milliseconds(TARGET_FRAME_DURATION - currFrameDuration)); // Delay to maintain 60 fps.
-
-    if (currTimestamp - fpsCalcStartTime >= 1000) { // Update FPS every second (1000 ms).
-        fps = framesThisSecond;           // Record FPS for logging.
-        fpsCalcStartTime = currTimestamp; // Reset the stat time for the next second.
-        framesThisSecond = 0;             // Resent the frame count for the next second.
-        printf("FPS: %d\n", fps);         // Log FPS.
-
-        if (cartridge->needsToSave())     // Save the cartridge if it needs to be saved.
-            cartridge->save();
-    }
-    framesThisSecond++;                     // Increment frame count for FPS calculation.
-    prevTimestamp = SDL2Timing::getTicks(); // Update timestamp for the next frame.
-}
-
 /**
  * MODE 1: Handles the Vertical Blank (VBlank) Mode of the PPU (waiting until next frame).
  * VBlank occurs after all visible lines have been drawn and represents a period where
@@ -396,11 +606,69 @@ void PPU::handleModeVBlank() {
 
             lcd->ly = 0;           // Reset scanline counter after a full frame.
             windowLineCounter = 0; // Reset window line counter after a full frame.
+            beginFrame();
         }
         dots = 0; // Reset tick counter for the next scanline.
     }
 }
 
+/**
+ * Decides whether the frame that is about to start is drawn: either it was requested (see PPU::requestFrame), or
+ * frameSkip frames have been skipped since the last drawn one. A skipped frame goes through the same modes, STAT and
+ * LY values as a drawn one, since the length of Transfer Mode is computed rather than taken from the renderer (see
+ * PPU::xferLength), but neither renderer runs: the Pixel FIFO doesn't fetch or mix anything and the video buffer is
+ * left untouched.
+ */
+void PPU::beginFrame() {
+    drawingFrame = frameRequested || (frameSkip != SKIP_UNREQUESTED && framesSinceDrawn >= frameSkip);
+    framesSinceDrawn = drawingFrame ? 0 : framesSinceDrawn + 1;
+    frameRequested = false;
+}
+
+/**
+ * Turns the PPU off or on following a write to LCDC bit 7. Turning it off resets LY to 0 and the mode to 0, after
+ * which no dot does any work until it is turned back on (see PPU::tickLCDOff). Turning it on starts a new frame at
+ * the beginning of line 0. That first line differs from the others in that it stays in mode 0 (without an OAM STAT
+ * interrupt) instead of entering OAM Mode, and Transfer Mode still starts on dot 80.
+ * See: https://gbdev.io/pandocs/LCDC.html#lcdc7--lcd-enable
+ *
+ * @param enable The new value of LCDC bit 7.
+ */
+void PPU::setLCDEnabled(bool enable) {
+    if (enable == lcdEnabled)
+        return;
+
+    lcdEnabled        = enable;
+    firstLineAfterOn  = enable;
+    linesWhileOff     = 0;
+    dots              = 0;
+    lineDrawn         = false;
+    lcd->ly           = 0;
+    windowLineCounter = 0;
+    resetPixelFIFO();
+    setMode(PPUMode::hBlank);
+
+    if (enable)
+        beginFrame();
+    scheduleNextEvent();
+}
+
+/**
+ * Advances the dormant PPU while the LCD is off. PPU::step only stops at the end of each line (see
+ * PPU::dotsUntilNextStep), and every 154 lines a frame is reported as complete as if it had been displayed, so
+ * that the emulation stays paced during loading screens.
+ */
+void PPU::tickLCDOff() {
+    if (dots < DOTS_PER_SCANLINE)
+        return;
+
+    dots = 0;
+    if (++linesWhileOff == SCANLINES_PER_FRAME) {
+        linesWhileOff = 0;
+        framesRendered++;
+    }
+}
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 
@@ -616,6 +884,11 @@ void PPU::fetchSpriteData(uint8_t offset) {
         // Calculate the memory address in VRAM for fetching the sprite data.
         // This includes the base address (0x8000), the tile number, and the tile data offset (0=low or 1=high).
         pixelFifo.oamFetchData[(i * 2) + offset] = readVRAM(0x8000 + (tileNum * 16) + tileY + offset);
+
+        // Once both bytes are in, decode the row so that pushing pixels only has to look up color indices.
+        if (offset == 1)
+            PixelKernels::decodeRow(pixelFifo.oamFetchData[i * 2], pixelFifo.oamFetchData[(i * 2) + 1],
+                                    pixelFifo.spriteRows[i].data(), fetchedSprites.at(i).attributes.xFlip);
     }
 }
 
@@ -657,9 +930,9 @@ void PPU::handleFetcherStatePush() {
  * pixel data until it is ready to be displayed on the screen.
  *
  * The function calculates the x-coordinate adjusted for the current scroll position,
- * ensuring that only visible pixels are added to the FIFO. It processes each bit
- * in the fetched tile data to determine the color of each pixel based on the background
- * palette and adds the corresponding 32-bit color value to the FIFO.
+ * ensuring that only visible pixels are added to the FIFO. It decodes the fetched tile
+ * data into the color index of each pixel (see PixelKernels::decodeRow) and adds it to the
+ * FIFO along with its palette, which is only applied once the pixel leaves the FIFO.
  *
  * @return True if the pixel was successfully pushed to the FIFO, or false if the FIFO is full.
  */
@@ -674,23 +947,24 @@ bool PPU::pushedToFIFO() {
     if (adjustedX < 0)
         return true; // Skip pixels that are off-screen due to horizontal scrolling.
 
-    // Process each bit in the fetched tile data to determine the color index of each pixel.
-    for (int bitPos = 7; bitPos >= 0; bitPos--) {
-        uint8_t colorIdx = (!!(pixelFifo.bgwFetchData[2] & (1 << bitPos)) << 1) | // high bit from high tile data byte
-                           (!!(pixelFifo.bgwFetchData[1] & (1 << bitPos)) << 0);  // low bit from low tile data byte
+    // Decode the fetched tile data into the color index of each pixel.
+    TileCache::Row colorIndices;
+    PixelKernels::decodeRow(pixelFifo.bgwFetchData[1], pixelFifo.bgwFetchData[2], colorIndices.data());
 
-        // Determine the color from the background palette.
-        uint32_t color = lcd->bgPalette[colorIdx];
+    for (uint8_t colorIdx : colorIndices) {
+
+        // The pixel's color is taken from the background palette.
+        FIFOPixel pixel = { colorIdx, 0 };
 
         // If background/window display is disabled, use the default color (white=transparent for BG/W).
         if (!lcd->readLCDC(LCD::bgwEnable))
-            color = lcd->bgPalette[0];
+            pixel.colorIdx = 0;
 
         // If sprite display is enable, fetch sprite pixels and override the background color if necessary.
         if (lcd->readLCDC(LCD::objEnable))
-            color = fetchSpritePixels(bitPos, color, colorIdx);
+            pixel = fetchSpritePixels(pixel, colorIdx);
 
-        pixelFifo.fifo.push(color);
+        pixelFifo.fifo.push(pixel);
         pixelFifo.fifoX++;
     }
 
@@ -703,14 +977,13 @@ bool PPU::pushedToFIFO() {
  * and determines the appropriate sprite pixel color to display, taking into account
  * sprite priority and background color.
  *
- * @param bitPos The position within the 8-pixel span of the sprite data from which to fetch the color.
- * @param color The default color to be used if no sprite pixel overrides it.
+ * @param pixel The background pixel to be used if no sprite pixel overrides it.
  * @param bgColorIdx The color index of the background pixel at the current FIFO position.
  *
- * @return The color value for the current pixel, which might be the unchanged input color,
- *         or a new color based on the sprite's pixel data and attributes.
+ * @return The pixel at the current position, which might be the unchanged background pixel,
+ *         or a sprite pixel based on the sprite's pixel data and attributes.
  */
-uint32_t PPU::fetchSpritePixels(uint8_t bitPos, uint32_t color, uint8_t bgColorIdx) {
+PPU::FIFOPixel PPU::fetchSpritePixels(FIFOPixel pixel, uint8_t bgColorIdx) {
     // Loop over all fetched sprite entries to check for sprite pixel data at the current FIFO x position.
     for (int i = 0; i < fetchedSprites.size(); i++) {
         // Calculate the effective x position of the sprite on the screen, accounting for the scroll position.
@@ -727,14 +1000,9 @@ uint32_t PPU::fetchSpritePixels(uint8_t bitPos, uint32_t color, uint8_t bgColorI
         if (offset < 0 || offset > 7)
             continue;
 
-        // Determine the bit position for fetching color index, potentially flipping it for x-flipped sprites.
-        bitPos = 7 - offset;
-        if (fetchedSprites.at(i).attributes.xFlip)
-            bitPos = offset;
-
-        // Fetch the color index from the sprite's tile data, which is a 2-bit index into the sprite's palette.
-        uint8_t colorIdx = (!!(pixelFifo.oamFetchData.at((i * 2) + 1) & (1 << bitPos)) << 1) | // High bit
-                           (!!(pixelFifo.oamFetchData.at((i * 2) + 0) & (1 << bitPos)) << 0);  // Low bit
+        // Fetch the color index from the sprite's decoded row (already flipped for x-flipped sprites),
+        // which is a 2-bit index into the sprite's palette.
+        uint8_t colorIdx = pixelFifo.spriteRows.at(i)[offset];
 
         // If the color index is 0, this sprite pixel is transparent and should be skipped.
         if (!colorIdx)
@@ -744,18 +1012,186 @@ uint32_t PPU::fetchSpritePixels(uint8_t bitPos, uint32_t color, uint8_t bgColorI
         bool bgp = fetchedSprites.at(i).attributes.bgPriority;
 
         // If the sprite has priority over BG/W or if the BG color is transparent,
-        // the sprite pixel color takes precedence and the loop returns the color.
+        // the sprite pixel takes precedence and the loop returns it.
         if (!bgp || bgColorIdx == 0) {
-            // Select the appropriate color from the sprite's palette based on the dmgPalette attribute.
-            color = fetchedSprites.at(i).attributes.dmgPalette ?
-                    lcd->obj1Palette[colorIdx] :
-                    lcd->obj0Palette[colorIdx];
-
-            return color;
+            // Select the appropriate sprite palette based on the dmgPalette attribute.
+            uint8_t palette = fetchedSprites.at(i).attributes.dmgPalette ? 2 : 1;
+            return { colorIdx, palette };
         }
     }
-    return color; // No sprite pixel overrides the BG color, so return the original BG color
+    return pixel; // No sprite pixel overrides the BG pixel, so return the original BG pixel
+}
+
+/**
+ * Converts a pixel leaving the Pixel FIFO to its ARGB color, using the palette as it is at that point.
+ *
+ * @param pixel The pixel.
+ * @return The 32-bit ARGB color of the pixel.
+ */
+uint32_t PPU::toARGB(FIFOPixel pixel) const {
+    switch (pixel.palette) {
+        case 1:  return lcd->obj0Palette[pixel.colorIdx];
+        case 2:  return lcd->obj1Palette[pixel.colorIdx];
+        default: return lcd->bgPalette[pixel.colorIdx];
+    }
 }
 // =====================================================================================================================
 
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
\ No newline at end of file
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Scanline Renderer ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/**
+ * Draws the current scanline in one go at the start of Transfer Mode. It produces the same pixels as the Pixel
+ * FIFO (which is still used whenever the line is affected by writes while it's being drawn, see PPU::fallBackToFIFO)
+ * by going through the same 8-pixel fetches: every fetch reads a BG or window tile row and up to three of the
+ * sprites overlapping it, and the first scrollX % 8 pixels of the line are discarded. The only difference is that
+ * BG/W pixels count as color 0 for sprite priority while BG/W display is disabled.
+ */
+void PPU::renderScanline() {
+    uint32_t* line = &frameBuffer.back()[lcd->ly * LCD::X_RESOLUTION];
+    bool windowOnLine = lcd->windowIsVisible() && lcd->wy <= lcd->ly && lcd->ly < lcd->wy + LCD::Y_RESOLUTION;
+    uint8_t fineX = lcd->scrollX % 8;
+    uint8_t spriteHeight = lcd->readLCDC(LCD::objHeight);
+
+    // Color indices of the BG/W pixels of every fetch, starting with the discarded ones.
+    std::array<uint8_t, LCD::X_RESOLUTION + 8> bgwLine{};
+    if (lcd->readLCDC(LCD::bgwEnable)) {
+        for (int fetcherX = 0; fetcherX < LCD::X_RESOLUTION + fineX; fetcherX += 8) {
+            // BG/W tile row (see PPU::handleFetcherStateTileNumber and PPU::fetchWindowTile).
+            uint16_t mapAddr = lcd->readLCDC(LCD::bgTileMapArea) +
+                               static_cast<uint8_t>(lcd->ly + lcd->scrollY) / 8 * 32 +
+                               (static_cast<uint8_t>(fetcherX + lcd->scrollX) / 8 & 0x1F);
+            uint8_t tileY = ((lcd->ly + lcd->scrollY) % 8) * 2;
+
+            if (windowOnLine && lcd->wx <= fetcherX + WX_OFFSET && fetcherX + WX_OFFSET < lcd->wx + LCD::X_RESOLUTION) {
+                mapAddr = lcd->readLCDC(LCD::windowTileMapArea) +
+                          windowLineCounter / 8 * 32 +
+                          (static_cast<uint8_t>(fetcherX + WX_OFFSET - lcd->wx) / 8 & 0x1F);
+                tileY = (windowLineCounter % 8) * 2;
+            }
+
+            uint8_t tileNum = readVRAM(mapAddr);
+            if (lcd->readLCDC(LCD::bgwTileDataArea) == 0x8800)
+                tileNum = static_cast<int8_t>(tileNum) + 128;
+
+            const TileCache::Row& row = tileCache.rowAt(lcd->readLCDC(LCD::bgwTileDataArea) + tileNum * 16 + tileY);
+            std::copy(row.begin(), row.end(), bgwLine.begin() + fetcherX);
+        }
+    }
+
+    // The BG/W pixels are converted to colors all at once, then the sprites are drawn over them.
+    PixelKernels::applyPalette(&bgwLine[fineX], LCD::X_RESOLUTION, lcd->bgPalette, line);
+
+    if (!lcd->readLCDC(LCD::objEnable) || scanlineOAMBuffer.empty())
+        return;
+
+    for (int fetcherX = 0; fetcherX < LCD::X_RESOLUTION + fineX; fetcherX += 8) {
+        // Sprites overlapping the fetch, at most three (see PPU::fetchSpriteTiles and PPU::fetchSpriteData).
+        std::array<const Sprite*, 3> sprites{};
+        std::array<const TileCache::Row*, 3> spriteRows{};
+        size_t spriteCount = 0;
+        for (const Sprite& sprite : scanlineOAMBuffer) {
+            if (spriteCount >= sprites.size())
+                break;
+
+            int spriteX = (sprite.xPos - 8) + fineX;
+            if (spriteX < fetcherX - 8 || spriteX >= fetcherX + 8)
+                continue;
+
+            uint8_t tileY = (lcd->ly - (sprite.yPos - 16)) * 2;
+            if (sprite.attributes.yFlip)
+                tileY = ((spriteHeight * 2) - 2) - tileY;
+            uint8_t tileNum = spriteHeight == 16 ? sprite.tileNum & ~1 : sprite.tileNum;
+
+            spriteRows[spriteCount] = &tileCache.rowAt(0x8000 + tileNum * 16 + tileY, sprite.attributes.xFlip);
+            sprites[spriteCount++]  = &sprite;
+        }
+
+        for (int i = 0; i < 8 && spriteCount; i++) {
+            int x = fetcherX + i - fineX; // Screen X-coordinate of the pixel
+            if (x < 0 || x >= LCD::X_RESOLUTION)
+                continue;
+
+            // Same priority rules as PPU::fetchSpritePixels: the first opaque sprite pixel that isn't hidden
+            // behind a non-zero BG/W color wins.
+            for (size_t s = 0; s < spriteCount; s++) {
+                int offset = fetcherX + i - ((sprites[s]->xPos - 8) + fineX);
+                if (offset < 0 || offset > 7)
+                    continue;
+
+                uint8_t spriteIdx = (*spriteRows[s])[offset];
+                if (!spriteIdx)
+                    continue;
+
+                if (!sprites[s]->attributes.bgPriority || bgwLine[fetcherX + i] == 0) {
+                    line[x] = sprites[s]->attributes.dmgPalette ? lcd->obj1Palette[spriteIdx]
+                                                                : lcd->obj0Palette[spriteIdx];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Computes the length of Transfer Mode for the current scanline: 172 dots, plus the dots spent discarding the
+ * first scrollX % 8 pixels, plus 6 dots if the window starts on the line, plus the penalty of each sprite.
+ * Both renderers use this length (see PPU::enterXfer), so STAT timing is identical with or without --scanline;
+ * the Pixel FIFO only decides when each pixel is drawn.
+ * See: https://gbdev.io/pandocs/Rendering.html#mode-3-length
+ *
+ * @return The number of dots (172-289).
+ */
+uint16_t PPU::xferLength() const {
+    uint16_t length = 172 + lcd->scrollX % 8;
+
+    if (lcd->windowIsVisible() && lcd->wy <= lcd->ly)
+        length += 6;
+
+    if (lcd->readLCDC(LCD::objEnable)) {
+        // A sprite costs 6 dots, plus up to 5 more if it's the first one on a BG tile, depending on how many of
+        // the tile's pixels lie right of the sprite's leftmost pixel. Sprites at X = 0 always cost 11 dots.
+        int lastTile = std::numeric_limits<int>::min(); // No tile yet (-1 is the tile left of the screen's first one)
+        for (const Sprite& sprite : scanlineOAMBuffer) {
+            if (sprite.xPos >= LCD::X_RESOLUTION + 8)
+                continue;
+
+            if (sprite.xPos == 0) {
+                length += 11;
+                continue;
+            }
+
+            // Sprites partly off the left edge can start left of the first BG tile (bgX < 0): shifting and masking
+            // (unlike / and %, which truncate toward zero) still give the right tile and a pixel offset of 0-7.
+            int bgX = sprite.xPos - 8 + lcd->scrollX;
+            if (bgX >> 3 != lastTile) {
+                lastTile = bgX >> 3;
+                length += std::max(5 - (bgX & 7), 0);
+            }
+            length += 6;
+        }
+    }
+
+    return std::min<uint16_t>(length, 289);
+}
+
+/**
+ * Hands the rest of the current scanline over to the Pixel FIFO if the scanline renderer has already drawn it,
+ * before something that affects its pixels (an LCD register or VRAM) is written to. The FIFO is replayed from the
+ * start of Transfer Mode up to the current dot with the values the line was drawn with, which redraws the same
+ * pixels and leaves the FIFO exactly where it would be had it drawn the line from the start. Transfer Mode still
+ * ends on the dot computed when it started, so the fallback doesn't change the timing of HBlank.
+ */
+void PPU::fallBackToFIFO() {
+    if (!lineDrawn || !drawingFrame || getMode() != static_cast<uint8_t>(PPUMode::xfer))
+        return;
+
+    uint16_t currentDot = dots;
+    lineDrawn = false;
+
+    resetPixelFIFO();
+    for (dots = 81; dots <= currentDot && pixelFifo.pushedX < LCD::X_RESOLUTION; dots++)
+        runPixelFIFO();
+    dots = currentDot;
+}
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -4,9 +4,13 @@
 #include "Cartridge.hpp"
 #include "LCD.hpp"
 #include "InterruptHandler.hpp"
+#include "Scheduler.hpp"
+#include "TileCache.hpp"
+#include "PixelKernels.hpp"
+#include "FrameBuffer.hpp"
+#include "DirtyBits.hpp"
 
 #include <stdexcept>
-#include <queue>
 
 class PPU {
     friend class LCD;
@@ -15,18 +19,33 @@ class PPU {
     friend class GB;
 
 public:
-    PPU(Cartridge* c, LCD* l, InterruptHandler* ih);
+    PPU(Cartridge* c, LCD* l, InterruptHandler* ih, Scheduler* s);
     ~PPU();
 
 public:
-    void    tick(); // Updates the PPU state and handles the current PPU mode.
-    uint8_t read(uint16_t addr);
-    void    write(uint16_t addr, uint8_t data);
+    void     tick();                            // Updates the PPU state and handles the current PPU mode.
+    void     step(uint64_t until);              // Advances the PPU up to the given T-cycle and schedules its next event.
+    void     sync();                            // Catches the PPU up to the current T-cycle before it is accessed.
+    uint64_t nextRegisterChange(uint16_t addr); // Earliest T-cycle at which LY or STAT may change.
+    uint8_t  read(uint16_t addr);
+    void     write(uint16_t addr, uint8_t data);
+    uint8_t* vramData() { return vram.data(); } // For reading VRAM directly (the PPU never writes it, see Bus::Bus)
+
+    void enableScanlineRenderer(bool enable) { useScanlineRenderer = enable; } // See PPU::renderScanline
+    bool isScanlineRendererEnabled() const { return useScanlineRenderer; }
+
+    static constexpr uint32_t SKIP_UNREQUESTED = UINT32_MAX; // Frame skip: only draw frames asked for with requestFrame
+    void     setFrameSkip(uint32_t frames) { frameSkip = frames; } // Frames skipped after each drawn one (0 = none)
+    uint32_t getFrameSkip() const          { return frameSkip; }
+    void     requestFrame()                { frameRequested = true; } // Draws the next frame even if it'd be skipped
+    uint32_t framesDrawn() const           { return drawnFrames; }
+    uint32_t framesSkipped() const         { return skippedFrames; }
 
 private:
     uint16_t dots           = 0x0000;     // Counts the amount of time passed (a dot/tick is a PPU time unit)
-    uint32_t framesRendered = 0x00000000; // Number of frames processed, used for synchronization and timing
-    std::array<uint32_t, 160 * 144> videoBuffer; // Holds pixel data for the current frame, used for rendering.
+    uint64_t lastTick       = 0;          // The T-cycle up to which the PPU has been advanced (see PPU::step)
+    uint32_t framesRendered = 0x00000000; // Number of frames completed, paced by the CPU thread (see GB::cpuRun)
+    FrameBuffer frameBuffer; // Completed frames for the UI, the current one being drawn into frameBuffer.back()
 
 private:
     // This struct represents a sprite's (OAM entry) data as stored in the Game Boy's Object Attribute Memory (OAM).
@@ -45,6 +64,28 @@ private:
         } __attribute__((packed)) attributes;
     } __attribute__((packed));
 
+    // Fixed-capacity list of sprites stored inline, so that the per-scanline sprite lists never allocate.
+    template <uint8_t N>
+    struct SpriteList {
+        std::array<Sprite, N> sprites{};
+        uint8_t count = 0;
+
+        const Sprite* begin() const          { return sprites.data(); }
+        const Sprite* end() const            { return sprites.data() + count; }
+        uint8_t       size() const           { return count; }
+        bool          empty() const          { return count == 0; }
+        bool          full() const           { return count == N; }
+        const Sprite& at(size_t i) const     { return sprites.at(i); }
+        void          clear()                { count = 0; }
+        void          push_back(Sprite s)    { sprites[count++] = s; }
+        void          insert(const Sprite* pos, Sprite s) { // Inserts before pos (the list must not be full)
+            Sprite* p = sprites.data() + (pos - sprites.data());
+            std::copy_backward(p, sprites.data() + count, sprites.data() + count + 1);
+            *p = s;
+            count++;
+        }
+    };
+
 private:
     // PPU Modes =======================================================================================================
 
@@ -57,24 +98,34 @@ private:
         xfer,   // Mode 3 (Transfer/Drawing pixels): Sending pixels to the LCD controller.
     };
 
-    void    setMode(PPUMode mode);  // Writes to lower two bits of the LCD Status Register
-    uint8_t getMode() const;        // Reads from lower two bits of the LCD Status Register
+    void     setMode(PPUMode mode);            // Writes to lower two bits of the LCD Status Register
+    uint8_t  getMode() const;                  // Reads from lower two bits of the LCD Status Register
+    uint16_t dotsUntilNextStep() const;        // Dots until the current mode has something to do (see PPU::step)
+    uint32_t dotsUntilNextInterrupt() const;   // Dots until the PPU may request an interrupt (see PPU::sync)
+    void     scheduleNextEvent();              // Registers the next possible interrupt with the scheduler
 
     // PPU Mode Handlers ===============================================================================================
 
     // Mode 2: OAM Scan
     void handleModeOAM();                  // Mode 2: Scanline is being processed, OAM is locked.
     void scanOAM();                        // Searches OAM for sprites which overlap the current scanline.
-    std::vector<Sprite> scanlineOAMBuffer; // Sprites on the current scanline (max 10).
+    SpriteList<10> scanlineOAMBuffer;      // Sprites on the current scanline (max 10).
+    // For each visible scanline, a bitmask of the OAM entries overlapping it (bit n = sprite n), one table for each
+    // sprite height (0 = 8x8, 1 = 8x16). Kept up to date by PPU::writeOAM, so that scanOAM doesn't walk all of OAM.
+    std::array<std::array<uint64_t, LCD::Y_RESOLUTION>, 2> spritesOnLine{};
+    void updateSpritesOnLine(uint8_t sprite, uint8_t oldY, uint8_t newY); // Moves a sprite between scanlines
     // Mode 3: Transfer
     void handleModeXfer();       // Mode 3: Scanline is being processed, both OAM and VRAM are locked.
+    void enterXfer();            // Starts Transfer Mode once OAM has been scanned.
+    void resetPixelFIFO();       // Prepares the Pixel FIFO for drawing a new scanline.
+    void runPixelFIFO();         // Runs the Pixel FIFO for the current dot.
     void runPixelFetcher();      // Fetches tile data and pushes it to the Pixel FIFO.
     void updateVideoBuffer();    // Pushes a pixel to the Pixel FIFO.
+    void enterHBlank();          // Ends Transfer Mode once the scanline has been drawn.
     // Mode 1: VBlank
     void handleModeVBlank(); // Mode 1: VBlank period, scanline 144-153, both OAM and VRAM are locked.
     // Mode 0: HBlank
     void handleModeHBlank(); // Mode 0: HBlank period, scanline 0-143, both OAM and VRAM are accessible.
-    void calculateFPS();     // Calculates the FPS of the emulator and enforces frame timing.
 
 private:
     // The FetcherState enum represents the different states of the Pixel Fetcher in the PPU,
@@ -92,7 +143,7 @@ private:
     // Tile Number
     void handleFetcherStateTileNumber(); // Fetcher state for fetching tile number from tile map.
     void fetchSpriteTiles();             // Fetches sprite tiles from scanlineOAMBuffer.
-    std::vector<Sprite> fetchedSprites;  // OAM entries fetched for the current scanline during pipeline (max 3).
+    SpriteList<3> fetchedSprites;        // OAM entries fetched for the current scanline during pipeline (max 3).
     void fetchWindowTile();              // Fetches the window tile for the current scanline.
     // Tile Data
     void handleFetcherStateTileDataLow();  // Fetcher state for fetching low byte of tile data.
@@ -103,7 +154,35 @@ private:
     // Push Pixel
     void handleFetcherStatePush();                                                  // Fetcher state for pushing pixels to FIFO.
     bool pushedToFIFO();                                                            // Pushes a pixel to the Pixel FIFO.
-    uint32_t fetchSpritePixels(uint8_t bitPos, uint32_t color, uint8_t bgColorIdx); // Fetches sprite pixels for the FIFO
+
+public:
+    // A pixel waiting in the Pixel FIFO: a color index into one of the palettes, only converted to ARGB once it's
+    // pushed to the video buffer (see PPU::toARGB).
+    struct FIFOPixel {
+        uint8_t colorIdx : 2; // Color index (0-3)
+        uint8_t palette  : 2; // Palette: 0 = BGP, 1 = OBP0, 2 = OBP1 (see LCD::updatePalette)
+    };
+
+    // Fixed-capacity ring buffer of pixels. The FIFO is refilled with 8 pixels once it holds 8 or fewer, so it never
+    // holds more than 16. The read and write counters wrap around on their own and are masked when indexing.
+    // Public, like FIFOPixel, for the benchmark in bench/.
+    struct PixelRing {
+        static constexpr uint8_t CAPACITY = 16; // Must be a power of two
+
+        std::array<FIFOPixel, CAPACITY> pixels{};
+        uint8_t head = 0; // Counts the pixels popped
+        uint8_t tail = 0; // Counts the pixels pushed
+
+        uint8_t   size() const            { return tail - head; }
+        bool      empty() const           { return head == tail; }
+        void      push(FIFOPixel pixel)   { pixels[tail++ & (CAPACITY - 1)] = pixel; }
+        FIFOPixel pop()                   { return pixels[head++ & (CAPACITY - 1)]; }
+        void      clear()                 { head = tail = 0; }
+    };
+
+private:
+    FIFOPixel fetchSpritePixels(FIFOPixel pixel, uint8_t bgColorIdx); // Fetches sprite pixels for the FIFO
+    uint32_t  toARGB(FIFOPixel pixel) const;                           // Applies the pixel's palette
 
     // This struct encapsulates various state information and data storage for managing the flow of pixel data in
     // the PPU's pixel fetching process. Although it doesn't totally emulate the real hardware, whose documentation
@@ -122,11 +201,54 @@ private:
         uint8_t fifoX        = 0x00;               // X-coordinate of the current pixel in the FIFO
         std::array<uint8_t, 3> bgwFetchData;       // Tile data fetched for BG/W (number, data low, data high)
         std::array<uint8_t, 6> oamFetchData;       // Tile data fetched for sprites: 3 sprites * 2 (data low & high)
-        std::queue<uint32_t> fifo;                 // FIFO queue (a buffer holding pixel data for rendering)
+        std::array<TileCache::Row, 3> spriteRows;  // Color indices of the fetched sprite rows, already X-flipped
+        PixelRing fifo;                            // FIFO queue (a buffer holding pixel data for rendering)
     } pixelFifo;
 
     uint8_t windowLineCounter = 0x00; // Similar to LY, counts when the window is visible on the current scanline
 
+private:
+    // Scanline renderer ===============================================================================================
+    // Draws a whole scanline at the start of Transfer Mode instead of pushing pixels through the FIFO dot by dot.
+    // With either renderer, Transfer Mode ends after a length computed from the scroll, window and sprites when it
+    // starts, so STAT timing doesn't depend on the renderer. Should anything that affects the pixels be written while
+    // the line is being drawn, the FIFO takes over for the rest of the line.
+
+    bool     useScanlineRenderer = false; // Draw whole scanlines (selected at runtime, see PPU::enableScanlineRenderer)
+    bool     lineDrawn           = false; // Whether the current line was drawn at once or is skipped (no FIFO)
+    uint16_t xferEndDot          = 0;     // Dot at which the current (or last) Transfer Mode ends (see PPU::xferLength)
+
+    void     renderScanline();     // Draws the current scanline in one go
+    uint16_t xferLength() const;   // Length of Transfer Mode in dots for the current scanline
+    void     fallBackToFIFO();     // Hands the rest of the current scanline over to the Pixel FIFO
+
+private:
+    // Frame skipping ==================================================================================================
+    // Frames that won't be displayed go through the exact same modes, interrupts and LY values, but without running
+    // either renderer: no fetching, decoding or mixing of pixels and no writes to the video buffer
+    // (see PPU::beginFrame).
+
+    uint32_t frameSkip        = 0;     // Frames skipped after each drawn frame (see PPU::setFrameSkip)
+    bool     frameRequested   = false; // Draw the next frame regardless of frameSkip (see PPU::requestFrame)
+    bool     drawingFrame     = true;  // Whether the current frame is drawn
+    uint32_t framesSinceDrawn = 0;     // Frames skipped since the last drawn frame
+    uint32_t drawnFrames      = 0;     // Frames drawn into the video buffer
+    uint32_t skippedFrames    = 0;     // Frames emulated without being drawn
+
+    void beginFrame(); // Decides whether the frame that is about to start is drawn
+
+private:
+    // LCD off =========================================================================================================
+    // While LCDC bit 7 is clear the PPU is dormant: LY stays 0, STAT reports mode 0 and no dot is processed, except
+    // that the end of every 154 lines still paces the emulation like a frame would (see PPU::tickLCDOff).
+
+    bool    lcdEnabled       = true;  // LCDC bit 7 as last seen by PPU::setLCDEnabled
+    bool    firstLineAfterOn = false; // Line 0 after turning the LCD on, which has no OAM Mode (see PPU::setLCDEnabled)
+    uint8_t linesWhileOff    = 0;     // Lines elapsed in the current 154-line period while the LCD is off
+
+    void setLCDEnabled(bool enable); // Puts the PPU to sleep or restarts it at the start of line 0
+    void tickLCDOff();               // Counts dots and paces frames while the LCD is off
+
 private:
     // Useful constants.
     static constexpr uint16_t SCANLINES_PER_FRAME = 154;    // Scanlines in a single frame (i.e., LY = 0-153)
@@ -136,6 +258,12 @@ private:
     // Memory areas
     std::array<uint8_t, 0x2000> vram; // Video RAM (tile data storage from $8000-97FF)
     std::array<Sprite , 0x0028> oam;  // Object Attribute Memory stores sprite data (0x28=40 sprites, 4 bytes each)
+    TileCache tileCache;              // Tile data in VRAM decoded into color indices (kept up to date by writeVRAM)
+
+    // Parts of VRAM and OAM written since the debug window last took them (see UI::updateDebugWindow)
+    DirtyBits<TileCache::TILE_COUNT> dirtyTiles;   // Tiles in 0x8000-0x97FF
+    DirtyBits<0x0800>                dirtyMap;     // Entries of both tile maps (0x9800-0x9FFF)
+    DirtyBits<0x0028>                dirtySprites; // OAM entries
 
 private:
     uint8_t readVRAM(uint16_t addr);
@@ -148,4 +276,5 @@ private:
     Cartridge* cartridge;         // Pointer to the cartridge.
     LCD* lcd;                     // Pointer to the LCD controller.
     InterruptHandler* intHandler; // Interrupt handler for triggering STAT interrupts.
+    Scheduler* scheduler;         // For registering the next possible interrupt request.
 };
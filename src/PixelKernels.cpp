@@ -0,0 +1,176 @@
+#include "PixelKernels.hpp"
+
+#include <cstring>
+
+#if PIXEL_KERNELS_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    using DecodeRowFn    = void (*)(uint8_t low, uint8_t high, uint8_t* indices, bool xFlip);
+    using ApplyPaletteFn = void (*)(const uint8_t* indices, size_t count, const PixelKernels::Palette& palette,
+                                    uint32_t* colors);
+
+    struct Kernels {
+        DecodeRowFn    decodeRow;
+        ApplyPaletteFn applyPalette;
+    };
+
+    void decodeRowScalar(uint8_t low, uint8_t high, uint8_t* indices, bool xFlip) {
+        for (int x = 0; x < 8; x++) {
+            uint8_t bit = xFlip ? x : 7 - x;
+            indices[x] = (((high >> bit) & 1) << 1) | ((low >> bit) & 1);
+        }
+    }
+
+    void applyPaletteScalar(const uint8_t* indices, size_t count, const PixelKernels::Palette& palette,
+                            uint32_t* colors) {
+        for (size_t i = 0; i < count; i++)
+            colors[i] = palette[indices[i]];
+    }
+
+#if PIXEL_KERNELS_SIMD
+    // Both bitplanes are broadcast into one register (low plane in bytes 0-7, high plane in bytes 8-15), each byte
+    // is tested against the bit of its pixel, and the resulting masks are turned into 1 (low) and 2 (high) and
+    // merged.
+    void decodeRowSSE2(uint8_t low, uint8_t high, uint8_t* indices, bool xFlip) {
+        const __m128i bits = xFlip ? _mm_set1_epi64x(static_cast<int64_t>(0x8040201008040201))
+                                   : _mm_set1_epi64x(static_cast<int64_t>(0x0102040810204080));
+        const __m128i weights = _mm_set_epi64x(0x0202020202020202, 0x0101010101010101);
+
+        __m128i planes = _mm_unpacklo_epi64(_mm_set1_epi8(static_cast<char>(low)),
+                                            _mm_set1_epi8(static_cast<char>(high)));
+        __m128i set    = _mm_cmpeq_epi8(_mm_and_si128(planes, bits), bits);
+        __m128i values = _mm_and_si128(set, weights);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(indices), _mm_or_si128(values, _mm_srli_si128(values, 8)));
+    }
+
+    // SSE2 has no variable shuffle, so each color is selected with a compare mask, 4 pixels at a time.
+    void applyPaletteSSE2(const uint8_t* indices, size_t count, const PixelKernels::Palette& palette,
+                          uint32_t* colors) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i entries[4];
+        for (int c = 0; c < 4; c++)
+            entries[c] = _mm_set1_epi32(static_cast<int>(palette[c]));
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            int32_t packed;
+            std::memcpy(&packed, indices + i, sizeof(packed));
+            __m128i idx = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+
+            __m128i color = _mm_and_si128(_mm_cmpeq_epi32(idx, zero), entries[0]);
+            for (int c = 1; c < 4; c++)
+                color = _mm_or_si128(color, _mm_and_si128(_mm_cmpeq_epi32(idx, _mm_set1_epi32(c)), entries[c]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(colors + i), color);
+        }
+        applyPaletteScalar(indices + i, count - i, palette, colors + i);
+    }
+
+    // The palette is loaded into both 128-bit lanes, so a single cross-lane permute looks up 8 pixels at a time.
+    __attribute__((target("avx2")))
+    void applyPaletteAVX2(const uint8_t* indices, size_t count, const PixelKernels::Palette& palette,
+                          uint32_t* colors) {
+        const __m128i loaded  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette.data()));
+        const __m256i entries = _mm256_broadcastsi128_si256(loaded);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(colors + i), _mm256_permutevar8x32_epi32(entries, idx));
+        }
+        applyPaletteScalar(indices + i, count - i, palette, colors + i);
+    }
+#endif
+
+    Kernels kernelsOf(PixelKernels::Implementation impl) {
+        switch (impl) {
+#if PIXEL_KERNELS_SIMD
+            case PixelKernels::Implementation::sse2: return { decodeRowSSE2, applyPaletteSSE2 };
+            case PixelKernels::Implementation::avx2: return { decodeRowSSE2, applyPaletteAVX2 };
+#endif
+            default:                                 return { decodeRowScalar, applyPaletteScalar };
+        }
+    }
+
+    Kernels selectKernels() {
+        for (auto impl : { PixelKernels::Implementation::avx2, PixelKernels::Implementation::sse2 }) {
+            if (PixelKernels::isSupported(impl))
+                return kernelsOf(impl);
+        }
+        return kernelsOf(PixelKernels::Implementation::scalar);
+    }
+
+    Kernels& kernels() {
+        static Kernels selected = selectKernels();
+        return selected;
+    }
+}
+
+/**
+ * Decodes a tile row into 8 color indices.
+ *
+ * @param low The row's first byte (low bits of the color indices).
+ * @param high The row's second byte (high bits of the color indices).
+ * @param indices Destination of the 8 color indices.
+ * @param xFlip Whether to store the pixels right to left, as for horizontally flipped sprites.
+ */
+void PixelKernels::decodeRow(uint8_t low, uint8_t high, uint8_t* indices, bool xFlip) {
+    kernels().decodeRow(low, high, indices, xFlip);
+}
+
+/**
+ * Converts color indices into ARGB colors, e.g. a whole scanline at once.
+ *
+ * @param indices The color indices (0-3).
+ * @param count The number of color indices.
+ * @param palette The colors of the 4 color indices.
+ * @param colors Destination of the count ARGB colors.
+ */
+void PixelKernels::applyPalette(const uint8_t* indices, size_t count, const Palette& palette, uint32_t* colors) {
+    kernels().applyPalette(indices, count, palette, colors);
+}
+
+/**
+ * @param impl An implementation of the kernels.
+ * @return Whether it was compiled in and the CPU supports its instructions.
+ */
+bool PixelKernels::isSupported(Implementation impl) {
+    switch (impl) {
+        case Implementation::scalar: return true;
+#if PIXEL_KERNELS_SIMD
+        case Implementation::sse2:   return true; // Part of x86-64
+        case Implementation::avx2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:                     return false;
+    }
+}
+
+/**
+ * Replaces the implementation picked on first use, to compare the implementations. Must be called before any other
+ * thread uses the kernels.
+ *
+ * @param impl The implementation to use from now on.
+ * @return False (and the implementation is left unchanged) if it isn't supported.
+ */
+bool PixelKernels::use(Implementation impl) {
+    if (!isSupported(impl))
+        return false;
+    kernels() = kernelsOf(impl);
+    return true;
+}
+
+/**
+ * @param impl An implementation of the kernels.
+ * @return Its name, for logs.
+ */
+const char* PixelKernels::name(Implementation impl) {
+    switch (impl) {
+        case Implementation::scalar: return "scalar";
+        case Implementation::sse2:   return "SSE2";
+        case Implementation::avx2:   return "AVX2";
+    }
+    return "";
+}
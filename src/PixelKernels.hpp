@@ -0,0 +1,38 @@
+#pragma once
+
+#include "common.hpp"
+
+// The vectorized kernels use SSE2 (always present on x86-64) and AVX2, selected at runtime with the GCC/Clang
+// builtins. On any other target, or with another compiler, only the scalar kernels are compiled.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PIXEL_KERNELS_SIMD true
+#else
+#define PIXEL_KERNELS_SIMD false
+#endif
+
+/**
+ * Kernels turning 2bpp tile data into ARGB colors, shared by every renderer (the pixel FIFO, the scanline renderer,
+ * the tile cache and the tile viewer).
+ *
+ * A tile row is stored as two bitplanes: the first byte holds the low bit of each pixel's color index, the second
+ * one the high bit, bit 7 being the leftmost pixel (see: https://gbdev.io/pandocs/Tile_Data.html#data-format).
+ * decodeRow interleaves both planes into 8 color indices at once, and applyPalette looks up any number of color
+ * indices in a 4-entry palette. The fastest implementation the CPU supports is picked the first time a kernel is
+ * called, unless one was selected with PixelKernels::use (e.g. by the benchmarks in bench/).
+ */
+namespace PixelKernels {
+    using Palette = std::array<uint32_t, 4>;
+
+    // Decodes a tile row into 8 color indices (0-3), leftmost pixel first, or rightmost first if xFlip is set.
+    void decodeRow(uint8_t low, uint8_t high, uint8_t* indices, bool xFlip = false);
+
+    // Converts count color indices (0-3) into ARGB colors.
+    void applyPalette(const uint8_t* indices, size_t count, const Palette& palette, uint32_t* colors);
+
+    // The implementations of the kernels: SSE2 decodes rows for both sse2 and avx2, which only differ by applyPalette.
+    enum class Implementation { scalar, sse2, avx2 };
+
+    bool        isSupported(Implementation impl); // Whether it was compiled in and the CPU can run it
+    bool        use(Implementation impl);         // Selects it if it's supported (not thread-safe, call it first)
+    const char* name(Implementation impl);
+}
@@ -14,6 +14,8 @@ public:
     uint8_t readHRAM(uint16_t addr);
     void    writeHRAM(uint16_t addr, uint8_t data);
 
+    uint8_t* wramData() { return wram.data(); } // For mapping WRAM pages directly (see Bus::mapWRAM)
+
 private:
     static constexpr uint16_t WRAM_SIZE = 0x2000, WRAM_MEMORY_OFFSET = 0xC000;
     static constexpr uint16_t HRAM_SIZE = 0x0080, HRAM_MEMORY_OFFSET = 0xFF80;
@@ -1,50 +1,46 @@
 #include "SM83.hpp"
 #include "Bus.hpp"
 #include "GB.hpp"
+#include <algorithm>
 
 
-SM83::SM83(Bus* b, InterruptHandler* ih, Timer* t, GB* gb)
+/**
+ * Builds the instruction lookup table, indexed by opcode.
+ */
+constexpr std::array<SM83::Instruction, 256> SM83::makeLookup() {
+    using o = Operation;
+    using m = AddrMode;
+    using r = Register;
+    using c = Condition;
+    return {{                        /* x0 */                                        /* x1 */                                  /* x2 */                                          /* x3 */                                     /* x4 */                                           /* x5 */                                  /* x6 */                                          /* x7 */                                             /* x8 */                                        /* x9 */                                   /* xA */                                      /* xB */                                    /* xC */                                       /* xD */                                /* xE */                                        /* xF */
+    /* 0x */    { "NOP" , o::NOP                                },{ "LD" , o::LD  , m::R_D16 , r::BC       },{ "LD" , o::LD  , m::MR_R  , r::BC, r::A        },{ "INC", o::INC , m::R    , r::BC       },{ "INC" , o::INC  , m::R    , r::B               },{ "DEC" , o::DEC  , m::R    , r::B         },{ "LD"  , o::LD  , m::R_D8  , r::B        },{ "RLCA", o::RLCA                                    },{ "LD" , o::LD ,  m::A16_R  , r::X , r::SP       },{ "ADD" , o::ADD , m::R_R , r::HL, r::BC },{ "LD" , o::LD  , m::R_MR  , r::A, r::BC      },{ "DEC", o::DEC , m::R   , r::BC       },{ "INC" , o::INC  , m::R   , r::C             },{ "DEC" , o::DEC  , m::R   , r::C       },{ "LD" , o::LD  , m::R_D8 , r::C        },{ "RRCA", o::RRCA                                   }, // 0x
+    /* 1x */    { "STOP", o::STOP                               },{ "LD" , o::LD  , m::R_D16 , r::DE       },{ "LD" , o::LD  , m::MR_R  , r::DE, r::A        },{ "INC", o::INC , m::R    , r::DE       },{ "INC" , o::INC  , m::R    , r::D               },{ "DEC" , o::DEC  , m::R    , r::D         },{ "LD"  , o::LD  , m::R_D8  , r::D        },{ "RLA" , o::RLA                                     },{ "JR" , o::JR ,  m::D8                          },{ "ADD" , o::ADD , m::R_R , r::HL, r::DE },{ "LD" , o::LD  , m::R_MR  , r::A, r::DE      },{ "DEC", o::DEC , m::R   , r::DE       },{ "INC" , o::INC  , m::R   , r::E             },{ "DEC" , o::DEC  , m::R   , r::E       },{ "LD" , o::LD  , m::R_D8 , r::E        },{ "RRA" , o::RRA                                    }, // 1x
+    /* 2x */    { "JR"  , o::JR  , m::D8   , r::X , r::X, c::NZ },{ "LD" , o::LD  , m::R_D16 , r::HL       },{ "LD" , o::LD  , m::HLI_R , r::HL, r::A        },{ "INC", o::INC , m::R    , r::HL       },{ "INC" , o::INC  , m::R    , r::H               },{ "DEC" , o::DEC  , m::R    , r::H         },{ "LD"  , o::LD  , m::R_D8  , r::H        },{ "DAA" , o::DAA                                     },{ "JR" , o::JR ,  m::D8     , r::X , r::X , c::Z },{ "ADD" , o::ADD , m::R_R , r::HL, r::HL },{ "LD" , o::LD  , m::R_HLI , r::A, r::HL      },{ "DEC", o::DEC , m::R   , r::HL       },{ "INC" , o::INC  , m::R   , r::L             },{ "DEC" , o::DEC  , m::R   , r::L       },{ "LD" , o::LD  , m::R_D8 , r::L        },{ "CPL" , o::CPL                                    }, // 2x
+    /* 3x */    { "JR"  , o::JR  , m::D8   , r::X , r::X, c::NC },{ "LD" , o::LD  , m::R_D16 , r::SP       },{ "LD" , o::LD  , m::HLD_R , r::HL, r::A        },{ "INC", o::INC , m::R    , r::SP       },{ "INC" , o::INC  , m::MR   , r::HL              },{ "DEC" , o::DEC  , m::MR   , r::HL        },{ "LD"  , o::LD  , m::MR_D8 , r::HL       },{ "SCF" , o::SCF                                     },{ "JR" , o::JR ,  m::D8     , r::X , r::X , c::C },{ "ADD" , o::ADD , m::R_R , r::HL, r::SP },{ "LD" , o::LD  , m::R_HLD , r::A, r::HL      },{ "DEC", o::DEC , m::R   , r::SP       },{ "INC" , o::INC  , m::R   , r::A             },{ "DEC" , o::DEC  , m::R   , r::A       },{ "LD" , o::LD  , m::R_D8 , r::A        },{ "CCF" , o::CCF                                    }, // 3x
+    /* 4x */    { "LD"  , o::LD  , m::R_R  , r::B , r::B        },{ "LD" , o::LD  , m::R_R   , r::B , r::C },{ "LD" , o::LD  , m::R_R   , r::B , r::D        },{ "LD" , o::LD  , m::R_R  , r::B,  r::E },{ "LD"  , o::LD   , m::R_R  , r::B , r::H        },{ "LD"  , o::LD   , m::R_R  , r::B ,  r::L },{ "LD"  , o::LD  , m::R_MR  , r::B, r::HL },{ "LD"  , o::LD  , m::R_R  , r::B , r::A             },{ "LD" , o::LD ,  m::R_R    , r::C , r::B        },{ "LD"  , o::LD  , m::R_R , r::C,  r::C  },{ "LD" , o::LD  , m::R_R   , r::C, r::D       },{ "LD" , o::LD  , m::R_R , r::C,  r::E },{ "LD"  , o::LD   , m::R_R , r::C, r::H       },{ "LD"  , o::LD   , m::R_R , r::C, r::L },{ "LD" , o::LD  , m::R_MR , r::C, r::HL },{ "LD"  , o::LD  , m::R_R , r::C,  r::A             }, // 4x
+    /* 5x */    { "LD"  , o::LD  , m::R_R  , r::D , r::B        },{ "LD" , o::LD  , m::R_R   , r::D , r::C },{ "LD" , o::LD  , m::R_R   , r::D , r::D        },{ "LD" , o::LD  , m::R_R  , r::D,  r::E },{ "LD"  , o::LD   , m::R_R  , r::D , r::H        },{ "LD"  , o::LD   , m::R_R  , r::D ,  r::L },{ "LD"  , o::LD  , m::R_MR  , r::D, r::HL },{ "LD"  , o::LD  , m::R_R  , r::D , r::A             },{ "LD" , o::LD ,  m::R_R    , r::E , r::B        },{ "LD"  , o::LD  , m::R_R , r::E,  r::C  },{ "LD" , o::LD  , m::R_R   , r::E, r::D       },{ "LD" , o::LD  , m::R_R , r::E,  r::E },{ "LD"  , o::LD   , m::R_R , r::E, r::H       },{ "LD"  , o::LD   , m::R_R , r::E, r::L },{ "LD" , o::LD  , m::R_MR , r::E, r::HL },{ "LD"  , o::LD  , m::R_R , r::E,  r::A             }, // 5x
+    /* 6x */    { "LD"  , o::LD  , m::R_R  , r::H , r::B        },{ "LD" , o::LD  , m::R_R   , r::H , r::C },{ "LD" , o::LD  , m::R_R   , r::H , r::D        },{ "LD" , o::LD  , m::R_R  , r::H,  r::E },{ "LD"  , o::LD   , m::R_R  , r::H , r::H        },{ "LD"  , o::LD   , m::R_R  , r::H ,  r::L },{ "LD"  , o::LD  , m::R_MR  , r::H, r::HL },{ "LD"  , o::LD  , m::R_R  , r::H , r::A             },{ "LD" , o::LD ,  m::R_R    , r::L , r::B        },{ "LD"  , o::LD  , m::R_R , r::L,  r::C  },{ "LD" , o::LD  , m::R_R   , r::L, r::D       },{ "LD" , o::LD  , m::R_R , r::L,  r::E },{ "LD"  , o::LD   , m::R_R , r::L, r::H       },{ "LD"  , o::LD   , m::R_R , r::L, r::L },{ "LD" , o::LD  , m::R_MR , r::L, r::HL },{ "LD"  , o::LD  , m::R_R , r::L,  r::A             }, // 6x
+    /* 7x */    { "LD"  , o::LD  , m::MR_R , r::HL, r::B        },{ "LD" , o::LD  , m::MR_R  , r::HL, r::C },{ "LD" , o::LD  , m::MR_R  , r::HL, r::D        },{ "LD" , o::LD  , m::MR_R , r::HL, r::E },{ "LD"  , o::LD   , m::MR_R , r::HL, r::H        },{ "LD"  , o::LD   , m::MR_R , r::HL,  r::L },{ "HALT", o::HALT                         },{ "LD"  , o::LD  , m::MR_R , r::HL, r::A             },{ "LD" , o::LD ,  m::R_R    , r::A , r::B        },{ "LD"  , o::LD  , m::R_R , r::A,  r::C  },{ "LD" , o::LD  , m::R_R   , r::A, r::D       },{ "LD" , o::LD  , m::R_R , r::A,  r::E },{ "LD"  , o::LD   , m::R_R , r::A, r::H       },{ "LD"  , o::LD   , m::R_R , r::A, r::L },{ "LD" , o::LD  , m::R_MR , r::A, r::HL },{ "LD"  , o::LD  , m::R_R , r::A,  r::A             }, // 7x
+    /* 8x */    { "ADD" , o::ADD , m::R_R  , r::A , r::B        },{ "ADD", o::ADD , m::R_R   , r::A , r::C },{ "ADD", o::ADD , m::R_R   , r::A , r::D        },{ "ADD", o::ADD , m::R_R  , r::A,  r::E },{ "ADD" , o::ADD  , m::R_R  , r::A , r::H        },{ "ADD" , o::ADD  , m::R_R  , r::A ,  r::L },{ "ADD" , o::ADD , m::R_MR  , r::A, r::HL },{ "ADD" , o::ADD , m::R_R  , r::A , r::A             },{ "ADC", o::ADC , m::R_R    , r::A , r::B        },{ "ADC" , o::ADC , m::R_R , r::A,  r::C  },{ "ADC", o::ADC , m::R_R   , r::A, r::D       },{ "ADC", o::ADC , m::R_R , r::A,  r::E },{ "ADC" , o::ADC  , m::R_R , r::A, r::H       },{ "ADC" , o::ADC  , m::R_R , r::A, r::L },{ "ADC", o::ADC , m::R_MR , r::A, r::HL },{ "ADC" , o::ADC , m::R_R , r::A,  r::A             }, // 8x
+    /* 9x */    { "SUB" , o::SUB , m::R_R  , r::A , r::B        },{ "SUB", o::SUB , m::R_R   , r::A , r::C },{ "SUB", o::SUB , m::R_R   , r::A , r::D        },{ "SUB", o::SUB , m::R_R  , r::A,  r::E },{ "SUB" , o::SUB  , m::R_R  , r::A , r::H        },{ "SUB" , o::SUB  , m::R_R  , r::A ,  r::L },{ "SUB" , o::SUB , m::R_MR  , r::A, r::HL },{ "SUB" , o::SUB , m::R_R  , r::A , r::A             },{ "SBC", o::SBC , m::R_R    , r::A , r::B        },{ "SBC" , o::SBC , m::R_R , r::A,  r::C  },{ "SBC", o::SBC , m::R_R   , r::A, r::D       },{ "SBC", o::SBC , m::R_R , r::A,  r::E },{ "SBC" , o::SBC  , m::R_R , r::A, r::H       },{ "SBC" , o::SBC  , m::R_R , r::A, r::L },{ "SBC", o::SBC , m::R_MR , r::A, r::HL },{ "SBC" , o::SBC , m::R_R , r::A,  r::A             }, // 9x
+    /* Ax */    { "AND" , o::AND , m::R_R  , r::A , r::B        },{ "AND", o::AND , m::R_R   , r::A , r::C },{ "AND", o::AND , m::R_R   , r::A , r::D        },{ "AND", o::AND , m::R_R  , r::A,  r::E },{ "AND" , o::AND  , m::R_R  , r::A , r::H        },{ "AND" , o::AND  , m::R_R  , r::A ,  r::L },{ "AND" , o::AND , m::R_MR  , r::A, r::HL },{ "AND" , o::AND , m::R_R  , r::A , r::A             },{ "XOR", o::XOR , m::R_R    , r::A , r::B        },{ "XOR" , o::XOR , m::R_R , r::A,  r::C  },{ "XOR", o::XOR , m::R_R   , r::A, r::D       },{ "XOR", o::XOR , m::R_R , r::A,  r::E },{ "XOR" , o::XOR  , m::R_R , r::A, r::H       },{ "XOR" , o::XOR  , m::R_R , r::A, r::L },{ "XOR", o::XOR , m::R_MR , r::A, r::HL },{ "XOR" , o::XOR , m::R_R , r::A,  r::A             }, // Ax
+    /* Bx */    { "OR"  , o::OR  , m::R_R  , r::A , r::B        },{ "OR" , o::OR  , m::R_R   , r::A , r::C },{ "OR" , o::OR  , m::R_R   , r::A , r::D        },{ "OR" , o::OR  , m::R_R  , r::A,  r::E },{ "OR"  , o::OR   , m::R_R  , r::A , r::H        },{ "OR"  , o::OR   , m::R_R  , r::A ,  r::L },{ "OR"  , o::OR  , m::R_MR  , r::A, r::HL },{ "OR"  , o::OR  , m::R_R  , r::A , r::A             },{ "CP" , o::CP ,  m::R_R    , r::A , r::B        },{ "CP"  , o::CP  , m::R_R , r::A,  r::C  },{ "CP" , o::CP  , m::R_R   , r::A, r::D       },{ "CP" , o::CP  , m::R_R , r::A,  r::E },{ "CP"  , o::CP   , m::R_R , r::A, r::H       },{ "CP"  , o::CP   , m::R_R , r::A, r::L },{ "CP" , o::CP  , m::R_MR , r::A, r::HL },{ "CP"  , o::CP  , m::R_R , r::A,  r::A             }, // Bx
+    /* Cx */    { "RET" , o::RET , m::IMP  , r::X , r::X, c::NZ },{ "POP", o::POP , m::R     , r::BC       },{ "JP" , o::JP  , m::D16   , r::X , r::X, c::NZ },{ "JP" , o::JP  , m::D16                },{ "CALL", o::CALL , m::D16  , r::X , r::X, c::NZ },{ "PUSH", o::PUSH , m::R    , r::BC        },{ "ADD" , o::ADD , m::R_D8  , r::A        },{ "RST" , o::RST , m::IMP  , r::X , r::X, c::X, 0x00 },{ "RET", o::RET , m::IMP    , r::X , r::X , c::Z },{ "RET" , o::RET                         },{ "JP" , o::JP  , m::D16   , r::X, r::X, c::Z },{ "CB" , o::CB  , m::D8                },{ "CALL", o::CALL , m::D16 , r::X, r::X, c::Z },{ "CALL", o::CALL , m::D16              },{ "ADC", o::ADC , m::R_D8 , r::A,       },{ "RST" , o::RST , m::IMP , r::X,  r::X, c::X, 0x08 }, // Cx
+    /* Dx */    { "RET" , o::RET , m::IMP  , r::X , r::X, c::NC },{ "POP", o::POP , m::R     , r::DE       },{ "JP" , o::JP  , m::D16   , r::X , r::X, c::NC },{ "XXX", o::XXX                         },{ "CALL", o::CALL , m::D16  , r::X , r::X, c::NC },{ "PUSH", o::PUSH , m::R    , r::DE        },{ "SUB" , o::SUB , m::R_D8  , r::A        },{ "RST" , o::RST , m::IMP  , r::X , r::X, c::X, 0x10 },{ "RET", o::RET , m::IMP    , r::X , r::X , c::C },{ "RETI", o::RETI                        },{ "JP" , o::JP  , m::D16   , r::X, r::X, c::C },{ "XXX", o::XXX ,                      },{ "CALL", o::CALL , m::D16 , r::X, r::X, c::C },{ "XXX" , o::XXX  ,                     },{ "SBC", o::SBC , m::R_D8 , r::A,       },{ "RST" , o::RST , m::IMP , r::X,  r::X, c::X, 0x18 }, // Dx
+    /* Ex */    { "LDH" , o::LDH , m::A8_R , r::X , r::A,       },{ "POP", o::POP , m::R     , r::HL       },{ "LD" , o::LD  , m::MR_R  , r::C , r::A        },{ "XXX", o::XXX                         },{ "XXX" , o::XXX                                 },{ "PUSH", o::PUSH , m::R    , r::HL        },{ "AND" , o::AND , m::R_D8  , r::A        },{ "RST" , o::RST , m::IMP  , r::X , r::X, c::X, 0x20 },{ "ADD", o::ADD , m::R_D8   , r::SP              },{ "JP"  , o::JP  , m::R  , r::HL         },{ "LD" , o::LD  , m::A16_R , r::X, r::A,      },{ "XXX", o::XXX ,                      },{ "XXX" , o::XXX  ,                           },{ "XXX" , o::XXX  ,                     },{ "XOR", o::XOR , m::R_D8 , r::A,       },{ "RST" , o::RST , m::IMP , r::X,  r::X, c::X, 0x28 }, // Ex
+    /* Fx */    { "LDH" , o::LDH , m::R_A8 , r::A               },{ "POP", o::POP , m::R     , r::AF       },{ "LD" , o::LD  , m::R_MR  , r::A , r::C        },{ "DI" , o::DI                          },{ "XXX" , o::XXX                                 },{ "PUSH", o::PUSH , m::R    , r::AF        },{ "OR"  , o::OR  , m::R_D8  , r::A        },{ "RST" , o::RST , m::IMP  , r::X , r::X, c::X, 0x30 },{ "LD" , o::LD  , m::HL_SPR , r::HL, r::SP       },{ "LD"  , o::LD  , m::R_R , r::SP, r::HL },{ "LD" , o::LD  , m::R_A16 , r::A,            },{ "EI" , o::EI  ,                      },{ "XXX" , o::XXX  ,                           },{ "XXX" , o::XXX  ,                     },{ "CP" , o::CP  , m::R_D8 , r::A,       },{ "RST" , o::RST , m::IMP , r::X,  r::X, c::X, 0x38 }, // Fx
+    }};                             /* x0 */                                        /* x1 */                                  /* x2 */                                          /* x3 */                                     /* x4 */                                           /* x5 */                                  /* x6 */                                          /* x7 */                                             /* x8 */                                        /* x9 */                                   /* xA */                                      /* xB */                                    /* xC */                                       /* xD */                                /* xE */                                        /* xF */
+}
+
+constexpr std::array<SM83::Instruction, 256> SM83::lookup = SM83::makeLookup();
+
+SM83::SM83(Bus* b, InterruptHandler* ih, Timer* t, GB* gb, BlockCache* bc, JIT* j)
 : bus(b)
 , intHandler(ih)
 , timer(t)
 , gameBoy(gb)
-, instruction(nullptr) {
-    using a = SM83;
-    using r = Register;
-    using c = Condition;
-    lookup = {                       /* x0 */                                        /* x1 */                                  /* x2 */                                          /* x3 */                                     /* x4 */                                           /* x5 */                                  /* x6 */                                          /* x7 */                                             /* x8 */                                        /* x9 */                                   /* xA */                                      /* xB */                                    /* xC */                                       /* xD */                                /* xE */                                        /* xF */
-    /* 0x */    { "NOP" , &a::NOP                               },{ "LD" , &a::LD , &a::R_D16, r::BC       },{ "LD" , &a::LD , &a::MR_R , r::BC, r::A        },{ "INC", &a::INC, &a::R   , r::BC       },{ "INC" , &a::INC , &a::R   , r::B               },{ "DEC" , &a::DEC , &a::R   , r::B         },{ "LD"  , &a::LD , &a::R_D8 , r::B        },{ "RLCA", &a::RLCA                                   },{ "LD" , &a::LD,  &a::A16_R , r::X , r::SP       },{ "ADD" , &a::ADD, &a::R_R, r::HL, r::BC },{ "LD" , &a::LD , &a::R_MR , r::A, r::BC      },{ "DEC", &a::DEC, &a::R  , r::BC       },{ "INC" , &a::INC , &a::R  , r::C             },{ "DEC" , &a::DEC , &a::R  , r::C       },{ "LD" , &a::LD , &a::R_D8, r::C        },{ "RRCA", &a::RRCA                                  }, // 0x
-    /* 1x */    { "STOP", &a::STOP                              },{ "LD" , &a::LD , &a::R_D16, r::DE       },{ "LD" , &a::LD , &a::MR_R , r::DE, r::A        },{ "INC", &a::INC, &a::R   , r::DE       },{ "INC" , &a::INC , &a::R   , r::D               },{ "DEC" , &a::DEC , &a::R   , r::D         },{ "LD"  , &a::LD , &a::R_D8 , r::D        },{ "RLA" , &a::RLA                                    },{ "JR" , &a::JR,  &a::D8                         },{ "ADD" , &a::ADD, &a::R_R, r::HL, r::DE },{ "LD" , &a::LD , &a::R_MR , r::A, r::DE      },{ "DEC", &a::DEC, &a::R  , r::DE       },{ "INC" , &a::INC , &a::R  , r::E             },{ "DEC" , &a::DEC , &a::R  , r::E       },{ "LD" , &a::LD , &a::R_D8, r::E        },{ "RRA" , &a::RRA                                   }, // 1x
-    /* 2x */    { "JR"  , &a::JR , &a::D8  , r::X , r::X, c::NZ },{ "LD" , &a::LD , &a::R_D16, r::HL       },{ "LD" , &a::LD , &a::HLI_R, r::HL, r::A        },{ "INC", &a::INC, &a::R   , r::HL       },{ "INC" , &a::INC , &a::R   , r::H               },{ "DEC" , &a::DEC , &a::R   , r::H         },{ "LD"  , &a::LD , &a::R_D8 , r::H        },{ "DAA" , &a::DAA                                    },{ "JR" , &a::JR,  &a::D8    , r::X , r::X , c::Z },{ "ADD" , &a::ADD, &a::R_R, r::HL, r::HL },{ "LD" , &a::LD , &a::R_HLI, r::A, r::HL      },{ "DEC", &a::DEC, &a::R  , r::HL       },{ "INC" , &a::INC , &a::R  , r::L             },{ "DEC" , &a::DEC , &a::R  , r::L       },{ "LD" , &a::LD , &a::R_D8, r::L        },{ "CPL" , &a::CPL                                   }, // 2x
-    /* 3x */    { "JR"  , &a::JR , &a::D8  , r::X , r::X, c::NC },{ "LD" , &a::LD , &a::R_D16, r::SP       },{ "LD" , &a::LD , &a::HLD_R, r::HL, r::A        },{ "INC", &a::INC, &a::R   , r::SP       },{ "INC" , &a::INC , &a::MR  , r::HL              },{ "DEC" , &a::DEC , &a::MR  , r::HL        },{ "LD"  , &a::LD , &a::MR_D8, r::HL       },{ "SCF" , &a::SCF                                    },{ "JR" , &a::JR,  &a::D8    , r::X , r::X , c::C },{ "ADD" , &a::ADD, &a::R_R, r::HL, r::SP },{ "LD" , &a::LD , &a::R_HLD, r::A, r::HL      },{ "DEC", &a::DEC, &a::R  , r::SP       },{ "INC" , &a::INC , &a::R  , r::A             },{ "DEC" , &a::DEC , &a::R  , r::A       },{ "LD" , &a::LD , &a::R_D8, r::A        },{ "CCF" , &a::CCF                                   }, // 3x
-    /* 4x */    { "LD"  , &a::LD , &a::R_R , r::B , r::B        },{ "LD" , &a::LD , &a::R_R  , r::B , r::C },{ "LD" , &a::LD , &a::R_R  , r::B , r::D        },{ "LD" , &a::LD , &a::R_R , r::B,  r::E },{ "LD"  , &a::LD  , &a::R_R , r::B , r::H        },{ "LD"  , &a::LD  , &a::R_R , r::B ,  r::L },{ "LD"  , &a::LD , &a::R_MR , r::B, r::HL },{ "LD"  , &a::LD , &a::R_R , r::B , r::A             },{ "LD" , &a::LD,  &a::R_R   , r::C , r::B        },{ "LD"  , &a::LD , &a::R_R, r::C,  r::C  },{ "LD" , &a::LD , &a::R_R  , r::C, r::D       },{ "LD" , &a::LD , &a::R_R, r::C,  r::E },{ "LD"  , &a::LD  , &a::R_R, r::C, r::H       },{ "LD"  , &a::LD  , &a::R_R, r::C, r::L },{ "LD" , &a::LD , &a::R_MR, r::C, r::HL },{ "LD"  , &a::LD , &a::R_R, r::C,  r::A             }, // 4x
-    /* 5x */    { "LD"  , &a::LD , &a::R_R , r::D , r::B        },{ "LD" , &a::LD , &a::R_R  , r::D , r::C },{ "LD" , &a::LD , &a::R_R  , r::D , r::D        },{ "LD" , &a::LD , &a::R_R , r::D,  r::E },{ "LD"  , &a::LD  , &a::R_R , r::D , r::H        },{ "LD"  , &a::LD  , &a::R_R , r::D ,  r::L },{ "LD"  , &a::LD , &a::R_MR , r::D, r::HL },{ "LD"  , &a::LD , &a::R_R , r::D , r::A             },{ "LD" , &a::LD,  &a::R_R   , r::E , r::B        },{ "LD"  , &a::LD , &a::R_R, r::E,  r::C  },{ "LD" , &a::LD , &a::R_R  , r::E, r::D       },{ "LD" , &a::LD , &a::R_R, r::E,  r::E },{ "LD"  , &a::LD  , &a::R_R, r::E, r::H       },{ "LD"  , &a::LD  , &a::R_R, r::E, r::L },{ "LD" , &a::LD , &a::R_MR, r::E, r::HL },{ "LD"  , &a::LD , &a::R_R, r::E,  r::A             }, // 5x
-    /* 6x */    { "LD"  , &a::LD , &a::R_R , r::H , r::B        },{ "LD" , &a::LD , &a::R_R  , r::H , r::C },{ "LD" , &a::LD , &a::R_R  , r::H , r::D        },{ "LD" , &a::LD , &a::R_R , r::H,  r::E },{ "LD"  , &a::LD  , &a::R_R , r::H , r::H        },{ "LD"  , &a::LD  , &a::R_R , r::H ,  r::L },{ "LD"  , &a::LD , &a::R_MR , r::H, r::HL },{ "LD"  , &a::LD , &a::R_R , r::H , r::A             },{ "LD" , &a::LD,  &a::R_R   , r::L , r::B        },{ "LD"  , &a::LD , &a::R_R, r::L,  r::C  },{ "LD" , &a::LD , &a::R_R  , r::L, r::D       },{ "LD" , &a::LD , &a::R_R, r::L,  r::E },{ "LD"  , &a::LD  , &a::R_R, r::L, r::H       },{ "LD"  , &a::LD  , &a::R_R, r::L, r::L },{ "LD" , &a::LD , &a::R_MR, r::L, r::HL },{ "LD"  , &a::LD , &a::R_R, r::L,  r::A             }, // 6x
-    /* 7x */    { "LD"  , &a::LD , &a::MR_R, r::HL, r::B        },{ "LD" , &a::LD , &a::MR_R , r::HL, r::C },{ "LD" , &a::LD , &a::MR_R , r::HL, r::D        },{ "LD" , &a::LD , &a::MR_R, r::HL, r::E },{ "LD"  , &a::LD  , &a::MR_R, r::HL, r::H        },{ "LD"  , &a::LD  , &a::MR_R, r::HL,  r::L },{ "HALT", &a::HALT                        },{ "LD"  , &a::LD , &a::MR_R, r::HL, r::A             },{ "LD" , &a::LD,  &a::R_R   , r::A , r::B        },{ "LD"  , &a::LD , &a::R_R, r::A,  r::C  },{ "LD" , &a::LD , &a::R_R  , r::A, r::D       },{ "LD" , &a::LD , &a::R_R, r::A,  r::E },{ "LD"  , &a::LD  , &a::R_R, r::A, r::H       },{ "LD"  , &a::LD  , &a::R_R, r::A, r::L },{ "LD" , &a::LD , &a::R_MR, r::A, r::HL },{ "LD"  , &a::LD , &a::R_R, r::A,  r::A             }, // 7x
-    /* 8x */    { "ADD" , &a::ADD, &a::R_R , r::A , r::B        },{ "ADD", &a::ADD, &a::R_R  , r::A , r::C },{ "ADD", &a::ADD, &a::R_R  , r::A , r::D        },{ "ADD", &a::ADD, &a::R_R , r::A,  r::E },{ "ADD" , &a::ADD , &a::R_R , r::A , r::H        },{ "ADD" , &a::ADD , &a::R_R , r::A ,  r::L },{ "ADD" , &a::ADD, &a::R_MR , r::A, r::HL },{ "ADD" , &a::ADD, &a::R_R , r::A , r::A             },{ "ADC", &a::ADC, &a::R_R   , r::A , r::B        },{ "ADC" , &a::ADC, &a::R_R, r::A,  r::C  },{ "ADC", &a::ADC, &a::R_R  , r::A, r::D       },{ "ADC", &a::ADC, &a::R_R, r::A,  r::E },{ "ADC" , &a::ADC , &a::R_R, r::A, r::H       },{ "ADC" , &a::ADC , &a::R_R, r::A, r::L },{ "ADC", &a::ADC, &a::R_MR, r::A, r::HL },{ "ADC" , &a::ADC, &a::R_R, r::A,  r::A             }, // 8x
-    /* 9x */    { "SUB" , &a::SUB, &a::R_R , r::A , r::B        },{ "SUB", &a::SUB, &a::R_R  , r::A , r::C },{ "SUB", &a::SUB, &a::R_R  , r::A , r::D        },{ "SUB", &a::SUB, &a::R_R , r::A,  r::E },{ "SUB" , &a::SUB , &a::R_R , r::A , r::H        },{ "SUB" , &a::SUB , &a::R_R , r::A ,  r::L },{ "SUB" , &a::SUB, &a::R_MR , r::A, r::HL },{ "SUB" , &a::SUB, &a::R_R , r::A , r::A             },{ "SBC", &a::SBC, &a::R_R   , r::A , r::B        },{ "SBC" , &a::SBC, &a::R_R, r::A,  r::C  },{ "SBC", &a::SBC, &a::R_R  , r::A, r::D       },{ "SBC", &a::SBC, &a::R_R, r::A,  r::E },{ "SBC" , &a::SBC , &a::R_R, r::A, r::H       },{ "SBC" , &a::SBC , &a::R_R, r::A, r::L },{ "SBC", &a::SBC, &a::R_MR, r::A, r::HL },{ "SBC" , &a::SBC, &a::R_R, r::A,  r::A             }, // 9x
-    /* Ax */    { "AND" , &a::AND, &a::R_R , r::A , r::B        },{ "AND", &a::AND, &a::R_R  , r::A , r::C },{ "AND", &a::AND, &a::R_R  , r::A , r::D        },{ "AND", &a::AND, &a::R_R , r::A,  r::E },{ "AND" , &a::AND , &a::R_R , r::A , r::H        },{ "AND" , &a::AND , &a::R_R , r::A ,  r::L },{ "AND" , &a::AND, &a::R_MR , r::A, r::HL },{ "AND" , &a::AND, &a::R_R , r::A , r::A             },{ "XOR", &a::XOR, &a::R_R   , r::A , r::B        },{ "XOR" , &a::XOR, &a::R_R, r::A,  r::C  },{ "XOR", &a::XOR, &a::R_R  , r::A, r::D       },{ "XOR", &a::XOR, &a::R_R, r::A,  r::E },{ "XOR" , &a::XOR , &a::R_R, r::A, r::H       },{ "XOR" , &a::XOR , &a::R_R, r::A, r::L },{ "XOR", &a::XOR, &a::R_MR, r::A, r::HL },{ "XOR" , &a::XOR, &a::R_R, r::A,  r::A             }, // Ax
-    /* Bx */    { "OR"  , &a::OR , &a::R_R , r::A , r::B        },{ "OR" , &a::OR , &a::R_R  , r::A , r::C },{ "OR" , &a::OR , &a::R_R  , r::A , r::D        },{ "OR" , &a::OR , &a::R_R , r::A,  r::E },{ "OR"  , &a::OR  , &a::R_R , r::A , r::H        },{ "OR"  , &a::OR  , &a::R_R , r::A ,  r::L },{ "OR"  , &a::OR , &a::R_MR , r::A, r::HL },{ "OR"  , &a::OR , &a::R_R , r::A , r::A             },{ "CP" , &a::CP,  &a::R_R   , r::A , r::B        },{ "CP"  , &a::CP , &a::R_R, r::A,  r::C  },{ "CP" , &a::CP , &a::R_R  , r::A, r::D       },{ "CP" , &a::CP , &a::R_R, r::A,  r::E },{ "CP"  , &a::CP  , &a::R_R, r::A, r::H       },{ "CP"  , &a::CP  , &a::R_R, r::A, r::L },{ "CP" , &a::CP , &a::R_MR, r::A, r::HL },{ "CP"  , &a::CP , &a::R_R, r::A,  r::A             }, // Bx
-    /* Cx */    { "RET" , &a::RET, &a::IMP , r::X , r::X, c::NZ },{ "POP", &a::POP, &a::R    , r::BC       },{ "JP" , &a::JP , &a::D16  , r::X , r::X, c::NZ },{ "JP" , &a::JP , &a::D16               },{ "CALL", &a::CALL, &a::D16 , r::X , r::X, c::NZ },{ "PUSH", &a::PUSH, &a::R   , r::BC        },{ "ADD" , &a::ADD, &a::R_D8 , r::A        },{ "RST" , &a::RST, &a::IMP , r::X , r::X, c::X, 0x00 },{ "RET", &a::RET, &a::IMP   , r::X , r::X , c::Z },{ "RET" , &a::RET                        },{ "JP" , &a::JP , &a::D16  , r::X, r::X, c::Z },{ "CB" , &a::CB , &a::D8               },{ "CALL", &a::CALL, &a::D16, r::X, r::X, c::Z },{ "CALL", &a::CALL, &a::D16             },{ "ADC", &a::ADC, &a::R_D8, r::A,       },{ "RST" , &a::RST, &a::IMP, r::X,  r::X, c::X, 0x08 }, // Cx
-    /* Dx */    { "RET" , &a::RET, &a::IMP , r::X , r::X, c::NC },{ "POP", &a::POP, &a::R    , r::DE       },{ "JP" , &a::JP , &a::D16  , r::X , r::X, c::NC },{ "XXX", &a::XXX                        },{ "CALL", &a::CALL, &a::D16 , r::X , r::X, c::NC },{ "PUSH", &a::PUSH, &a::R   , r::DE        },{ "SUB" , &a::SUB, &a::R_D8 , r::A        },{ "RST" , &a::RST, &a::IMP , r::X , r::X, c::X, 0x10 },{ "RET", &a::RET, &a::IMP   , r::X , r::X , c::C },{ "RETI", &a::RETI                       },{ "JP" , &a::JP , &a::D16  , r::X, r::X, c::C },{ "XXX", &a::XXX,                      },{ "CALL", &a::CALL, &a::D16, r::X, r::X, c::C },{ "XXX" , &a::XXX ,                     },{ "SBC", &a::SBC, &a::R_D8, r::A,       },{ "RST" , &a::RST, &a::IMP, r::X,  r::X, c::X, 0x18 }, // Dx
-    /* Ex */    { "LDH" , &a::LDH, &a::A8_R, r::X , r::A,       },{ "POP", &a::POP, &a::R    , r::HL       },{ "LD" , &a::LD , &a::MR_R , r::C , r::A        },{ "XXX", &a::XXX                        },{ "XXX" , &a::XXX                                },{ "PUSH", &a::PUSH, &a::R   , r::HL        },{ "AND" , &a::AND, &a::R_D8 , r::A        },{ "RST" , &a::RST, &a::IMP , r::X , r::X, c::X, 0x20 },{ "ADD", &a::ADD, &a::R_D8  , r::SP              },{ "JP"  , &a::JP , &a::R , r::HL         },{ "LD" , &a::LD , &a::A16_R, r::X, r::A,      },{ "XXX", &a::XXX,                      },{ "XXX" , &a::XXX ,                           },{ "XXX" , &a::XXX ,                     },{ "XOR", &a::XOR, &a::R_D8, r::A,       },{ "RST" , &a::RST, &a::IMP, r::X,  r::X, c::X, 0x28 }, // Ex
-    /* Fx */    { "LDH" , &a::LDH, &a::R_A8, r::A               },{ "POP", &a::POP, &a::R    , r::AF       },{ "LD" , &a::LD , &a::R_MR , r::A , r::C        },{ "DI" , &a::DI                         },{ "XXX" , &a::XXX                                },{ "PUSH", &a::PUSH, &a::R   , r::AF        },{ "OR"  , &a::OR , &a::R_D8 , r::A        },{ "RST" , &a::RST, &a::IMP , r::X , r::X, c::X, 0x30 },{ "LD" , &a::LD , &a::HL_SPR, r::HL, r::SP       },{ "LD"  , &a::LD , &a::R_R, r::SP, r::HL },{ "LD" , &a::LD , &a::R_A16, r::A,            },{ "EI" , &a::EI ,                      },{ "XXX" , &a::XXX ,                           },{ "XXX" , &a::XXX ,                     },{ "CP" , &a::CP , &a::R_D8, r::A,       },{ "RST" , &a::RST, &a::IMP, r::X,  r::X, c::X, 0x38 }, // Fx
-    };                              /* x0 */                                        /* x1 */                                  /* x2 */                                          /* x3 */                                     /* x4 */                                           /* x5 */                                  /* x6 */                                          /* x7 */                                             /* x8 */                                        /* x9 */                                   /* xA */                                      /* xB */                                    /* xC */                                       /* xD */                                /* xE */                                        /* xF */
-
-    // Order is important here for decoding CB-prefixed instructions:
-    // See table "rot" at https://gb-archive.github.io/salvage/decoding_gbz80_opcodes/Decoding%20Gamboy%20Z80%20Opcodes.html
-    // Note: BIT, RES, and SET are called in a switch statement in the SM83::CB function.
-    cbLookup = {
-            { "RLC" , &a::RLC  }, // 0
-            { "RRC" , &a::RRC  }, // 1
-            { "RL"  , &a::RL   }, // 2
-            { "RR"  , &a::RR   }, // 3
-            { "SLA" , &a::SLA  }, // 4
-            { "SRA" , &a::SRA  }, // 5
-            { "SWAP", &a::SWAP }, // 6
-            { "SRL" , &a::SRL  }  // 7
-    };
-}
+, blockCache(bc)
+, jit(j) {}
 
 SM83::~SM83() = default;
 
@@ -56,6 +52,7 @@ SM83::~SM83() = default;
 void SM83::init() {
     a = 0x01;
     f = 0xB0;
+    lazyOp = LazyOp::None;
     b = 0x00;
     c = 0x13;
     d = 0x00;
@@ -101,19 +98,23 @@ void SM83::write(uint16_t addr, uint8_t data) {
  */
 bool SM83::step() {
     if (!halted) {
+        if (useIdleSkip && skipIdleLoop()) {
+            // Nothing to execute: The polling loop at PC would have kept looping during the skipped cycles.
+        } else if (!useJIT || !runNative()) {
 #if LOGGING
-        logPC = pc;
-        logTicks = gameBoy->ticks;
-//        logSB = bus->read(0xFF01);
-//        logSC = bus->read(0xFF02);
+            logPC = pc;
+            logTicks = gameBoy->ticks;
+//            logSB = bus->read(0xFF01);
+//            logSC = bus->read(0xFF02);
 #endif
-        fetch();
-        execute();
+            fetch();
+            execute();
 #if LOGGING
-        disassemble();
+            disassemble();
 #endif
+        }
     } else { // halted
-        emulateCycles(1);
+        emulateCycles(haltedCycles());
         if (intHandler->interruptRequested())  // IF & IE & 0x1F != 0
             halted = false;
     }
@@ -135,23 +136,450 @@ bool SM83::step() {
 
 /**
  * Fetches an instruction from lookup table based on current opcode.
+ * If the instruction has been predecoded (see SM83::nextCachedOp), the M-cycle of the opcode fetch is emulated
+ * without going through the bus, and its immediate operands are later taken from the block as well.
  */
 void SM83::fetch() {
-    opcode = read(pc++);
-    instruction = &lookup[opcode];
+    cachedOp = nextCachedOp();
+    if (cachedOp) {
+        emulateCycles(1);
+        opcode = cachedOp->opcode;
+        operandIdx = 0;
+        pc++;
+    } else {
+        opcode = read(pc++);
+    }
 }
 
 /**
- * Executes an instruction based on its addressing mode and operation.
+ * Fetches the next immediate operand byte of the current instruction (one M-cycle).
+ *
+ * @return The byte following the opcode (or the previous operand byte).
  */
-void SM83::execute() {
-    if (!instruction) {
-        std::cerr << "ERROR. Instruction is null. Exiting..." << std::endl;
-        std::exit(-1);
+uint8_t SM83::fetchOperand() {
+    if (!cachedOp)
+        return read(pc++);
+    emulateCycles(1);
+    pc++;
+    return cachedOp->operand[operandIdx++];
+}
+
+/**
+ * Returns the predecoded instruction at PC, if any. The CPU keeps executing the current block for as long as
+ * each instruction falls through to the next one and the cache hasn't been invalidated in the meantime (bank
+ * switch or write to cached RAM code). Otherwise, the block starting at PC is looked up, and decoded on a miss.
+ *
+ * @return The predecoded instruction at PC, or nullptr if the code at PC can't be cached.
+ */
+const BlockCache::Op* SM83::nextCachedOp() {
+    if (!inBlock() && !enterBlock())
+        return nullptr;
+    return &block->ops[blockIdx++];
+}
+
+/**
+ * @return True if the instruction at PC is the next one of the current block, which is still valid.
+ */
+bool SM83::inBlock() const {
+    return block && blockGeneration == blockCache->generation()
+        && blockIdx < block->ops.size() && block->ops[blockIdx].pc == pc;
+}
+
+/**
+ * Looks up the block starting at PC, decoding it on a miss, and makes it the current block.
+ *
+ * @return True if there is a block at PC, false if the code at PC can't be cached.
+ */
+bool SM83::enterBlock() {
+    block = nullptr;
+    if (!blockCache->isCacheable(pc))
+        return false;
+
+    blockGeneration = blockCache->generation();
+    block = blockCache->lookup(pc);
+    if (!block)
+        block = decodeBlock(pc);
+    blockIdx = 0;
+    return block != nullptr;
+}
+
+/**
+ * Selects whether translated blocks are run (see JIT.hpp) or everything is interpreted.
+ * The JIT is only available on x86-64; on other platforms, the interpreter stays selected.
+ *
+ * @param enable True to select the JIT, false to select the interpreter.
+ */
+void SM83::enableJIT(bool enable) {
+    if (enable && !JIT::isSupported()) {
+        std::cerr << "JIT is not supported on this platform, using the interpreter" << std::endl;
+        return;
     }
-    dstIsMem = false;                 // Reset
-    (this->*instruction->addrmode)(); // Fetch operands if necessary
-    (this->*instruction->operate)();  // Execute instruction
+    useJIT = enable;
+}
+
+/**
+ * Runs the block starting at PC as native code, translating it first once it has been entered often enough.
+ * The native code only executes instructions that operate on registers, so the M-cycles it took can be emulated
+ * in one go afterwards. This is only done if the interpreter wouldn't have dispatched an interrupt in the middle
+ * of the block: EI must not be pending, and if IME is set, no interrupt may be requested already and no scheduled
+ * event (the only source of interrupt requests while the CPU stays off the bus) may fall within the block.
+ *
+ * @return True if native code was run, false if the instruction at PC is to be interpreted.
+ */
+bool SM83::runNative() {
+    // Native code is only entered at the start of a block. Otherwise, the current block is interpreted, and
+    // if the block at PC has to be looked up, SM83::nextCachedOp will carry on from here.
+    if (!atBlockStart())
+        return false;
+
+    if (!block->native) {
+        if (block->translated || ++block->hits < JIT::HOT_THRESHOLD)
+            return false;
+        if (!jit->hasSpace()) {
+            blockCache->dropTranslations();
+            jit->flush();
+        }
+        block->translated = true;
+        block->native = jit->translate(*block, block->maxCycles);
+        if (!block->native)
+            return false;
+    }
+
+    if (intHandler->scheduledIME)
+        return false;
+    if (intHandler->IME && (intHandler->interruptRequested() ||
+        gameBoy->scheduler->nextEventTime() < gameBoy->ticks + 4 * block->maxCycles))
+        return false;
+
+    resolveFlags();
+    JIT::State state = { c, b, e, d, l, h, f, a, sp, pc };
+    uint32_t cycles = jit->run(block->native, state);
+    a = state.a; f = state.f; b = state.b; c = state.c;
+    d = state.d; e = state.e; h = state.h; l = state.l;
+    sp = state.sp; pc = state.pc;
+
+    block = nullptr;
+    emulateCycles(static_cast<int>(cycles));
+    return true;
+}
+
+/**
+ * @return True if PC is the start of a block, which is then the current block (looking it up if needed).
+ */
+bool SM83::atBlockStart() {
+    if (inBlock())
+        return blockIdx == 0;
+    return enterBlock();
+}
+
+/**
+ * Skips iterations of a polling loop, i.e., a block that reads an I/O register, tests it and branches back to
+ * itself (e.g., 'LDH A,(44h); CP 90h; JR NZ' waiting for VBlank). As long as the register keeps the value it has
+ * now, each iteration leaves the CPU exactly as it found it, so whole iterations can be emulated in one go up to
+ * the point where the register may change. No scheduled event may fall within the skipped cycles either, as it
+ * might change the register or request an interrupt, so the very same events are dispatched as if the loop had
+ * been executed instruction by instruction.
+ *
+ * @return True if iterations were skipped, false if the instruction at PC is to be executed.
+ */
+bool SM83::skipIdleLoop() {
+    if (!atBlockStart())
+        return false;
+
+    if (!block->idleChecked) {
+        block->idleCycles  = idleLoopCycles(*block);
+        block->idleChecked = true;
+    }
+    if (!block->idleCycles)
+        return false;
+
+    // An interrupt would be dispatched right after the next instruction.
+    if (intHandler->scheduledIME || (intHandler->IME && intHandler->interruptRequested()))
+        return false;
+
+    uint16_t addr = polledAddress(block->ops.front());
+    if (!loopsAgain(*block, bus->read(addr)))
+        return false;
+
+    uint64_t now   = gameBoy->ticks;
+    uint64_t until = std::min({ gameBoy->scheduler->nextEventTime() - 1, nextIORegisterChange(addr),
+                                now + MAX_SKIP_TICKS });
+    if (until <= now)
+        return false;
+    uint64_t iterations = (until - now) / (4 * block->idleCycles);
+    if (!iterations)
+        return false;
+
+    int cycles = static_cast<int>(iterations * block->idleCycles);
+    idleCycles += cycles;
+    emulateCycles(cycles);
+    return true;
+}
+
+/**
+ * Checks if executing a polling loop (see SM83::idleLoopCycles) would branch back to its start without changing
+ * any register, given the value read from the polled register.
+ *
+ * @param loop The polling loop.
+ * @param value The value of the polled register.
+ * @return True if an iteration would be a no-op.
+ */
+bool SM83::loopsAgain(const BlockCache::Block& loop, uint8_t value) const {
+    uint8_t ra = value;
+    uint8_t rf = flags();
+    for (size_t i = 1; i + 1 < loop.ops.size(); i++) {
+        const BlockCache::Op& op = loop.ops[i];
+        uint8_t n = op.operand[0];
+        switch (op.opcode) {
+            case 0xFE: // CP u8
+                rf = (rf & 0x0F) | (ra == n ? Z : 0) | N | ((ra & 0x0F) < (n & 0x0F) ? H : 0) | (ra < n ? C : 0);
+                break;
+            case 0xE6: // AND u8
+                ra &= n;
+                rf = (rf & 0x0F) | (ra == 0 ? Z : 0) | H;
+                break;
+            default:   // BIT b,A
+                rf = (rf & (0x0F | C)) | ((ra >> ((n >> 3) & 7)) & 1 ? 0 : Z) | H;
+                break;
+        }
+    }
+
+    // Bits 3-4 of a conditional JR/JP select the condition: NZ, Z, NC or C.
+    uint8_t branch = loop.ops.back().opcode;
+    bool taken = true;
+    if (branch != 0x18 && branch != 0xC3) {
+        uint8_t cond = (branch >> 3) & 3;
+        bool set = rf & (cond < 2 ? Z : C);
+        taken = (cond & 1) ? set : !set;
+    }
+    return taken && ra == a && rf == flags();
+}
+
+/**
+ * Returns the earliest T-cycle at which a polled I/O register may change on its own. IF only changes when a
+ * scheduled event requests an interrupt, and the joypad when the UI thread updates it (see SM83::MAX_SKIP_TICKS).
+ *
+ * @param addr The address of the register (see SM83::polledAddress).
+ * @return The T-cycle, or Scheduler::NEVER if it only changes through events.
+ */
+uint64_t SM83::nextIORegisterChange(uint16_t addr) const {
+    switch (addr) {
+        case 0xFF04: return gameBoy->ticks + 0x100 - (timer->systemClock() & 0xFF); // DIV
+        case 0xFF41:                                                                // STAT
+        case 0xFF44: return gameBoy->ppu->nextRegisterChange(addr);                 // LY
+        default:     return Scheduler::NEVER;                                       // P1, IF
+    }
+}
+
+/**
+ * @param load The first instruction of a polling loop: LDH A,(u8) or LD A,(u16).
+ * @return The address it reads from.
+ */
+uint16_t SM83::polledAddress(const BlockCache::Op& load) {
+    if (load.opcode == 0xF0)
+        return 0xFF00 | load.operand[0];
+    return load.operand[0] | (load.operand[1] << 8);
+}
+
+/**
+ * Checks if a block is a polling loop: It has to load A from P1, DIV, IF, STAT or LY, test it with any number of
+ * CP u8, AND u8 and BIT b,A, and branch back to its start with a JR or JP (conditional or not). Nothing else may
+ * happen in between, so that the loop can only exit once the register changes.
+ *
+ * @param block The block to check.
+ * @return The M-cycles of an iteration (with the branch taken), or 0 if the block is not a polling loop.
+ */
+uint8_t SM83::idleLoopCycles(const BlockCache::Block& block) {
+    if (block.ops.size() < 2)
+        return 0;
+
+    const BlockCache::Op& load = block.ops.front();
+    if (load.opcode != 0xF0 && load.opcode != 0xFA) // LDH A,(u8), LD A,(u16)
+        return 0;
+    switch (polledAddress(load)) {
+        case 0xFF00: case 0xFF04: case 0xFF0F: case 0xFF41: case 0xFF44: break;
+        default:                                                         return 0;
+    }
+    uint8_t cycles = load.length + 1;
+
+    for (size_t i = 1; i + 1 < block.ops.size(); i++) {
+        const BlockCache::Op& op = block.ops[i];
+        bool bitA = op.opcode == 0xCB && (op.operand[0] & 0xC7) == 0x47;
+        if (op.opcode != 0xFE && op.opcode != 0xE6 && !bitA) // CP u8, AND u8, BIT b,A
+            return 0;
+        cycles += 2;
+    }
+
+    const BlockCache::Op& branch = block.ops.back();
+    auto next = static_cast<uint16_t>(branch.pc + branch.length);
+    bool jr = branch.opcode == 0x18 || (branch.opcode & 0xE7) == 0x20;
+    bool jp = branch.opcode == 0xC3 || (branch.opcode & 0xE7) == 0xC2;
+    uint16_t target = jr ? static_cast<uint16_t>(next + static_cast<int8_t>(branch.operand[0]))
+                         : static_cast<uint16_t>(branch.operand[0] | (branch.operand[1] << 8));
+    if ((!jr && !jp) || target != load.pc)
+        return 0;
+    return cycles + (jp ? 4 : 3); // Taken JP u16 (4) or JR s8 (3)
+}
+
+/**
+ * Decodes the straight-line run of instructions starting at the given address into a new block.
+ * The block ends after the first branch, HALT or STOP, before an instruction that would straddle
+ * a memory region boundary, or once it reaches BlockCache::MAX_BLOCK_LENGTH instructions.
+ * Reading ROM, WRAM and HRAM has no side effects, so the bytes are read straight from the bus.
+ *
+ * @param start The address of the first opcode.
+ * @return The cached block, or nullptr if not even the first instruction could be decoded.
+ */
+BlockCache::Block* SM83::decodeBlock(uint16_t start) {
+    BlockCache::Block newBlock;
+    uint32_t end  = blockCache->regionEnd(start);
+    uint32_t addr = start;
+
+    while (newBlock.ops.size() < BlockCache::MAX_BLOCK_LENGTH) {
+        uint8_t opc = bus->read(addr);
+        const Instruction& ins = lookup[opc];
+        uint8_t length = 1 + operandCount(ins);
+        if (addr + length > end)
+            break;
+
+        BlockCache::Op op = { static_cast<uint16_t>(addr), opc, length, {} };
+        for (int i = 1; i < length; i++)
+            op.operand[i - 1] = bus->read(addr + i);
+        newBlock.ops.push_back(op);
+        addr += length;
+
+        if (endsBlock(ins))
+            break;
+    }
+
+    if (newBlock.ops.empty())
+        return nullptr;
+    return blockCache->insert(start, std::move(newBlock));
+}
+
+/**
+ * @return The number of immediate operand bytes of an instruction, as fetched by its addressing mode.
+ */
+uint8_t SM83::operandCount(const Instruction& ins) {
+    using m = AddrMode;
+    auto mode = ins.addrmode;
+    if (mode == m::D16 || mode == m::R_D16 || mode == m::R_A16 || mode == m::A16_R)
+        return 2;
+    if (mode == m::D8 || mode == m::R_D8 || mode == m::MR_D8 || mode == m::HL_SPR ||
+        mode == m::R_A8 || mode == m::A8_R)
+        return 1;
+    return 0;
+}
+
+/**
+ * @return True if an instruction may not fall through to the next one (branches, HALT and STOP).
+ */
+bool SM83::endsBlock(const Instruction& ins) {
+    using o = Operation;
+    auto op = ins.operate;
+    return op == o::JP   || op == o::JR  || op == o::CALL || op == o::RET  ||
+           op == o::RETI || op == o::RST || op == o::HALT || op == o::STOP ||
+           op == o::XXX;
+}
+
+/**
+ * Executes an instruction based on its addressing mode and operation, by calling the handler
+ * generated for the opcode (see SM83::handler).
+ */
+void SM83::execute() {
+    handlers[opcode](this);
+}
+
+/**
+ * Executes a specific opcode: Fetches its operands as per its addressing mode, then performs its operation.
+ * Since the opcode is a template parameter, its registers and condition are compile-time constants,
+ * and the addressing mode and operation are inlined into a single function.
+ */
+template <uint8_t Op>
+void SM83::handler(SM83* cpu) {
+    cpu->fetchOperands<Op>(); // Fetch operands if necessary
+    cpu->operate<Op>();       // Execute instruction
+}
+
+/**
+ * Calls the addressing mode of an opcode.
+ */
+template <uint8_t Op>
+void SM83::fetchOperands() {
+    using m = AddrMode;
+    constexpr AddrMode mode = lookup[Op].addrmode;
+    if      constexpr (mode == m::IMP)    IMP();
+    else if constexpr (mode == m::R)      R<Op>();
+    else if constexpr (mode == m::R_R)    R_R<Op>();
+    else if constexpr (mode == m::D8)     D8();
+    else if constexpr (mode == m::R_D8)   R_D8();
+    else if constexpr (mode == m::MR_D8)  MR_D8<Op>();
+    else if constexpr (mode == m::D16)    D16();
+    else if constexpr (mode == m::R_D16)  R_D16();
+    else if constexpr (mode == m::MR)     MR<Op>();
+    else if constexpr (mode == m::R_MR)   R_MR<Op>();
+    else if constexpr (mode == m::MR_R)   MR_R<Op>();
+    else if constexpr (mode == m::R_HLI)  R_HLI();
+    else if constexpr (mode == m::R_HLD)  R_HLD();
+    else if constexpr (mode == m::HLI_R)  HLI_R<Op>();
+    else if constexpr (mode == m::HLD_R)  HLD_R<Op>();
+    else if constexpr (mode == m::HL_SPR) HL_SPR();
+    else if constexpr (mode == m::R_A8)   R_A8();
+    else if constexpr (mode == m::A8_R)   A8_R<Op>();
+    else if constexpr (mode == m::R_A16)  R_A16();
+    else if constexpr (mode == m::A16_R)  A16_R<Op>();
+}
+
+/**
+ * Calls the operation of an opcode.
+ */
+template <uint8_t Op>
+void SM83::operate() {
+    using o = Operation;
+    constexpr Operation op = lookup[Op].operate;
+    if      constexpr (op == o::ADC)  ADC();
+    else if constexpr (op == o::ADD)  ADD<Op>();
+    else if constexpr (op == o::AND)  AND();
+    else if constexpr (op == o::CALL) CALL<Op>();
+    else if constexpr (op == o::CB)   CB();
+    else if constexpr (op == o::CCF)  CCF();
+    else if constexpr (op == o::CP)   CP();
+    else if constexpr (op == o::CPL)  CPL();
+    else if constexpr (op == o::DAA)  DAA();
+    else if constexpr (op == o::DEC)  DEC<Op>();
+    else if constexpr (op == o::DI)   DI();
+    else if constexpr (op == o::EI)   EI();
+    else if constexpr (op == o::HALT) HALT();
+    else if constexpr (op == o::INC)  INC<Op>();
+    else if constexpr (op == o::JP)   JP<Op>();
+    else if constexpr (op == o::JR)   JR<Op>();
+    else if constexpr (op == o::LD)   LD<Op>();
+    else if constexpr (op == o::LDH)  LDH<Op>();
+    else if constexpr (op == o::NOP)  NOP();
+    else if constexpr (op == o::OR)   OR();
+    else if constexpr (op == o::POP)  POP<Op>();
+    else if constexpr (op == o::PUSH) PUSH();
+    else if constexpr (op == o::RET)  RET<Op>();
+    else if constexpr (op == o::RETI) RETI<Op>();
+    else if constexpr (op == o::RLA)  RLA();
+    else if constexpr (op == o::RLCA) RLCA();
+    else if constexpr (op == o::RRA)  RRA();
+    else if constexpr (op == o::RRCA) RRCA();
+    else if constexpr (op == o::RST)  RST<Op>();
+    else if constexpr (op == o::SBC)  SBC();
+    else if constexpr (op == o::SCF)  SCF();
+    else if constexpr (op == o::STOP) STOP();
+    else if constexpr (op == o::SUB)  SUB();
+    else if constexpr (op == o::XOR)  XOR();
+    else if constexpr (op == o::XXX)  XXX();
+}
+
+/**
+ * @return An array holding the handler of each opcode (see SM83::handler).
+ */
+template <size_t... Op>
+constexpr std::array<SM83::Handler, sizeof...(Op)> SM83::makeHandlers(std::index_sequence<Op...>) {
+    return { &SM83::handler<Op>... };
 }
 
 /**
@@ -193,61 +621,74 @@ void SM83::emulateCycles(int mCycles) const {
     gameBoy->emulateCycles(mCycles);
 }
 
+/**
+ * Returns the number of M-cycles a halted CPU can emulate before it has to check for an interrupt again.
+ * Apart from the joypad's, every interrupt is requested by a scheduled event (a PPU interrupt, a TIMA reload or
+ * a serial transfer completing), so nothing can wake the CPU up before the M-cycle of the next pending event.
+ * Skipping straight to it dispatches the very same events as emulating one M-cycle at a time would.
+ *
+ * @return The M-cycles up to and including the next event (at least 1, at most SM83::MAX_SKIP_TICKS / 4).
+ */
+int SM83::haltedCycles() const {
+    uint64_t now  = gameBoy->ticks;
+    uint64_t next = std::min(gameBoy->scheduler->nextEventTime(), now + MAX_SKIP_TICKS);
+    return next <= now + 4 ? 1 : static_cast<int>((next - now + 3) / 4);
+}
+
 /**
  * Reads CPU registers (8- or 16-bit).
- * @param r Register to read
+ * @tparam R Register to read
  * @return Value of register or register pair
  */
-uint16_t SM83::readReg(Register r) {
-    switch (r) {
-        case Register::A:  return a;
-        case Register::F:  return f;
-        case Register::B:  return b;
-        case Register::C:  return c;
-        case Register::D:  return d;
-        case Register::E:  return e;
-        case Register::H:  return h;
-        case Register::L:  return l;
-        case Register::AF: return ((uint16_t) a << 8) | (uint16_t) f;
-        case Register::BC: return ((uint16_t) b << 8) | (uint16_t) c;
-        case Register::DE: return ((uint16_t) d << 8) | (uint16_t) e;
-        case Register::HL: return ((uint16_t) h << 8) | (uint16_t) l;
-        case Register::PC: return pc;
-        case Register::SP: return sp;
-        default:           return 0;
-    }
+template <SM83::Register R>
+uint16_t SM83::readReg() const {
+    using r = Register;
+    if      constexpr (R == r::A)  return a;
+    else if constexpr (R == r::F)  return flags();
+    else if constexpr (R == r::B)  return b;
+    else if constexpr (R == r::C)  return c;
+    else if constexpr (R == r::D)  return d;
+    else if constexpr (R == r::E)  return e;
+    else if constexpr (R == r::H)  return h;
+    else if constexpr (R == r::L)  return l;
+    else if constexpr (R == r::AF) return ((uint16_t) a << 8) | (uint16_t) flags();
+    else if constexpr (R == r::BC) return ((uint16_t) b << 8) | (uint16_t) c;
+    else if constexpr (R == r::DE) return ((uint16_t) d << 8) | (uint16_t) e;
+    else if constexpr (R == r::HL) return ((uint16_t) h << 8) | (uint16_t) l;
+    else if constexpr (R == r::PC) return pc;
+    else if constexpr (R == r::SP) return sp;
+    else                           return 0;
 }
 
 /**
  * Writes CPU registers (8- or 16-bit).
  *
- * @param r Register to write to
+ * @tparam R Register to write to
  * @param data Data to write to register
  */
-void SM83::writeReg(Register r, uint16_t data) {
-    switch (r) {
-        case Register::A:  a = data & 0xFF; return;
-        case Register::F:  f = data & 0xFF; return;
-        case Register::B:  b = data & 0xFF; return;
-        case Register::C:  c = data & 0xFF; return;
-        case Register::D:  d = data & 0xFF; return;
-        case Register::E:  e = data & 0xFF; return;
-        case Register::H:  h = data & 0xFF; return;
-        case Register::L:  l = data & 0xFF; return;
-        case Register::AF: a = (data >> 8) & 0xFF; f = data & 0xFF; return;
-        case Register::BC: b = (data >> 8) & 0xFF; c = data & 0xFF; return;
-        case Register::DE: d = (data >> 8) & 0xFF; e = data & 0xFF; return;
-        case Register::HL: h = (data >> 8) & 0xFF; l = data & 0xFF; return;
-        case Register::PC: pc = data; return;
-        case Register::SP: sp = data; return;
-        default:                      return;
-    }
+template <SM83::Register R>
+void SM83::writeReg(uint16_t data) {
+    using r = Register;
+    if      constexpr (R == r::A)  a = data & 0xFF;
+    else if constexpr (R == r::F)  { f = data & 0xFF; lazyOp = LazyOp::None; }
+    else if constexpr (R == r::B)  b = data & 0xFF;
+    else if constexpr (R == r::C)  c = data & 0xFF;
+    else if constexpr (R == r::D)  d = data & 0xFF;
+    else if constexpr (R == r::E)  e = data & 0xFF;
+    else if constexpr (R == r::H)  h = data & 0xFF;
+    else if constexpr (R == r::L)  l = data & 0xFF;
+    else if constexpr (R == r::AF) { a = (data >> 8) & 0xFF; f = data & 0xFF; lazyOp = LazyOp::None; }
+    else if constexpr (R == r::BC) { b = (data >> 8) & 0xFF; c = data & 0xFF; }
+    else if constexpr (R == r::DE) { d = (data >> 8) & 0xFF; e = data & 0xFF; }
+    else if constexpr (R == r::HL) { h = (data >> 8) & 0xFF; l = data & 0xFF; }
+    else if constexpr (R == r::PC) pc = data;
+    else if constexpr (R == r::SP) sp = data;
 }
 
 /**
  * @return True if register is 16-bit, false otherwise.
  */
-bool SM83::is16Bit(SM83::Register r) { return static_cast<uint8_t>(r) >= static_cast<uint8_t>(Register::AF); }
+constexpr bool SM83::is16Bit(SM83::Register r) { return static_cast<uint8_t>(r) >= static_cast<uint8_t>(Register::AF); }
 
 /**
  * Sets/clears a flag (Z, N, H, C).
@@ -255,6 +696,8 @@ bool SM83::is16Bit(SM83::Register r) { return static_cast<uint8_t>(r) >= static_
  * @param v Value to set flag to (0 or 1).
  */
 void SM83::setFlag(FlagSM83 flag, bool v) {
+    if (lazyOp != LazyOp::None)
+        resolveFlags();
     if (v)
         f |= flag;
     else
@@ -266,24 +709,67 @@ void SM83::setFlag(FlagSM83 flag, bool v) {
  * @return Value of flag (0 or 1)
  */
 uint8_t SM83::getFlag(FlagSM83 flag) const {
-    return (f & flag) ? 1 : 0;
+    return (flags() & flag) ? 1 : 0;
+}
+
+/**
+ * @return The value of F, deriving the flags of the pending lazy operation (if any) from its operands and result.
+ */
+uint8_t SM83::flags() const {
+    if (lazyOp == LazyOp::None)
+        return f;
+
+    // For additions and subtractions alike, bit 4 of x ^ y ^ result is the carry/borrow from bit 3 to bit 4.
+    uint8_t zh = ((lazyResult & 0xFF) == 0 ? Z : 0) | ((lazyX ^ lazyY ^ lazyResult) & 0x10 ? H : 0);
+    uint8_t c  = (lazyResult & 0x100) ? C : 0;
+    switch (lazyOp) {
+        case LazyOp::Inc: return (f & 0x1F) | zh;         // C is left as it was
+        case LazyOp::Dec: return (f & 0x1F) | zh | N;
+        case LazyOp::Add: return (f & 0x0F) | zh | c;
+        case LazyOp::Sub: return (f & 0x0F) | zh | N | c;
+        default:          return f;
+    }
+}
+
+/**
+ * Stores the flags of the pending lazy operation (if any) in F.
+ */
+void SM83::resolveFlags() {
+    f = flags();
+    lazyOp = LazyOp::None;
+}
+
+/**
+ * Defers computing the flags of an 8-bit arithmetic operation until they are read (see SM83::flags).
+ *
+ * @param op The kind of operation.
+ * @param x The first operand.
+ * @param y The second operand.
+ * @param result The result, computed in a 16-bit domain so that bit 8 holds the carry/borrow.
+ */
+void SM83::setLazyFlags(LazyOp op, uint8_t x, uint8_t y, uint16_t result) {
+    // INC/DEC keep C, which must be resolved first if it is still pending from an ADD/SUB.
+    if (op < LazyOp::Add && lazyOp >= LazyOp::Add)
+        resolveFlags();
+    lazyOp     = op;
+    lazyX      = x;
+    lazyY      = y;
+    lazyResult = result;
 }
 
 /**
  * Tests a condition.
  *
- * @param cond Condition to test
+ * @tparam Cond Condition to test
  * @return True if condition is true, false otherwise.
  */
-bool SM83::testCond(Condition cond) {
-    switch (cond) {
-        case Condition::X : return true;
-        case Condition::NZ: return !getFlag(Z);
-        case Condition::Z : return getFlag(Z);
-        case Condition::NC: return !getFlag(C);
-        case Condition::C : return getFlag(C);
-        default:            return false;
-    }
+template <SM83::Condition Cond>
+bool SM83::testCond() const {
+    if      constexpr (Cond == Condition::NZ) return !getFlag(Z);
+    else if constexpr (Cond == Condition::Z ) return getFlag(Z);
+    else if constexpr (Cond == Condition::NC) return !getFlag(C);
+    else if constexpr (Cond == Condition::C ) return getFlag(C);
+    else                                      return true;
 }
 
 /**
@@ -307,12 +793,6 @@ bool SM83::carry(uint32_t a, uint32_t b, uint32_t result, uint32_t mask) {
     return ((a & b) | (a & ~result) | (b & ~result)) & mask;
 }
 
-// Checks if a subtraction operation resulted in a borrow.
-// a - b = result => a = b + result
-bool SM83::borrow(uint32_t a, uint32_t b, uint32_t result, uint32_t mask) {
-    return carry(result, b, a, mask);
-}
-
 
 // Addressing modes ====================================================================================================
 // Some notation adapted from Pastraiser (https://www.pastraiser.com/cpu/gameboy/gameboy_opcodes.html):
@@ -335,16 +815,18 @@ void SM83::IMP() {
  * Register addressing mode is used for instructions that have a single register operand.
  * Ex: DEC A, INC HL, ...
  */
+template <uint8_t Op>
 void SM83::R() {
-    fetched = readReg(instruction->dstReg);
+    fetched = readReg<lookup[Op].dstReg>();
 }
 
 /**
  * Register to register addressing mode is used for instructions that have two register operands.
  * Ex: LD A,B, LD HL,SP, ...
  */
+template <uint8_t Op>
 void SM83::R_R() {
-    fetched = readReg(instruction->srcReg);
+    fetched = readReg<lookup[Op].srcReg>();
 }
 
 /**
@@ -352,7 +834,7 @@ void SM83::R_R() {
  * Ex: JR s8 (signed is accounted for in JR's implementation), CB u8, ...
  */
 void SM83::D8() {
-    fetched = read(pc++);
+    fetched = fetchOperand();
 }
 
 /**
@@ -360,17 +842,17 @@ void SM83::D8() {
  * Ex: LD A,u8, LD B,u8, ...
  */
 void SM83::R_D8() {
-    fetched = read(pc++);
+    fetched = fetchOperand();
 }
 
 /**
  * Immediate byte to memory referenced by register.
  * Ex: LD (HL),u8
  */
+template <uint8_t Op>
 void SM83::MR_D8() {
-    dstIsMem = true;
-    memDest   = readReg(instruction->dstReg);
-    fetched   = read(pc++);
+    memDest   = readReg<lookup[Op].dstReg>();
+    fetched   = fetchOperand();
 }
 
 /**
@@ -379,8 +861,8 @@ void SM83::MR_D8() {
  * Ex: JP u16, CALL u16, ...
  */
 void SM83::D16() {
-    fetched = read(pc++);
-    fetched |= (((uint16_t) read(pc++)) << 8);
+    fetched = fetchOperand();
+    fetched |= (((uint16_t) fetchOperand()) << 8);
 }
 
 /**
@@ -388,17 +870,17 @@ void SM83::D16() {
  * Ex: LD HL,d16, LD BC,d16, ...
  */
 void SM83::R_D16() {
-    fetched = read(pc++);
-    fetched |= (((uint16_t) read(pc++)) << 8);
+    fetched = fetchOperand();
+    fetched |= (((uint16_t) fetchOperand()) << 8);
 }
 
 /**
  * Memory referenced by register.
  * Ex: INC (HL), DEC (HL)
  */
+template <uint8_t Op>
 void SM83::MR() {
-    dstIsMem = true;
-    memDest   = readReg(instruction->dstReg);
+    memDest   = readReg<lookup[Op].dstReg>();
     fetched   = read(memDest);
 }
 
@@ -407,11 +889,11 @@ void SM83::MR() {
  * and a memory location referenced by a register.
  * Ex: LD (BC),A, LD (HL),B, ...
  */
+template <uint8_t Op>
 void SM83::MR_R() {
-    fetched   = readReg(instruction->srcReg);
-    dstIsMem = true;
-    memDest   = readReg(instruction->dstReg);
-    if (instruction->dstReg == Register::C) // LD (C),A
+    fetched   = readReg<lookup[Op].srcReg>();
+    memDest   = readReg<lookup[Op].dstReg>();
+    if constexpr (lookup[Op].dstReg == Register::C) // LD (C),A
         memDest |= 0xFF00;
 }
 
@@ -420,9 +902,10 @@ void SM83::MR_R() {
  * and a memory location referenced by a register.
  * Ex: LD A,(HL), LD A,(BC), ...
  */
+template <uint8_t Op>
 void SM83::R_MR() {
-    temp16 = readReg(instruction->srcReg);
-    if (instruction->srcReg == Register::C) // LD A,(C)
+    temp16 = readReg<lookup[Op].srcReg>();
+    if constexpr (lookup[Op].srcReg == Register::C) // LD A,(C)
         temp16 |= 0xFF00;
     fetched = read(temp16);
 }
@@ -432,20 +915,20 @@ void SM83::R_MR() {
  * Ex: LD A,(HL+)
  */
 void SM83::R_HLI() {
-    temp16  = readReg(Register::HL);
+    temp16  = readReg<Register::HL>();
     fetched = read(temp16);
-    writeReg(Register::HL, temp16 + 1);
+    writeReg<Register::HL>(temp16 + 1);
 }
 
 /**
  * Register to memory location referenced by HL; increment HL after.
  * Ex: LD (HL+),A
  */
+template <uint8_t Op>
 void SM83::HLI_R() {
-    fetched   = readReg(instruction->srcReg);
-    dstIsMem = true;
-    memDest   = readReg(Register::HL);
-    writeReg(Register::HL, readReg(Register::HL) + 1);
+    fetched   = readReg<lookup[Op].srcReg>();
+    memDest   = readReg<Register::HL>();
+    writeReg<Register::HL>(readReg<Register::HL>() + 1);
 }
 
 /**
@@ -453,20 +936,20 @@ void SM83::HLI_R() {
  * Ex: LD A,(HL-)
  */
 void SM83::R_HLD() {
-    temp16  = readReg(Register::HL);
+    temp16  = readReg<Register::HL>();
     fetched = read(temp16);
-    writeReg(Register::HL, temp16 - 1);
+    writeReg<Register::HL>(temp16 - 1);
 }
 
 /**
  * Register to memory location referenced by HL; decrement HL after.
  * Ex: LD (HL-),A
  */
+template <uint8_t Op>
 void SM83::HLD_R() {
-    fetched   = readReg(instruction->srcReg);
-    dstIsMem = true;
-    memDest   = readReg(Register::HL);
-    writeReg(Register::HL, readReg(Register::HL) - 1);
+    fetched   = readReg<lookup[Op].srcReg>();
+    memDest   = readReg<Register::HL>();
+    writeReg<Register::HL>(readReg<Register::HL>() - 1);
 }
 
 /**
@@ -474,7 +957,7 @@ void SM83::HLD_R() {
  * Ex: LD HL,SP+s8
  */
 void SM83::HL_SPR() {
-    fetched = read(pc++);
+    fetched = fetchOperand();
 }
 
 
@@ -483,7 +966,7 @@ void SM83::HL_SPR() {
  * Ex: LDH A,(a8), which is the same as LD A,($FF00+a8)
  */
 void SM83::R_A8() {
-    temp16 = 0xFF00 | ((uint16_t) read(pc++));
+    temp16 = 0xFF00 | ((uint16_t) fetchOperand());
     fetched = read(temp16);
 }
 
@@ -491,10 +974,10 @@ void SM83::R_A8() {
  * Register to memory referenced by immediate unsigned byte (0xFF00 + a8).
  * Ex: LDH (a8),A, which is the same as LD ($FF00+a8),A
  */
+template <uint8_t Op>
 void SM83::A8_R() {
-    dstIsMem = true;
-    memDest   = 0xFF00 | ((uint16_t) read(pc++));
-    fetched   = readReg(instruction->srcReg);
+    memDest   = 0xFF00 | ((uint16_t) fetchOperand());
+    fetched   = readReg<lookup[Op].srcReg>();
 }
 
 /**
@@ -502,8 +985,8 @@ void SM83::A8_R() {
  * Ex: LD A,(u16)
  */
 void SM83::R_A16() {
-    temp16 = read(pc++);
-    temp16 |= ((uint16_t) read(pc++) << 8);
+    temp16 = fetchOperand();
+    temp16 |= ((uint16_t) fetchOperand() << 8);
     fetched = read(temp16);
 }
 
@@ -511,12 +994,21 @@ void SM83::R_A16() {
  * Register to memory referenced by immediate word.
  * Ex: LD (u16),A, LD (u16),SP
  */
+template <uint8_t Op>
 void SM83::A16_R() {
-    temp16 = read(pc++);
-    temp16 |= (((uint16_t) read(pc++)) << 8);
-    dstIsMem = true;
+    temp16 = fetchOperand();
+    temp16 |= (((uint16_t) fetchOperand()) << 8);
     memDest   = temp16;
-    fetched   = readReg(instruction->srcReg);
+    fetched   = readReg<lookup[Op].srcReg>();
+}
+
+/**
+ * @return True if the addressing mode makes the instruction write its result to memory (at memDest).
+ */
+constexpr bool SM83::writesMemory(AddrMode mode) {
+    using m = AddrMode;
+    return mode == m::MR_D8 || mode == m::MR || mode == m::MR_R || mode == m::HLI_R || mode == m::HLD_R ||
+           mode == m::A8_R  || mode == m::A16_R;
 }
 // =====================================================================================================================
 
@@ -536,11 +1028,7 @@ void SM83::ADC() {
     // Since ADC operates only on 8-bit values, we perform the addition
     // in a 16-bit domain to capture the carry bit (bit 8) in the result.
     temp16 = a + fetched + getFlag(C);
-    setFlag(Z, (temp16 & 0x00FF) == 0);
-    setFlag(N, false);
-    // The half-carry flag is set if there is a carry from bit 3 to bit 4.
-    setFlag(H, (a & 0xF) + (fetched & 0xF) + getFlag(C) > 0xF);
-    setFlag(C, temp16 > 0xFF);
+    setLazyFlags(LazyOp::Add, a, fetched, temp16);
     a = temp16 & 0xFF;
 }
 
@@ -555,33 +1043,32 @@ void SM83::ADC() {
  *
  * For setting carry/half-carry flags for 16-bit ADD, see: https://stackoverflow.com/a/57981912
  */
+template <uint8_t Op>
 void SM83::ADD() {
-    dst = instruction->dstReg;
+    constexpr Register dst = lookup[Op].dstReg;
     setFlag(N, false);
-    if (is16Bit(dst)) {
-        temp16 = readReg(dst);
-        if (dst == Register::SP) { // ADD SP,s8 (see opcode 0xE8)
+    if constexpr (is16Bit(dst)) {
+        temp16 = readReg<dst>();
+        if constexpr (dst == Register::SP) { // ADD SP,s8 (see opcode 0xE8)
             temp32 = temp16 + (int8_t) fetched; // signed (int8_t)
             setFlag(Z, false);
             setFlag(H, carry(temp16, (int8_t) fetched, temp32, 0x08)); // mask is bit 3
             setFlag(C, carry(temp16, (int8_t) fetched, temp32, 0x80)); // mask is bit 7
-            writeReg(dst, temp32);
+            writeReg<dst>(temp32);
             emulateCycles(2); // gbops claims two internals (cycles verified by instr_timing): write SP:low, high ???
         } else { // ADD HL,BC ...
             // Adding 16-bit values in a 32-bit domain to capture the carry bit (bit 16) in the result.
             temp32 = (uint32_t) temp16 + (uint32_t) fetched;
             setFlag(H, carry(temp16, fetched, temp32, 0x800));   // from bit 11
             setFlag(C, carry(temp16, fetched, temp32, 0x8000));  // from bit 15
-            writeReg(dst, temp32);
+            writeReg<dst>(temp32);
             emulateCycles(1);
         }
     } else { // ADD B ...
-        temp8 = readReg(dst);
+        temp8 = readReg<dst>();
         temp16 = (uint16_t) temp8 + fetched;
-        setFlag(Z, (temp16 & 0xFF) == 0);
-        setFlag(H, carry(temp8, fetched, temp16, 0x08));
-        setFlag(C, carry(temp8, fetched, temp16, 0x80));
-        writeReg(dst, temp16);
+        setLazyFlags(LazyOp::Add, temp8, fetched, temp16);
+        writeReg<dst>(temp16);
     }
 }
 
@@ -609,8 +1096,9 @@ void SM83::AND() {
  *                                      write PC:upper->(--SP),
  *                                      write PC:lower->(--SP)
  */
+template <uint8_t Op>
 void SM83::CALL() {
-    if (testCond(instruction->cond)) {
+    if (testCond<lookup[Op].cond>()) {
         emulateCycles(1);       // internal branch decision ???
         write(--sp, pc >> 8);
         write(--sp, pc & 0xFF);
@@ -672,11 +1160,7 @@ void SM83::DAA() {
  * Timing (immediate) (8t/2m): fetch, read u8        Ex: CP A,u8
  */
 void SM83::CP() {
-    temp8 = a - (fetched & 0xFF);
-    setFlag(Z, temp8 == 0);
-    setFlag(N, true);
-    setFlag(H, borrow(a, fetched & 0xFF, temp8, 0x08));
-    setFlag(C, borrow(a, fetched & 0xFF, temp8, 0x80));
+    setLazyFlags(LazyOp::Sub, a, fetched, a - (fetched & 0xFF));
 }
 
 /**
@@ -687,25 +1171,22 @@ void SM83::CP() {
  * Timing (memory (HL))     (12t/3m): fetch, read (HL), write (HL)                  Ex: DEC (HL)
  * Timing (16-bit register) (8t/2m):  fetch (write rr:low ???), write rr:high ???   Ex: DEC BC, DEC SP, ...
  */
+template <uint8_t Op>
 void SM83::DEC() {
-    dst = instruction->dstReg;
-    if (is16Bit(dst)) {
-        if (dstIsMem) { // DEC (HL)
+    constexpr Register dst = lookup[Op].dstReg;
+    if constexpr (is16Bit(dst)) {
+        if constexpr (writesMemory(lookup[Op].addrmode)) { // DEC (HL)
             temp8 = fetched - 1;
-            setFlag(Z, temp8 == 0);
-            setFlag(N, true);
-            setFlag(H, borrow(fetched, 1, temp8, 0x08));
+            setLazyFlags(LazyOp::Dec, fetched, 1, temp8);
             write(memDest, temp8);
         } else { // DEC BC ...
-            writeReg(dst, fetched - 1);
+            writeReg<dst>(fetched - 1);
             emulateCycles(1);
         }
     } else { // DEC B ...
         temp8 = fetched - 1;
-        setFlag(Z, temp8 == 0);
-        setFlag(N, true);
-        setFlag(H, borrow(fetched, 1, temp8, 0x08));
-        writeReg(dst, temp8);
+        setLazyFlags(LazyOp::Dec, fetched, 1, temp8);
+        writeReg<dst>(temp8);
     }
 }
 
@@ -746,25 +1227,22 @@ void SM83::HALT() {
  * Timing (memory (HL))     (12t/3m): fetch, read (HL), write (HL)        Ex: INC (HL)
  * Timing (16-bit register) (8t/2m):  fetch, write rr ???                 Ex: INC BC, INC SP, ...
  */
+template <uint8_t Op>
 void SM83::INC() {
-    dst = instruction->dstReg;
-    if (is16Bit(dst)) {
-        if (dstIsMem) { // INC (HL)
+    constexpr Register dst = lookup[Op].dstReg;
+    if constexpr (is16Bit(dst)) {
+        if constexpr (writesMemory(lookup[Op].addrmode)) { // INC (HL)
             temp8 = fetched + 1;
-            setFlag(Z, temp8 == 0);
-            setFlag(N, false);
-            setFlag(H, carry(fetched, 1, temp8, 0x08));
+            setLazyFlags(LazyOp::Inc, fetched, 1, temp8);
             write(memDest, temp8);
         } else { // INC BC ...
-            writeReg(dst, fetched + 1);
+            writeReg<dst>(fetched + 1);
             emulateCycles(1);
         }
     } else { // INC B ...
         temp8 = fetched + 1;
-        setFlag(Z, temp8 == 0);
-        setFlag(N, false);
-        setFlag(H, carry(fetched, 1, temp8, 0x08));
-        writeReg(dst, temp8);
+        setLazyFlags(LazyOp::Inc, fetched, 1, temp8);
+        writeReg<dst>(temp8);
     }
 }
 
@@ -782,10 +1260,11 @@ void SM83::INC() {
  * For JP u16 (unconditional)
  * Timing (16t/4m): fetch, read u16:lower, read u16:upper, internal (branch decision?) (but there is no condition ???)
  */
+template <uint8_t Op>
 void SM83::JP() {
-    if (testCond(instruction->cond)) { // JP Z, JP NC, ... (JP defaults to true)
+    if (testCond<lookup[Op].cond>()) { // JP Z, JP NC, ... (JP defaults to true)
         pc = fetched;
-        if (instruction->addrmode != &SM83::R) // JP HL (see docstring)
+        if constexpr (lookup[Op].addrmode != AddrMode::R) // JP HL (see docstring)
             emulateCycles(1); // internal branch decision ???
     }
 }
@@ -801,8 +1280,9 @@ void SM83::JP() {
  * For JR s8 (unconditional)
  * Timing (12t/3m): fetch, read s8, internal (modify PC)
  */
+template <uint8_t Op>
 void SM83::JR() {
-    if (testCond(instruction->cond)) { // JR Z, JR NC, ... (JR defaults to true)
+    if (testCond<lookup[Op].cond>()) { // JR Z, JR NC, ... (JR defaults to true)
         pc += static_cast<int8_t>(fetched & 0xFF); // s8 is signed (int8_t)
         emulateCycles(1);
     }
@@ -824,17 +1304,18 @@ void SM83::JR() {
  *                                         read u16:lower, read u16:upper,
  *                                         write SP:lower->(u16), write SP:upper->(u16+1)
  */
+template <uint8_t Op>
 void SM83::LD() {
-    dst = instruction->dstReg;
-    src = instruction->srcReg;
-    if (dstIsMem) {
-        if (is16Bit(src)) { // LD (u16),SP (see opcode 0x08)
+    constexpr Register dst = lookup[Op].dstReg;
+    constexpr Register src = lookup[Op].srcReg;
+    if constexpr (writesMemory(lookup[Op].addrmode)) {
+        if constexpr (is16Bit(src)) { // LD (u16),SP (see opcode 0x08)
             write(memDest + 0, fetched & 0xFF);
             write(memDest + 1, fetched >> 8);
         } else { // LD (C),A, LD (HL),u8 ...
             write(memDest, fetched);
         }
-    } else if (instruction->addrmode == &SM83::HL_SPR) { // LD HL,SP+s8 (see opcode 0xF8)
+    } else if constexpr (lookup[Op].addrmode == AddrMode::HL_SPR) { // LD HL,SP+s8 (see opcode 0xF8)
         temp32 = (uint32_t) sp + (int8_t) fetched; // signed (int8_t)
         setFlag(Z, false);
         setFlag(N, false);
@@ -846,11 +1327,11 @@ void SM83::LD() {
             setFlag(H, (temp32 & 0x0F) <= (sp & 0x0F));
             setFlag(C, (temp32 & 0xFF) <= (sp & 0xFF));
         }
-        writeReg(dst, (uint16_t) temp32);
+        writeReg<dst>((uint16_t) temp32);
         emulateCycles(1); // internal delay
     } else { // LD B,C, ..., LD DE,u16, ..., LD A,(DE), ..., LD E,u8, ...
-        writeReg(dst, fetched);
-        if (dst == Register::SP && src == Register::HL) // LD SP,HL (see opcode 0xF9)
+        writeReg<dst>(fetched);
+        if constexpr (dst == Register::SP && src == Register::HL) // LD SP,HL (see opcode 0xF9)
             emulateCycles(1); // internal delay
     }
 }
@@ -863,11 +1344,12 @@ void SM83::LD() {
  *
  * @note see R_A8 and A8_R addressing modes for more details.
  */
+template <uint8_t Op>
 void SM83::LDH() {
-    if (dstIsMem)
+    if constexpr (writesMemory(lookup[Op].addrmode))
         write(memDest, fetched);
     else
-        writeReg(instruction->dstReg, fetched);
+        writeReg<lookup[Op].dstReg>(fetched);
 }
 
 /**
@@ -885,14 +1367,15 @@ void SM83::NOP() {}
  *
  * @note SP is incremented when popping.
  */
+template <uint8_t Op>
 void SM83::POP() {
+    constexpr Register dst = lookup[Op].dstReg;
     temp16 = read(sp++);                      // lo
     temp16 |= (((uint16_t) read(sp++)) << 8); // hi
-    dst = instruction->dstReg;
-    if (dst == Register::AF)
+    if constexpr (dst == Register::AF)
         // Flag bits 0,1,2,3 are always zero
         temp16 &= 0xFFF0;
-    writeReg(dst, temp16);
+    writeReg<dst>(temp16);
 }
 
 /**
@@ -919,14 +1402,15 @@ void SM83::PUSH() {
  *                                  read (SP++)->upper
  *                                  internal (set PC?)
  *
- * For RET (where condition is always true, i.e., instruction->cond == Condition::X),
+ * For RET (where condition is always true, i.e., lookup[Op].cond == Condition::X),
  * Timing with branch (16t/4m): fetch, read (SP++)->lower, read (SP++)->upper, internal (set PC?)
  */
+template <uint8_t Op>
 void SM83::RET() {
-    if (instruction->cond != Condition::X)
+    if constexpr (lookup[Op].cond != Condition::X)
         emulateCycles(1); // conditional returns all require internal branch decision check
 
-    if (testCond(instruction->cond)) {
+    if (testCond<lookup[Op].cond>()) {
         temp16 = read(sp++);
         temp16 |= (((uint16_t) read(sp++)) << 8);
         pc = temp16;
@@ -939,8 +1423,9 @@ void SM83::RET() {
  * Flags: ----
  * Timing is same as RET without internal branch decision check (16t/4m).
  */
+template <uint8_t Op>
 void SM83::RETI() {
-    RET();
+    RET<Op>();
     intHandler->IME = true;
 }
 
@@ -1005,11 +1490,12 @@ void SM83::RRCA() {
  * Flags: ----
  * Timing (16t/4m): fetch, internal delay, write PC:upper->(--SP), write PC:lower->(--SP)
  */
+template <uint8_t Op>
 void SM83::RST() {
     emulateCycles(1);       // internal delay
     write(--sp, pc >> 8);   // hi
     write(--sp, pc & 0xFF); // lo
-    pc = instruction->param;
+    pc = lookup[Op].param;
 }
 
 /**
@@ -1020,12 +1506,9 @@ void SM83::RST() {
  * Timing (immediate) (8t/2m): fetch, read u8        Ex: SBC A,u8
  */
 void SM83::SBC() {
-    temp8 = a - ((fetched & 0xFF) + getFlag(C));
-    setFlag(Z, temp8 == 0);
-    setFlag(N, true);
-    setFlag(H, (a & 0x0F) < (fetched & 0x0F) + getFlag(C));
-    setFlag(C, a < (fetched & 0xFF) + getFlag(C));
-    a = temp8;
+    temp16 = a - (fetched & 0xFF) - getFlag(C);
+    setLazyFlags(LazyOp::Sub, a, fetched, temp16);
+    a = temp16 & 0xFF;
 }
 
 /**
@@ -1057,12 +1540,9 @@ void SM83::STOP() {
  * Timing (immediate) (8t/2m): fetch, read u8        Ex: SUB A,u8
  */
 void SM83::SUB() {
-    temp8 = a - (fetched & 0xFF);
-    setFlag(Z, temp8 == 0);
-    setFlag(N, true);
-    setFlag(H, borrow(a, fetched & 0xFF, temp8, 0x08));
-    setFlag(C, borrow(a, fetched & 0xFF, temp8, 0x80));
-    a = temp8;
+    temp16 = a - (fetched & 0xFF);
+    setLazyFlags(LazyOp::Sub, a, fetched, temp16);
+    a = temp16 & 0xFF;
 }
 
 /**
@@ -1105,13 +1585,20 @@ void SM83::XXX() {
 /* CB-Prefixed Instructions */
 
 /**
- * Handles CB-prefixed instructions.
+ * Handles CB-prefixed instructions by dispatching the immediate byte fetched after CB to its handler.
+ */
+void SM83::CB() {
+    cbHandlers[fetched & 0xFF](this);
+}
+
+/**
+ * Executes one specific CB-prefixed instruction. The decoding below happens at compile time.
  *
  * CB-prefixed instructions are encoded like so:
  * Bits in opcode (MSB -> LSB):     xx yyy zzz
  * A CB-prefixed instruction (the immediate byte that is fetched after CB is called) is encoded like so:
  *     x = 0 -> rot[y]r[z] : Roll/shift register or memory location (HL), where the lowest three bits of the
- *                           opcode (zzz) map to the registers in the vector below. rot corresponds to cbLookup.
+ *                           opcode (zzz) map to the registers in SM83::cbRegister.
  *     x = 1 -> BIT y, r[z]: Test bit y of registers[z]
  *     x = 2 -> RES y, r[z]: Reset bit y of registers[z]
  *     x = 3 -> SET y, r[z]: Set bit y of registers[z]
@@ -1119,44 +1606,75 @@ void SM83::XXX() {
  * Base Timing (8t/1m): fetch instruction, read u8 (immediate byte after CB to be decoded)
  * Reading from (HL) adds 4t/1m to the timing. Writing back to (HL) adds another 4t/1m to the timing.
  */
-void SM83::CB() {
-    using r = SM83::Register;
-    // Order is important here for decoding CB-prefixed opcodes. See table "r" in the link below.
-    // https://gb-archive.github.io/salvage/decoding_gbz80_opcodes/Decoding%20Gamboy%20Z80%20Opcodes.html
-    //                                               0     1     2     3     4     5     6      7
-    static constexpr std::array<r, 8> registers = { r::B, r::C, r::D, r::E, r::H, r::L, r::HL, r::A };
-
-    // `fetched` holds the value of the next immediate byte to be decoded for a CB-prefixed instruction
-    xx  = (fetched >> 6) & 0b11;  // Operation to perform
-    yyy = (fetched >> 3) & 0b111; // Bit for BIT/RES/SET, or index for cbLookup
-    zzz = fetched & 0b111;        // Index for register lookup
-
-    dst = registers[zzz];
-    if (dst == Register::HL) { // BIT y,(HL), RES y,(HL), SET y,(HL) ...
-        dstIsMem = true;
-        memDest   = readReg(dst);
-        fetched   = read(readReg(dst));
+template <uint8_t CbOp>
+void SM83::cbHandler(SM83* cpu) {
+    constexpr uint8_t  xx  = (CbOp >> 6) & 0b11;  // Operation to perform
+    constexpr uint8_t  yyy = (CbOp >> 3) & 0b111; // Bit for BIT/RES/SET, or index of the rotate/shift operation
+    constexpr Register r   = cbRegister(CbOp);
+
+    if constexpr (r == Register::HL) { // BIT y,(HL), RES y,(HL), SET y,(HL) ...
+        cpu->memDest = cpu->readReg<Register::HL>();
+        cpu->fetched = cpu->read(cpu->memDest);
     } else {
-        fetched = readReg(dst);
+        cpu->fetched = cpu->readReg<r>();
     }
 
-    switch (xx) {
-        case 0: (this->*cbLookup[yyy].operate)(); return;
-        case 1: BIT();                            return;
-        case 2: RES();                            return;
-        case 3: SET();                            return;
-        default:                                  return;
+    if constexpr (xx == 0) {
+        // Order is important here. See table "rot" in the link below.
+        // https://gb-archive.github.io/salvage/decoding_gbz80_opcodes/Decoding%20Gamboy%20Z80%20Opcodes.html
+        if constexpr      (yyy == 0) cpu->RLC<CbOp>();
+        else if constexpr (yyy == 1) cpu->RRC<CbOp>();
+        else if constexpr (yyy == 2) cpu->RL<CbOp>();
+        else if constexpr (yyy == 3) cpu->RR<CbOp>();
+        else if constexpr (yyy == 4) cpu->SLA<CbOp>();
+        else if constexpr (yyy == 5) cpu->SRA<CbOp>();
+        else if constexpr (yyy == 6) cpu->SWAP<CbOp>();
+        else                         cpu->SRL<CbOp>();
+    } else if constexpr (xx == 1) {
+        cpu->BIT<CbOp>();
+    } else if constexpr (xx == 2) {
+        cpu->RES<CbOp>();
+    } else {
+        cpu->SET<CbOp>();
     }
 }
 
+/**
+ * @return The register operated on by a CB-prefixed opcode, or HL if it operates on (HL).
+ */
+constexpr SM83::Register SM83::cbRegister(uint8_t cbOp) {
+    using r = SM83::Register;
+    // Order is important here for decoding CB-prefixed opcodes. See table "r" in the link above.
+    //                                      0     1     2     3     4     5     6      7
+    constexpr std::array<r, 8> registers = { r::B, r::C, r::D, r::E, r::H, r::L, r::HL, r::A };
+    return registers[cbOp & 0b111];
+}
+
+/**
+ * Writes the result of a CB-prefixed opcode back to its register or (HL).
+ */
+template <uint8_t CbOp>
+void SM83::writeBack(uint8_t data) {
+    if constexpr (cbRegister(CbOp) == Register::HL)
+        write(memDest, data);
+    else
+        writeReg<cbRegister(CbOp)>(data);
+}
+
+template <size_t... CbOp>
+constexpr std::array<SM83::Handler, sizeof...(CbOp)> SM83::makeCBHandlers(std::index_sequence<CbOp...>) {
+    return { &SM83::cbHandler<CbOp>... };
+}
+
 /**
  * Test bit yyy of registers[zzz] or (HL).
  * Flags: Z 0 1 -
  * Timing (HL)       (12t/3m): fetch, fetch, read (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::BIT() {
-    setFlag(Z, !(fetched & (1 << yyy)));
+    setFlag(Z, !(fetched & (1 << ((CbOp >> 3) & 7))));
     setFlag(N, false);
     setFlag(H, true);
 }
@@ -1167,12 +1685,9 @@ void SM83::BIT() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::RES() {
-    temp8 = fetched & ~(1 << yyy);
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(fetched & ~(1 << ((CbOp >> 3) & 7)));
 }
 
 /**
@@ -1181,12 +1696,9 @@ void SM83::RES() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::SET() {
-    temp8 = fetched | (1 << yyy);
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(fetched | (1 << ((CbOp >> 3) & 7)));
 }
 
 /* Rotate/shift register or memory location CB-prefixed instructions */
@@ -1197,12 +1709,10 @@ void SM83::SET() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::RLC() {
     temp8 = (fetched << 1) | (fetched >> 7);
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(temp8);
 
     setFlag(Z, temp8 == 0);
     setFlag(N, false);
@@ -1216,12 +1726,10 @@ void SM83::RLC() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::RRC() {
     temp8 = (fetched << 7) | (fetched >> 1);
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(temp8);
 
     setFlag(Z, temp8 == 0);
     setFlag(N, false);
@@ -1235,12 +1743,10 @@ void SM83::RRC() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::RL() {
     temp8 = (fetched << 1) | getFlag(C);
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(temp8);
 
     setFlag(Z, temp8 == 0);
     setFlag(N, false);
@@ -1254,12 +1760,10 @@ void SM83::RL() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::RR() {
     temp8 = (getFlag(C) << 7) | (fetched >> 1);
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(temp8);
 
     setFlag(Z, temp8 == 0);
     setFlag(N, false);
@@ -1273,12 +1777,10 @@ void SM83::RR() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::SLA() {
     temp8 = fetched << 1;
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(temp8);
 
     setFlag(Z, temp8 == 0);
     setFlag(N, false);
@@ -1292,12 +1794,10 @@ void SM83::SLA() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::SRA() {
     temp8 = ((int8_t) fetched) >> 1; // preserve the sign bit (int8_t)
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(temp8);
 
     setFlag(Z, temp8 == 0);
     setFlag(N, false);
@@ -1311,12 +1811,10 @@ void SM83::SRA() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::SWAP() {
     temp8 = (fetched << 4) | (fetched >> 4);
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(temp8);
 
     setFlag(Z, temp8 == 0);
     setFlag(N, false);
@@ -1330,18 +1828,19 @@ void SM83::SWAP() {
  * Timing (HL)       (16t/4m): fetch, fetch, read (HL), write (HL)
  * Timing (register) (8t/2m):  fetch, fetch
  */
+template <uint8_t CbOp>
 void SM83::SRL() {
     temp8 = fetched >> 1;
-    if (dstIsMem)
-        write(memDest, temp8);
-    else
-        writeReg(dst, temp8);
+    writeBack<CbOp>(temp8);
 
     setFlag(Z, temp8 == 0);
     setFlag(N, false);
     setFlag(H, false);
     setFlag(C, fetched & 1);
 }
+
+const std::array<SM83::Handler, 256> SM83::handlers   = SM83::makeHandlers(std::make_index_sequence<256>());
+const std::array<SM83::Handler, 256> SM83::cbHandlers = SM83::makeCBHandlers(std::make_index_sequence<256>());
 // =====================================================================================================================
 
 #if LOGGING // Set true in SM83.h to enable logging
@@ -1385,7 +1884,8 @@ std::string SM83::conditionToString(SM83::Condition cc) {
  */
 void SM83::disassemble() {
     printf("%-9llu", logTicks);
-    std::string sInst = instruction->name + " ";
+    const Instruction* instruction = &lookup[opcode];
+    std::string sInst = std::string(instruction->name) + " ";
 
     // For CALL C, JR NZ, ...
     if (instruction->cond != Condition::X)
@@ -1400,49 +1900,49 @@ void SM83::disassemble() {
         return s;
     };
 
-    using s = SM83;
-    auto addrMode = instruction->addrmode;
-    dst = instruction->dstReg;
-    src = instruction->srcReg;
-    if (addrMode == &s::IMP)
+    using m = AddrMode;
+    AddrMode addrMode = instruction->addrmode;
+    Register dst = instruction->dstReg;
+    Register src = instruction->srcReg;
+    if (addrMode == m::IMP)
         sInst += "";
-    else if (addrMode == &s::R_D16)
+    else if (addrMode == m::R_D16)
         sInst += registerToString(dst) + ",$" + hex(fetched, 4);
-    else if (addrMode == &s::R_A16)
+    else if (addrMode == m::R_A16)
         sInst += registerToString(dst) + ",$" + hex(memDest, 4);
-    else if (addrMode == &s::R)
+    else if (addrMode == m::R)
         sInst += registerToString(dst);
-    else if (addrMode == &s::R_R)
+    else if (addrMode == m::R_R)
         sInst += registerToString(dst) + "," + registerToString(src);
-    else if (addrMode == &s::MR_R)
+    else if (addrMode == m::MR_R)
         sInst += "(" + registerToString(dst) + ")," + registerToString(src);
-    else if (addrMode == &s::MR)
+    else if (addrMode == m::MR)
         sInst += "(" + registerToString(dst) + ")";
-    else if (addrMode == &s::R_MR)
+    else if (addrMode == m::R_MR)
         sInst += registerToString(dst) + ",(" + registerToString(src) + ")";
-    else if (addrMode == &s::R_D8)
+    else if (addrMode == m::R_D8)
         sInst += registerToString(dst) + ",$" + hex(fetched & 0xFF, 2);
-    else if (addrMode == &s::R_A8)
+    else if (addrMode == m::R_A8)
         sInst += registerToString(dst) + ",($" + hex(memDest, 4) + ")";
-    else if (addrMode == &s::R_HLI)
+    else if (addrMode == m::R_HLI)
         sInst += registerToString(dst) + ",(" + registerToString(src) + "+)";
-    else if (addrMode == &s::R_HLD)
+    else if (addrMode == m::R_HLD)
         sInst += registerToString(dst) + ",(" + registerToString(src) + "-)";
-    else if (addrMode == &s::HLI_R)
+    else if (addrMode == m::HLI_R)
         sInst += "(" + registerToString(dst) + "+)," + registerToString(src);
-    else if (addrMode == &s::HLD_R)
+    else if (addrMode == m::HLD_R)
         sInst += "(" + registerToString(dst) + "-)," + registerToString(src);
-    else if (addrMode == &s::A8_R)
+    else if (addrMode == m::A8_R)
         sInst += "($" + hex(memDest, 4) + ")," + registerToString(src);
-    else if (addrMode == &s::HL_SPR)
+    else if (addrMode == m::HL_SPR)
         sInst += "(" + registerToString(dst) + "),SP+" + hex(fetched & 0xFF, 2);
-    else if (addrMode == &s::D8)
+    else if (addrMode == m::D8)
         sInst += "$" + hex(fetched & 0xFF, 2);
-    else if (addrMode == &s::D16) {
+    else if (addrMode == m::D16) {
         sInst += "$" + hex(fetched, 4);
-    } else if (addrMode == &s::MR_D8)
+    } else if (addrMode == m::MR_D8)
         sInst += "(" + registerToString(dst) + "),$" + hex(fetched & 0xFF, 2);
-    else if (addrMode == &s::A16_R)
+    else if (addrMode == m::A16_R)
         sInst += "($" + hex(memDest, 4) + ")," + registerToString(src);
     else
         std::cerr << "INVALID ADDRESSING MODE.\n";
@@ -1462,11 +1962,6 @@ void SM83::disassemble() {
        getFlag(C) ? 'C' : '-'
     );
 
-    if (!instruction) {
-        printf("UNKNOWN INSTRUCTION. %02X\n", opcode);
-        exit(-7);
-    }
-
     // All Blaggg's tests output to the serial port:
     // FF02 — SC: Serial transfer control
     // See: https://gbdev.io/pandocs/Serial_Data_Transfer_(Link_Cable).html#ff02--sc-serial-transfer-control
@@ -1475,7 +1970,7 @@ void SM83::disassemble() {
 //        bus->write(0xFF02, 0);
 //    }
     printf("                                               	"
-           "DIV ($FF04): %04X,  TIMA ($FF05): %02X,   TMA ($FF06): %02X,   TAC ($FF07): %02X\n", timer->sysClock, timer->tima, timer->tma, timer->tac);
+           "DIV ($FF04): %04X,  TIMA ($FF05): %02X,   TMA ($FF06): %02X,   TAC ($FF07): %02X\n", timer->systemClock(), timer->tima, timer->tma, timer->tac);
 
 //    if (!debugMessage.empty())
 //        printf("DEBUG MESSAGE: %s\n\n", debugMessage.c_str());
@@ -4,6 +4,10 @@
 #include "InterruptHandler.hpp"
 #include "Timer.hpp"
 #include "Bus.hpp"
+#include "BlockCache.hpp"
+#include "JIT.hpp"
+
+#include <utility>
 
 #define LOGGING false // Set to true to enable logging (will drastically slow down emulation)
 
@@ -14,13 +18,20 @@ class SM83 {
     friend class GB;
 
 public:
-    SM83(Bus* b, InterruptHandler* ih, Timer* t, GB* gb);
+    SM83(Bus* b, InterruptHandler* ih, Timer* t, GB* gb, BlockCache* bc, JIT* j);
     ~SM83();
 
 public:
     bool step();  // Emulates the fetch-decode-execute cycle of the CPU
     void init(); // Resets the CPU to a known state
 
+    void enableJIT(bool enable);                   // Selects the JIT or the interpreter (see JIT.hpp)
+    bool isJITEnabled() const { return useJIT; }
+
+    void     enableIdleSkip(bool enable) { useIdleSkip = enable; } // Skips polling loops (see SM83::skipIdleLoop)
+    bool     isIdleSkipEnabled() const { return useIdleSkip; }
+    uint64_t idleCyclesSkipped() const { return idleCycles; }       // Total M-cycles skipped in polling loops
+
 private:
     // CPU core registers. The Accumulator (A) holds the result of arithmetic and logical operations and data.
     // The general purpose registers (B, C, D, E, H, L) are used as auxiliary registers to the Accumulator,
@@ -28,7 +39,7 @@ private:
     // to address the stack, and the Program Counter (PC) is used to point to the next instruction to be
     // executed or the information (the immediate byte or word) required to execute the current instruction.
     uint8_t  a  = 0x00;   // Accumulator register
-    uint8_t  f  = 0x00;   // Flag/status register
+    uint8_t  f  = 0x00;   // Flag/status register (except for the flags of a pending lazy operation, see SM83::flags)
     uint8_t  b  = 0x00;   // B register
     uint8_t  c  = 0x00;   // C register
     uint8_t  d  = 0x00;   // D register
@@ -48,6 +59,23 @@ private:
         Z = (1 << 7), // Zero
     };
 
+    // Lazy flags. The 8-bit arithmetic instructions (ADD, ADC, SUB, SBC, CP, INC, DEC) don't compute their flags
+    // right away. Instead, they record their operands and result, and the flags are only derived from these when
+    // F is actually read (conditional branches, ADC/SBC, DAA, PUSH AF...), which most of the time it isn't before
+    // the next arithmetic instruction overwrites them anyway.
+    enum class LazyOp : uint8_t {
+        None, // F is up to date
+        Inc,  // INC r/(HL): Z 0 H - (must precede Add and Sub, see SM83::setLazyFlags)
+        Dec,  // DEC r/(HL): Z 1 H -
+        Add,  // ADD/ADC:    Z 0 H C
+        Sub,  // SUB/SBC/CP: Z 1 H C
+    };
+
+    LazyOp   lazyOp     = LazyOp::None; // Operation whose flags are pending
+    uint8_t  lazyX      = 0x00;         // First operand of the pending operation
+    uint8_t  lazyY      = 0x00;         // Second operand of the pending operation
+    uint16_t lazyResult = 0x0000;       // Result of the pending operation, with the carry/borrow in bit 8
+
 private:
     uint8_t read(uint16_t addr);                 // Reads a byte from bus
     void    write(uint16_t addr, uint8_t data);  // Writes a byte to bus
@@ -56,8 +84,7 @@ private:
     // Assistive variables to facilitate emulation.
     uint8_t  opcode   = 0x00;        // Current instruction byte
     uint16_t fetched  = 0x0000;      // Current fetched data
-    bool     dstIsMem = false;       // Indicates if current fetched will be written in memory
-    uint16_t memDest  = 0x0000;      // Memory address for when dstIsMem = true
+    uint16_t memDest  = 0x0000;      // Memory address for instructions writing to memory (see SM83::writesMemory)
     bool     halted   = false;       // Indicates if CPU is halted (cancelled by an interrupt or reset signal)
 
     // The Register enum is used for facilitating the reading and writing of registers during the
@@ -70,35 +97,96 @@ private:
     // and therefore will always branch.
     enum class Condition { X, NC, C, NZ, Z }; // No carry, carry, not zero, zero
 
-    Register dst      = Register::X; // Current destination register for register addressing
-    Register src      = Register::X; // Current source register for register addressing
     uint8_t  temp8    = 0x00;        // An 8-bit convenience variable
     uint16_t temp16   = 0x0000;      // A 16-bit convenience variable
     uint32_t temp32   = 0x000000000; // A 32-bit convenience variable
-    uint8_t  xx       = 0x00;        // A convenience variable for decoding CB-prefixed instructions
-    uint8_t  yyy      = 0x00;        // A convenience variable for decoding CB-prefixed instructions
-    uint8_t  zzz      = 0x00;        // A convenience variable for decoding CB-prefixed instructions
+
+    // The addressing modes and operations of the opcodes (see the respective implementations below).
+    enum class AddrMode  { IMP, R, R_R, D8, R_D8, MR_D8, D16, R_D16, MR, R_MR, MR_R,
+                           R_HLI, R_HLD, HLI_R, HLD_R, HL_SPR, R_A8, A8_R, R_A16, A16_R };
+    enum class Operation { ADC, ADD, AND, CALL, CB, CCF, CP, CPL, DAA, DEC, DI, EI, HALT, INC, JP, JR, LD, LDH,
+                           NOP, OR, POP, PUSH, RET, RETI, RLA, RLCA, RRA, RRCA, RST, SBC, SCF, STOP, SUB, XOR, XXX };
 
     // Since decoding the Game Boy CPU opcodes is a pain, I've decided to use a lookup table
-    // for the following structure, which is also useful for disassembly.
+    // for the following structure, which is also useful for disassembly. The table is a
+    // compile-time constant from which a specialized handler is generated for each opcode
+    // (see SM83::handler), so it is only read at runtime for decoding blocks and disassembly.
     struct Instruction {
-        std::string name;                             // Name of opcode for disassembly
-        void        (SM83::*operate )() = nullptr;    // Opcode function pointer
-        void        (SM83::*addrmode)() = &SM83::IMP; // Addressing mode function pointer (default is implied)
-        Register    dstReg;                           // Destination register for register/memory addressing
-        Register    srcReg;                           // Source register for register/memory addressing
-        Condition   cond = Condition::X;              // For branching instructions (default to 'X'=None=true)
-        uint8_t     param;                            // For RST instructions (0x00, 0x08, 0x10, ... , or 0x38)
+        const char* name;                             // Name of opcode for disassembly
+        Operation   operate;                          // Operation
+        AddrMode    addrmode = AddrMode::IMP;         // Addressing mode (default is implied)
+        Register    dstReg   = Register::X;           // Destination register for register/memory addressing
+        Register    srcReg   = Register::X;           // Source register for register/memory addressing
+        Condition   cond     = Condition::X;          // For branching instructions (default to 'X'=None=true)
+        uint8_t     param    = 0x00;                  // For RST instructions (0x00, 0x08, 0x10, ... , or 0x38)
     };
 
-    std::vector<Instruction> lookup;                  // Instruction lookup table
-    std::vector<Instruction> cbLookup;                // CB-prefixed instruction lookup table
-    Instruction*             instruction;             // Pointer to current instruction
+    using Handler = void (*)(SM83* cpu);              // Executes one specific opcode
+
+    static const std::array<Instruction, 256> lookup; // Instruction lookup table (cold: metadata only)
+    static const std::array<Handler, 256> handlers;   // Handler of each opcode (hot)
+    static const std::array<Handler, 256> cbHandlers; // Handler of each CB-prefixed opcode (hot)
+
+    static constexpr std::array<Instruction, 256> makeLookup(); // Builds the lookup table
+    template <size_t... Op> static constexpr std::array<Handler, sizeof...(Op)> makeHandlers(std::index_sequence<Op...>);
+    template <size_t... Op> static constexpr std::array<Handler, sizeof...(Op)> makeCBHandlers(std::index_sequence<Op...>);
+    template <uint8_t Op>   static void handler(SM83* cpu);   // Addressing mode + operation of an opcode
+    template <uint8_t CbOp> static void cbHandler(SM83* cpu); // Operation of a CB-prefixed opcode
+    template <uint8_t Op>   void fetchOperands();             // Dispatches to the addressing mode of an opcode
+    template <uint8_t Op>   void operate();                   // Dispatches to the operation of an opcode
+
+    void    fetch();                                  // Fetches next instruction
+    uint8_t fetchOperand();                           // Fetches the next immediate byte of the current instruction
+    void    execute();                                // Executes current instruction
+    void    emulateCycles(int mCycles) const;         // Emulates the execution of machine (M) cycles
+    void    handleInterrupts();                       // Handles interrupts
+    int     haltedCycles() const;                     // M-cycles a halted CPU can skip in one go
+
+    // Upper bound of the T-cycles skipped at once while halted or polling. The joypad is updated by the UI thread
+    // rather than by a scheduled event, so the CPU must still look at it every now and then (see SM83::step).
+    static constexpr uint64_t MAX_SKIP_TICKS = 456; // One scanline
+
+private:
+    // Block cache ================================================================
+    // Straight-line runs of code are decoded once into blocks (see BlockCache.hpp),
+    // so that fetching an instruction doesn't have to go through the bus and the
+    // lookup table again every time it's executed.
+
+    BlockCache::Block*    block           = nullptr; // Block being executed (nullptr if none)
+    size_t                blockIdx        = 0;       // Index of the next instruction in the block
+    uint32_t              blockGeneration = 0;       // Cache generation when the block was looked up
+    const BlockCache::Op* cachedOp        = nullptr; // Current instruction, if predecoded
+    uint8_t               operandIdx      = 0;       // Next operand byte of the current instruction
+
+    const BlockCache::Op* nextCachedOp();               // Predecoded instruction at PC (nullptr if none)
+    bool                  inBlock() const;              // Does PC continue the current block?
+    bool                  enterBlock();                 // Makes the block starting at PC the current block
+    BlockCache::Block*    decodeBlock(uint16_t start);  // Decodes and caches the block starting at an address
+    static uint8_t        operandCount(const Instruction& ins); // Immediate bytes of an instruction
+    static bool           endsBlock(const Instruction& ins);    // Does an instruction end a block?
+
+private:
+    // JIT ========================================================================
+    // Hot blocks may be translated into native code (see JIT.hpp), which is run
+    // in place of the interpreter whenever the CPU enters such a block.
+
+    bool useJIT = false; // Run translated blocks (selected at runtime, see SM83::enableJIT)
+    bool runNative();    // Runs the block at PC as native code, if possible
 
-    void fetch();                                     // Fetches next instruction
-    void execute();                                   // Executes current instruction
-    void emulateCycles(int mCycles) const;            // Emulates the execution of machine (M) cycles
-    void handleInterrupts();                          // Handles interrupts
+private:
+    // Idle loops =================================================================
+    // Blocks that do nothing but poll an I/O register until it changes (e.g., wait
+    // for a certain LY) are skipped up to the point where the register may change.
+
+    bool     useIdleSkip = false; // Skip polling loops (selected at runtime, see SM83::enableIdleSkip)
+    uint64_t idleCycles  = 0;     // M-cycles skipped in polling loops so far
+
+    bool            skipIdleLoop();                                  // Skips iterations of the polling loop at PC
+    bool            atBlockStart();                                  // Is PC the start of a (current) block?
+    bool            loopsAgain(const BlockCache::Block& loop, uint8_t value) const; // Would an iteration be a no-op?
+    uint64_t        nextIORegisterChange(uint16_t addr) const;       // Earliest T-cycle a polled register may change
+    static uint16_t polledAddress(const BlockCache::Op& load);       // Address read by a polling loop
+    static uint8_t  idleLoopCycles(const BlockCache::Block& block);  // M-cycles of a polling loop's iteration
 
 private:
     // Addressing modes ===========================================================
@@ -120,12 +208,22 @@ private:
     // not only useful for disassembly, but they also made it possible to not have
     // to implement all the 512 opcodes individually in some switch statement.
     // A description of each mode is above the respective implementation.
+    //
+    // The modes (and opcodes) that depend on an opcode's registers or condition
+    // are templates over the opcode, so that these are resolved at compile time.
+
+    void IMP();                          template <uint8_t Op> void R();
+    void  D8();                          template <uint8_t Op> void R_R();
+    void D16();                          template <uint8_t Op> void MR();
+    void R_D8();                         template <uint8_t Op> void MR_D8();
+    void R_D16();                        template <uint8_t Op> void MR_R();
+    void R_HLI();                        template <uint8_t Op> void R_MR();
+    void R_HLD();                        template <uint8_t Op> void HLI_R();
+    void R_A8();                         template <uint8_t Op> void HLD_R();
+    void R_A16();                        template <uint8_t Op> void A8_R();
+    void HL_SPR();                       template <uint8_t Op> void A16_R();
 
-    void IMP();      void   R_R();    void MR_D8();    void  R_HLI();
-    void   R();      void  R_D8();    void  R_A8();    void  R_HLD();
-    void  MR();      void  R_MR();    void  A8_R();    void  HLI_R();
-    void  D8();      void  MR_R();    void R_A16();    void  HLD_R();
-    void D16();      void R_D16();    void A16_R();    void HL_SPR();
+    static constexpr bool writesMemory(AddrMode mode); // Does an addressing mode target memory (memDest)?
 
 private:
     // Opcodes =====================================================================
@@ -134,47 +232,60 @@ private:
     // above the respective implementation. The XXX opcode is used to capture
     // all unimplemented instructions.
 
-    void  ADC();     void  CPL();     void   JP();     void  RET();     void  SBC();
-    void  ADD();     void  DAA();     void   JR();     void RETI();     void  SCF();
-    void  AND();     void  DEC();     void   LD();     void RLCA();     void STOP();
-    void CALL();     void   DI();     void  LDH();     void  RLA();     void  SUB();
-    void   CB();     void   EI();     void  NOP();     void  RRA();     void   OR();
-    void  CCF();     void HALT();     void  POP();     void RRCA();     void  XOR();
-    void   CP();     void  INC();     void PUSH();     void  RST();     void  XXX();
+    void  ADC();     void  CPL();     void  SBC();     template <uint8_t Op> void  ADD();
+    void  AND();     void  DAA();     void  SCF();     template <uint8_t Op> void CALL();
+    void   CB();     void   DI();     void STOP();     template <uint8_t Op> void  DEC();
+    void  CCF();     void   EI();     void  SUB();     template <uint8_t Op> void  INC();
+    void   CP();     void HALT();     void   OR();     template <uint8_t Op> void   JP();
+    void RLCA();     void  NOP();     void  XOR();     template <uint8_t Op> void   JR();
+    void  RLA();     void PUSH();     void  XXX();     template <uint8_t Op> void   LD();
+    void RRCA();                                       template <uint8_t Op> void  LDH();
+    void  RRA();                                       template <uint8_t Op> void  POP();
+                                                       template <uint8_t Op> void  RET();
+                                                       template <uint8_t Op> void RETI();
+                                                       template <uint8_t Op> void  RST();
 
     // CB-Prefixed Opcodes =========================================================
     // These opcodes all take a minimum of 2 machine cycles to execute: One byte is
     // fetched to determine that the opcode is a CB-prefixed one, and another byte
     // is fetched to determine which CB-prefixed opcode to execute. They perform
     // bitwise operations on the Accumulator as well as on the general-purpose
-    // registers and memory location (HL).
+    // registers and memory location (HL). They are templates over the second
+    // opcode byte, which encodes the register and the bit they operate on.
+
+    template <uint8_t CbOp> void BIT();      template <uint8_t CbOp> void  SET();
+    template <uint8_t CbOp> void RES();      template <uint8_t CbOp> void  SLA();
+    template <uint8_t CbOp> void  RL();      template <uint8_t CbOp> void  SRA();
+    template <uint8_t CbOp> void RLC();      template <uint8_t CbOp> void  SRL();
+    template <uint8_t CbOp> void  RR();      template <uint8_t CbOp> void SWAP();
+    template <uint8_t CbOp> void RRC();
 
-    void BIT();      void  SET();
-    void RES();      void  SLA();
-    void  RL();      void  SRA();
-    void RLC();      void  SRL();
-    void  RR();      void SWAP();
-    void RRC();
+    static constexpr Register cbRegister(uint8_t cbOp);                // Register (or HL for (HL)) of a CB opcode
+    template <uint8_t CbOp> void writeBack(uint8_t data);              // Writes the result of a CB opcode
 
 
 private:
     // Register helper methods
-    uint16_t readReg(Register r);
-    void     writeReg(Register r, uint16_t data);
-    bool     is16Bit(Register r);
+    template <Register R> uint16_t readReg() const;
+    template <Register R> void     writeReg(uint16_t data);
+    static constexpr bool          is16Bit(Register r);
 
     // Flag helper methods
     void    setFlag(FlagSM83 flag, bool v);
     uint8_t getFlag(FlagSM83 flag) const;
-    bool    testCond(Condition cond);
+    uint8_t flags() const;                                                  // F, with pending flags derived
+    void    resolveFlags();                                                 // Stores pending flags in F
+    void    setLazyFlags(LazyOp op, uint8_t x, uint8_t y, uint16_t result); // Defers the flags of an operation
+    template <Condition Cond> bool testCond() const;
     bool    carry(uint32_t x, uint32_t y, uint32_t result, uint32_t mask);
-    bool    borrow(uint32_t x, uint32_t y, uint32_t result, uint32_t mask);
 
 private:
     Bus*              bus;
     Timer*            timer;
     InterruptHandler* intHandler;
     GB*          gameBoy;
+    BlockCache*       blockCache;
+    JIT*              jit;
 
 #if LOGGING
 private: // For testing/disassembly
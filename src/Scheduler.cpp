@@ -0,0 +1,135 @@
+#include "Scheduler.hpp"
+
+Scheduler::Scheduler() {
+    position.fill(-1);
+}
+
+Scheduler::~Scheduler() = default;
+
+/**
+ * Schedules an event at an absolute T-cycle. If the event is already pending, it is moved to the new time.
+ *
+ * @param e The event to schedule.
+ * @param when The absolute T-cycle at which the event is due.
+ */
+void Scheduler::schedule(Event e, uint64_t when) {
+    auto type = static_cast<uint8_t>(e);
+    int8_t idx = position[type];
+
+    if (idx < 0) { // Not pending yet, append to the heap
+        idx = static_cast<int8_t>(size++);
+        place(idx, { when, e });
+        siftUp(idx);
+        return;
+    }
+
+    uint64_t prev = heap[idx].when;
+    heap[idx].when = when;
+    if (when < prev)
+        siftUp(idx);
+    else
+        siftDown(idx);
+}
+
+/**
+ * Removes an event from the heap if it is pending.
+ *
+ * @param e The event to cancel.
+ */
+void Scheduler::cancel(Event e) {
+    auto type = static_cast<uint8_t>(e);
+    int8_t idx = position[type];
+    if (idx < 0)
+        return;
+
+    position[type] = -1;
+    if (idx == --size) // Was the last entry
+        return;
+
+    // Move the last entry into the hole and restore the heap property.
+    Entry last = heap[size];
+    uint64_t prev = heap[idx].when;
+    place(idx, last);
+    if (before(last, { prev, e }))
+        siftUp(idx);
+    else
+        siftDown(idx);
+}
+
+/**
+ * Checks if an event is pending.
+ *
+ * @param e The event to check.
+ * @return True if the event is scheduled.
+ */
+bool Scheduler::isScheduled(Event e) const {
+    return position[static_cast<uint8_t>(e)] >= 0;
+}
+
+/**
+ * @return The absolute T-cycle of the earliest pending event, or NEVER if no event is pending.
+ */
+uint64_t Scheduler::nextEventTime() const {
+    return size ? heap[0].when : NEVER;
+}
+
+/**
+ * Removes the earliest pending event and advances the current time to the event's time, so that
+ * the component handling the event can query now() to know when it is being woken up.
+ *
+ * @return The event that is due.
+ */
+Scheduler::Event Scheduler::popNextEvent() {
+    Entry top = heap[0];
+    cancel(top.event);
+    if (top.when > currentTick)
+        currentTick = top.when;
+    return top.event;
+}
+
+/**
+ * Advances the current time. Called by GB::emulateCycles once all events within the emulated
+ * cycles have been dispatched.
+ *
+ * @param tick The new current T-cycle.
+ */
+void Scheduler::advanceTo(uint64_t tick) {
+    currentTick = tick;
+}
+
+bool Scheduler::before(const Entry& a, const Entry& b) {
+    return a.when < b.when || (a.when == b.when && a.event < b.event);
+}
+
+void Scheduler::place(uint8_t idx, const Entry& entry) {
+    heap[idx] = entry;
+    position[static_cast<uint8_t>(entry.event)] = static_cast<int8_t>(idx);
+}
+
+void Scheduler::siftUp(uint8_t idx) {
+    Entry entry = heap[idx];
+    while (idx > 0) {
+        uint8_t parent = (idx - 1) / 2;
+        if (!before(entry, heap[parent]))
+            break;
+        place(idx, heap[parent]);
+        idx = parent;
+    }
+    place(idx, entry);
+}
+
+void Scheduler::siftDown(uint8_t idx) {
+    Entry entry = heap[idx];
+    while (true) {
+        uint8_t child = 2 * idx + 1;
+        if (child >= size)
+            break;
+        if (child + 1 < size && before(heap[child + 1], heap[child]))
+            child++;
+        if (!before(heap[child], entry))
+            break;
+        place(idx, heap[child]);
+        idx = child;
+    }
+    place(idx, entry);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "common.hpp"
+
+/**
+ * Central event scheduler keyed on the absolute T-cycle count.
+ *
+ * Rather than ticking every component on every T-cycle, each component registers the next T-cycle at which it
+ * has something observable to do (a PPU mode change, a frame sequencer step, a serial clock edge, ...).
+ * GB::emulateCycles then only wakes up the components whose events fall within the cycles being emulated.
+ *
+ * Every event type has at most one pending occurrence, so the pending events are kept in a tiny indexed binary
+ * min-heap: scheduling an event that is already pending simply moves it. Events that are due on the same T-cycle
+ * are dispatched in the order of the Event enumeration, which mirrors the order in which the components used to
+ * be ticked within a single T-cycle.
+ */
+class Scheduler {
+public:
+    Scheduler();
+    ~Scheduler();
+
+public:
+    // The events a component can register. The enumeration order doubles as the tie-breaking priority.
+    enum class Event : uint8_t {
+        timer,  // TIMA reload after an overflow (see Timer::handleEvent)
+        ppu,    // Next possible PPU interrupt request (see PPU::step)
+        apu,    // APU frame sequencer step (see APU::handleEvent)
+        serial, // Falling edge of the internal serial clock (see Serial::handleEvent)
+        dma,    // OAM DMA byte transfer (see DMA::tick)
+        count,  // Number of event types (not an event)
+    };
+
+    static constexpr uint64_t NEVER = UINT64_MAX; // Returned by nextEventTime() when nothing is scheduled
+
+public:
+    void     schedule(Event e, uint64_t when); // (Re)schedules an event at the absolute T-cycle 'when'
+    void     cancel(Event e);                  // Removes an event if it is pending
+    bool     isScheduled(Event e) const;       // Checks if an event is pending
+    uint64_t nextEventTime() const;            // T-cycle of the earliest pending event (NEVER if none)
+    Event    popNextEvent();                   // Removes the earliest pending event and advances now() to it
+
+    uint64_t now() const { return currentTick; } // The T-cycle currently being emulated
+    void     advanceTo(uint64_t tick);           // Advances now() once all due events have been dispatched
+
+private:
+    static constexpr uint8_t EVENT_COUNT = static_cast<uint8_t>(Event::count);
+
+    struct Entry {
+        uint64_t when;  // Absolute T-cycle at which the event is due
+        Event    event; // Event type
+    };
+
+    std::array<Entry, EVENT_COUNT>  heap{};     // Binary min-heap of pending events
+    std::array<int8_t, EVENT_COUNT> position{}; // Index of each event type in the heap (-1 if not pending)
+    uint8_t  size        = 0;                   // Number of pending events
+    uint64_t currentTick = 0;                   // The T-cycle currently being emulated
+
+private:
+    static bool before(const Entry& a, const Entry& b); // Heap ordering: earlier first, then enum order
+    void place(uint8_t idx, const Entry& entry);         // Stores an entry and updates its position
+    void siftUp(uint8_t idx);
+    void siftDown(uint8_t idx);
+};
@@ -1,18 +1,20 @@
 #include "Serial.hpp"
 
-Serial::Serial(InterruptHandler* ih, Timer* t)
+Serial::Serial(InterruptHandler* ih, Timer* t, Scheduler* s)
 : intHandler(ih)
-, timer(t) {}
+, timer(t)
+, scheduler(s) {}
 
 Serial::~Serial() = default;
 
 void Serial::init() {
     sb = 0x00;
     sc = 0x7E;
+    scheduler->cancel(Scheduler::Event::serial); // No transfer in progress
 }
 
 /**
- * Steps the serial transfer.
+ * Shifts a bit of the serial transfer. Called by the event scheduler on a falling edge of the internal clock.
  *
  * ------------------------------------------------------------
  * Bits       7          6 5 4 3 2       1             0
@@ -22,28 +24,69 @@ void Serial::init() {
  *
  * See https://gbdev.io/pandocs/Serial_Data_Transfer_(Link_Cable).html#serial-data-transfer-link-cable
  */
-void Serial::tick() {
-    // In Non-CGB Mode the Game Boy supplies an internal clock of 8192 Hz only
-    // (allowing to transfer about 1 KByte per second minus overhead for delays).
-    // See https://gbdev.io/pandocs/Serial_Data_Transfer_(Link_Cable).html#internal-clock
-    currBit = timer->sysClock & (1 << 8); // CPU clock / 8192 = 4194304 / 2^9 = 8192 Hz
-    transferEnable = sc & 0x80;           // SC bit 7
-    currBit &= transferEnable;
-    clockSelect = sc & 0x01;              // SC bit 0
-    currBit &= clockSelect;               // Just emulating the internal clock
+void Serial::handleEvent() {
+    sb = (sb << 1) | 1; // Shift in a 1
+    if (++shiftCount == 8) {
+        shiftCount = 0;
+        sc &= ~0x80; // Clear SC bit 7 (transfer is complete)
+        intHandler->irq(InterruptHandler::serial);
+    }
+
+    // The clock is low right after a falling edge.
+    scheduleNextEdge(false, timer->systemClock());
+}
+
+/**
+ * Must be called right before DIV is reset, as the internal serial clock is derived from the system clock.
+ * If the clock was high, resetting DIV produces a falling edge (just like it can increment TIMA).
+ */
+void Serial::onDIVReset() {
+    scheduleNextEdge(clockLevel(timer->systemClock()), 0x0000);
+}
+
+/**
+ * Computes the level of the internal serial clock for a given system clock value.
+ * In Non-CGB Mode the Game Boy supplies an internal clock of 8192 Hz only
+ * (allowing to transfer about 1 KByte per second minus overhead for delays).
+ * See https://gbdev.io/pandocs/Serial_Data_Transfer_(Link_Cable).html#internal-clock
+ *
+ * @param sysClock The system clock value.
+ * @return True if the clock is high.
+ */
+bool Serial::clockLevel(uint16_t sysClock) const {
+    bool transferEnable = sc & 0x80; // SC bit 7
+    bool clockSelect    = sc & 0x01; // SC bit 0 (just emulating the internal clock)
+    // TODO: SC bit 1 (clock speed, CGB only, just here for when I implement CGB support)
+    return transferEnable && clockSelect && (sysClock & (1 << 8)); // CPU clock / 8192 = 4194304 / 2^9 = 8192 Hz
+}
+
+/**
+ * Schedules the next falling edge of the internal serial clock, on which the next bit is shifted.
+ * Called whenever the clock may have changed: after a bit was shifted, when SC is written and when DIV is reset.
+ *
+ * @param prevLevel The level of the clock during the current T-cycle, before whatever caused the reschedule.
+ * @param sysClock The system clock value for the current T-cycle, after whatever caused the reschedule.
+ */
+void Serial::scheduleNextEdge(bool prevLevel, uint16_t sysClock) {
+    uint64_t now = scheduler->now();
 
-    clockSpeed = sc & 0x02;               // TODO: SC bit 1 (CGB only, just here for when I implement CGB support)
+    // The clock goes low on the next T-cycle (transfer disabled or DIV reset while the clock was high).
+    if (prevLevel && !clockLevel(sysClock + 1)) {
+        scheduler->schedule(Scheduler::Event::serial, now + 1);
+        return;
+    }
 
-    fallingEdge = prevBit && !currBit;
-    if (fallingEdge) {
-        sb = (sb << 1) | 1; // Shift in a 1
-        if (++shiftCount == 8) {
-            shiftCount = 0;
-            sc &= ~0x80; // Clear SC bit 7 (transfer is complete)
-            intHandler->irq(InterruptHandler::serial);
-        }
+    if ((sc & 0x81) != 0x81) { // No transfer using the internal clock
+        scheduler->cancel(Scheduler::Event::serial);
+        return;
     }
-    prevBit = currBit;
+
+    // Bit 8 of the system clock falls every 512 T-cycles. A clock that was
+    // low during the current T-cycle cannot fall on the next one, though.
+    uint16_t delay = 512 - (sysClock & 0x1FF);
+    if (delay == 1 && !prevLevel)
+        delay += 512;
+    scheduler->schedule(Scheduler::Event::serial, now + delay);
 }
 
 /**
@@ -68,10 +111,13 @@ uint8_t Serial::read(uint16_t addr) const {
  * @param data The data to write.
  */
 void Serial::write(uint16_t addr, uint8_t data) {
-    if (addr == 0xFF01)
+    if (addr == 0xFF01) {
         sb = data;
-    else if (addr == 0xFF02)
+    } else if (addr == 0xFF02) {
+        bool prevLevel = clockLevel(timer->systemClock());
         sc = data;
-    else
+        scheduleNextEdge(prevLevel, timer->systemClock()); // Starting/stopping a transfer moves the next clock edge
+    } else {
         printf("UNMAPPED Serial::write(%04X)\n", addr);
+    }
 }
\ No newline at end of file
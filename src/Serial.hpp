@@ -3,14 +3,16 @@
 #include "common.hpp"
 #include "InterruptHandler.hpp"
 #include "Timer.hpp"
+#include "Scheduler.hpp"
 
 class Serial {
 public:
-    Serial(InterruptHandler* ih, Timer* t);
+    Serial(InterruptHandler* ih, Timer* t, Scheduler* s);
     ~Serial();
 
 public:
-    void    tick();
+    void    handleEvent();  // Shifts a bit on a falling edge of the internal serial clock
+    void    onDIVReset();   // Resynchronizes the serial clock when DIV is reset (the clock is derived from it)
     void    init();
     uint8_t read(uint16_t addr) const;
     void    write(uint16_t addr, uint8_t data);
@@ -22,15 +24,13 @@ private:
 
 private:
     // Assistive variables to facilitate stepping the serial transfer
-    bool    fallingEdge    = false; // Indicates whether a selected bit has changed from 1 to 0
-    bool    prevBit        = false; // Used for detecting falling edges
-    bool    currBit        = false; // Used for detecting falling edges
-    bool    clockSelect    = false; // 0 = External clock (“slave”), 1 = Internal clock (“master”)
-    bool    clockSpeed     = false; // 0 = Normal speed clock, 1 = Double speed clock
-    bool    transferEnable = false; // Indicates whether the serial transfer is enabled according to SC bit 7
     uint8_t shiftCount     = 0x00;  // Number of bits shifted in/out of the SB register
 
+    bool clockLevel(uint16_t sysClock) const; // Level of the internal serial clock for the given system clock
+    void scheduleNextEdge(bool prevLevel, uint16_t sysClock); // Schedules the next falling edge of the serial clock
+
 private:
     InterruptHandler* intHandler; // For requesting serial interrupts
     Timer*            timer;      // For accessing the system clock
+    Scheduler*        scheduler;  // For scheduling the falling edges of the serial clock
 };
\ No newline at end of file
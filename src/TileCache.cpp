@@ -0,0 +1,22 @@
+#include "TileCache.hpp"
+
+TileCache::TileCache()
+: rows()
+, flipped() {}
+
+TileCache::~TileCache() = default;
+
+/**
+ * Decodes the tile row containing the given address again after it was written to (see PixelKernels::decodeRow).
+ *
+ * @param vram The VRAM contents (0x8000-0x9FFF).
+ * @param addr The address that was written to. Writes to the tile maps (0x9800-0x9FFF) are ignored.
+ */
+void TileCache::update(const uint8_t* vram, uint16_t addr) {
+    if (addr >= 0x8000 + TILE_COUNT * 16)
+        return;
+
+    uint16_t row = (addr - 0x8000) >> 1;
+    PixelKernels::decodeRow(vram[row * 2], vram[row * 2 + 1], rows[row].data());
+    PixelKernels::decodeRow(vram[row * 2], vram[row * 2 + 1], flipped[row].data(), true);
+}
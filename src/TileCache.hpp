@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common.hpp"
+#include "PixelKernels.hpp"
+
+/**
+ * Cache of the tiles in VRAM (0x8000-0x97FF) decoded into color indices.
+ *
+ * Each of the 384 tiles is 8 rows of 2 bytes (2bpp), which the renderers would otherwise have to take apart bit by
+ * bit every time they draw a row. Here, every row is kept as 8 color indices (leftmost pixel first), along with its
+ * horizontally mirrored variant for X-flipped sprites. VRAM is written far less often than it is drawn from, so the
+ * affected row is simply decoded again on every write to the tile data (see PPU::writeVRAM). Only the PPU writes to
+ * the cache, so other threads (the tile viewer, see UI::displayTile) can read it without modifying it.
+ */
+class TileCache {
+public:
+    TileCache();
+    ~TileCache();
+
+public:
+    using Row = std::array<uint8_t, 8>; // Color indices (0-3) of a tile row, leftmost pixel first
+
+    static constexpr uint16_t TILE_COUNT = 384; // Tiles in VRAM (0x8000-0x97FF)
+
+    // The decoded row whose low byte is at the given VRAM address (0x8000-0x97FF, even).
+    const Row& rowAt(uint16_t addr, bool xFlip = false) const {
+        uint16_t row = (addr - 0x8000) >> 1;
+        return xFlip ? flipped[row] : rows[row];
+    }
+
+    void update(const uint8_t* vram, uint16_t addr); // Decodes the row containing a VRAM address again
+
+private:
+    std::array<Row, TILE_COUNT * 8> rows;    // Rows in VRAM order
+    std::array<Row, TILE_COUNT * 8> flipped; // Horizontally mirrored rows
+};
@@ -1,12 +1,15 @@
 #include "Timer.hpp"
 
-Timer::Timer(InterruptHandler* ih)
-: intHandler(ih) {}
+#include <algorithm>
+
+Timer::Timer(InterruptHandler* ih, Scheduler* s)
+: intHandler(ih)
+, scheduler(s) {}
 
 Timer::~Timer() = default;
 
 /**
- * Advances the state of the Game Boy's timer by one T-Cycle.
+ * Advances the state of the Game Boy's timer by one T-Cycle (see Timer::sync for when this is used).
  *
  * This method emulates the behavior of the Game Boy's DIV (Divider Register) and TIMA (Timer Counter) registers,
  * incrementing them according to the rules of the original hardware's timing system. The DIV register increments
@@ -51,9 +54,12 @@ void Timer::tick() {
  * @param addr The address to read from.
  * @return The value at the specified address.
  */
-uint8_t Timer::read(uint16_t addr) const {
+uint8_t Timer::read(uint16_t addr) {
+    if (addr == 0xFF04)
+        return systemClock() >> 8; // Return upper 8-bits of the 16-bit system clock counter
+
+    sync();
     switch (addr) {
-        case 0xFF04: return sysClock >> 8; // Return upper 8-bits of the 16-bit system clock counter
         case 0xFF05: return tima;
         case 0xFF06: return tma;
         case 0xFF07: return (tac & 0x7) | 0xF8;
@@ -69,6 +75,7 @@ uint8_t Timer::read(uint16_t addr) const {
  * @param data The data to write.
  */
 void Timer::write(uint16_t addr, uint8_t data) {
+    sync();
     switch (addr) {
         case 0xFF04:
             // "When writing to DIV register the TIMA register can be increased if the counter has reached half
@@ -80,7 +87,7 @@ void Timer::write(uint16_t addr, uint8_t data) {
             // "If you write to TIMA during the cycle that TMA is being loaded to it [B],
             // the write will be ignored and TMA value will be written to TIMA instead."
             if (timaReloaded) // TIMA is reloaded with TMA during this M-Cycle
-                return;
+                break;
             tima = data;
             // "During the strange cycle [A] you can prevent the IF flag from being set and prevent the TIMA
             // from being reloaded from TMA by writing a value to TIMA. That new value will be the one that
@@ -117,6 +124,115 @@ void Timer::write(uint16_t addr, uint8_t data) {
         default:
             break;
     }
+
+    // Any of these writes can move (or cancel) the next overflow.
+    scheduleNextEvent();
+}
+
+/**
+ * Returns the system clock at the current T-cycle without catching the timer up: between two accesses,
+ * the system clock simply counts up (it can only be reset by a write to DIV, which syncs the timer).
+ *
+ * @return The 16-bit system clock counter (DIV is its upper 8 bits).
+ */
+uint16_t Timer::systemClock() const {
+    return sysClock + (scheduler->now() - lastTick);
+}
+
+/**
+ * Called by the event scheduler when TIMA is due to be reloaded with TMA (which also requests the timer interrupt),
+ * or right after a TAC write that may cause an extra increment (see Timer::scheduleNextEvent).
+ */
+void Timer::handleEvent() {
+    sync();
+    scheduleNextEvent();
+}
+
+/**
+ * Catches the timer up to the current T-cycle.
+ *
+ * Instead of running the falling edge detector on every T-cycle, the number of falling edges of the selected
+ * system clock bit is computed from the number of elapsed T-cycles (see Timer::countUp). Everything that is
+ * sensitive to the exact T-cycle goes through Timer::tick as before: the falling edge that overflows TIMA,
+ * the M-cycles during which TIMA is being reloaded, and the T-cycle following a TAC write (during which the
+ * falling edge detector still compares against the bit selected by the previous TAC value).
+ */
+void Timer::sync() {
+    uint64_t now = scheduler->now();
+    while (lastTick < now) {
+        uint64_t cycles = 0;
+        if (!timaReloading && !timaReloaded && prevBit == selectedBit())
+            cycles = std::min(now - lastTick, ticksUntilOverflow() - 1);
+
+        if (cycles == 0) { // Step exactly
+            tick();
+            lastTick++;
+        } else {
+            countUp(cycles);
+            lastTick += cycles;
+        }
+    }
+}
+
+/**
+ * Advances the system clock and TIMA by the given number of T-cycles in one go.
+ * The selected bit falls every time the bits below it (and itself) roll over, so the number of increments is
+ * simply the number of multiples of twice the selected bit that are crossed. TIMA must not overflow meanwhile.
+ *
+ * @param cycles The number of T-cycles to advance by.
+ */
+void Timer::countUp(uint64_t cycles) {
+    if (tac & (1 << 2)) {
+        uint32_t period = clockSelectToBit[tac & 0x3] << 1;
+        tima += ((sysClock & (period - 1)) + cycles) / period;
+    }
+    sysClock += cycles; // The system clock wraps around at a multiple of every period
+    prevBit = selectedBit();
+}
+
+/**
+ * @return True if the bit selected by TAC is set in the system clock and the timer is enabled.
+ */
+bool Timer::selectedBit() const {
+    return (sysClock & clockSelectToBit[tac & 0x3]) && (tac & (1 << 2));
+}
+
+/**
+ * Computes the number of T-cycles until the falling edge that overflows TIMA, assuming nothing is written to the
+ * timer in the meantime (every write reschedules the next event anyway).
+ *
+ * @return The number of T-cycles until TIMA overflows (at least 1), or Scheduler::NEVER if the timer is disabled.
+ */
+uint64_t Timer::ticksUntilOverflow() const {
+    if (!(tac & (1 << 2)))
+        return Scheduler::NEVER;
+
+    uint32_t period = clockSelectToBit[tac & 0x3] << 1;
+    uint64_t firstEdge = period - (sysClock & (period - 1));
+    return firstEdge + static_cast<uint64_t>(0xFF - tima) * period;
+}
+
+/**
+ * Registers the next T-cycle at which the timer requests an interrupt, i.e., when TIMA is reloaded with TMA
+ * one M-cycle after overflowing. Right after a TAC write, the falling edge detector may see an edge that the
+ * analytic computation doesn't know about, so the timer is simply woken up again on the next T-cycle.
+ */
+void Timer::scheduleNextEvent() {
+    if (timaReloading) {
+        scheduler->schedule(Scheduler::Event::timer, lastTick + (4 - ticksSinceOverflow));
+        return;
+    }
+
+    if (prevBit != selectedBit()) {
+        scheduler->schedule(Scheduler::Event::timer, lastTick + 1);
+        return;
+    }
+
+    uint64_t overflow = ticksUntilOverflow();
+    if (overflow == Scheduler::NEVER)
+        scheduler->cancel(Scheduler::Event::timer);
+    else
+        scheduler->schedule(Scheduler::Event::timer, lastTick + overflow + 4);
 }
 
 /**
@@ -2,19 +2,21 @@
 
 #include "common.hpp"
 #include "InterruptHandler.hpp"
+#include "Scheduler.hpp"
 
 class Timer {
     friend class SM83;   // CPU can directly modify the DIV register (when bypassing boot ROM and manually resetting)
-    friend class Serial; // Needs access to system clock
 
 public:
-    Timer(InterruptHandler* ih);
+    Timer(InterruptHandler* ih, Scheduler* s);
     ~Timer();
 
 public:
-    void    tick();
-    uint8_t read(uint16_t addr) const;
-    void    write(uint16_t addr, uint8_t data);
+    void     handleEvent(); // Catches up to a TIMA reload, which requests the timer interrupt
+    uint8_t  read(uint16_t addr);
+    void     write(uint16_t addr, uint8_t data);
+    uint16_t systemClock() const; // The system clock at the current T-cycle (DIV is its upper 8 bits)
+    uint8_t  readDIV() const { return systemClock() >> 8; }
 
 private:
     // Timer Registers
@@ -34,6 +36,7 @@ private:
     uint8_t ticksSinceOverflow = 0x00;  // Number of ticks since TIMA overflowed (reload TMA after 4 ticks)
     bool    timaReloaded       = false; // Indicates whether TIMA has been reloaded with TMA during current M-Cycle
     uint8_t ticksAfterReload   = 0x00;  // Number of ticks since TIMA was reloaded
+    uint64_t lastTick          = 0;     // The T-cycle up to which the timer has been advanced (see Timer::sync)
 
     // Maps clockSelect to a corresponding bit as specified by TAC bits 0-1. A change from 1 to 0 in the selected bit
     // represents a falling edge, indicating the completion of the number of clock cycles specified by clockSelect,
@@ -45,9 +48,18 @@ private:
         1 << 7   // clockSelect = 0b11 -> 16384  Hz (CPU clock / 256  = 4194304 / 2^8  = 16384  Hz)
     };
 
+    void tick();                    // Advances the timer by a single T-cycle
     void updateDIV(uint16_t value); // Updates the DIV register
     void detectFallingEdge();       // Falling edge detector, may increment TIMA
 
+    // Lazy evaluation: the timer is only advanced when its registers are accessed or when TIMA is reloaded.
+    void     sync();                     // Catches the timer up to the current T-cycle
+    void     countUp(uint64_t cycles);   // Advances the system clock and TIMA in bulk (no overflow in between)
+    bool     selectedBit() const;        // Current output of the multiplexer (selected bit AND timer enable)
+    uint64_t ticksUntilOverflow() const; // T-cycles until the falling edge that overflows TIMA (NEVER if disabled)
+    void     scheduleNextEvent();        // Registers the next TIMA reload with the scheduler
+
 private:
     InterruptHandler* intHandler;   // For requesting timer interrupts
+    Scheduler*        scheduler;    // For registering the next TIMA reload
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "UI.hpp"
 #include "GB.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 // Constants defining the dimensions for the main and debug screens.
 constexpr int SCALE = 4; // Scaling factor for rendering tiles
 constexpr int GB_SCREEN_WIDTH  = 160 * SCALE;
@@ -24,28 +27,29 @@ UI::UI(Bus* b, PPU* p, GB* gb, Joypad* j)
     SDL_Init(SDL_INIT_VIDEO);
     TTF_Init();
 
+    // Wake the main loop up as soon as the PPU publishes a frame, instead of having it poll for one.
+    // SDL_PushEvent is safe to call from the CPU thread.
+    frameEvent = SDL_RegisterEvents(1);
+    if (frameEvent != NO_FRAME_EVENT) {
+        ppu->frameBuffer.setNotify([](void* ui) {
+            SDL_Event e = {};
+            e.type = static_cast<UI*>(ui)->frameEvent;
+            SDL_PushEvent(&e);
+        }, this);
+    }
+
     // Create the main gbWindow and gbRenderer with the specified dimensions.
     SDL_CreateWindowAndRenderer(GB_SCREEN_WIDTH, GB_SCREEN_HEIGHT, 0, &gbWindow, &gbRenderer);
 
-    // Create an SDL surface for the GB window.
-    gbScreen = SDL_CreateRGBSurface(
-        0,                  // Flags
-        GB_SCREEN_WIDTH,    // Width of the surface
-        GB_SCREEN_HEIGHT,   // Height of the surface
-        32,                 // Bit depth (32 bits for ARGB format)
-        0x00FF0000,         // Red component bit mask
-        0x0000FF00,         // Green component bit mask
-        0x000000FF,         // Blue component bit mask
-        0xFF000000          // Alpha component bit mask
-    );
-
-    // Create an SDL texture for the GB renderer.
+    // Create an SDL texture for the GB renderer, the size of the LCD. Frames are copied into it as they are and the
+    // renderer scales it up to the window, keeping the pixels sharp.
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
     gbTexture = SDL_CreateTexture(
         gbRenderer,                     // Renderer
         SDL_PIXELFORMAT_ARGB8888,       // Pixel format (32-bit ARGB)
         SDL_TEXTUREACCESS_STREAMING,    // Access pattern (streaming for frequent updates)
-        GB_SCREEN_WIDTH,                // Texture width
-        GB_SCREEN_HEIGHT                // Texture height
+        LCD::X_RESOLUTION,              // Texture width
+        LCD::Y_RESOLUTION               // Texture height
     );
 
 
@@ -96,40 +100,22 @@ UI::~UI() {
 }
 
 /**
- * SDL2Timing namespace for SDL2 timing functions.
- * These functions are used for timing the main loop and rendering.
- */
-namespace SDL2Timing {
-    // Waits for the specified number of milliseconds.
-    void delay(std::chrono::milliseconds duration) { SDL_Delay(static_cast<uint32_t>(duration.count())); }
-
-    // Returns the number of milliseconds since SDL2 was initialized.
-    uint32_t getTicks() { return SDL_GetTicks(); }
-}
-
-/**
- * Updates the main gbScreen with the current state of the PPU's video buffer.
+ * Updates the main window with the current state of the PPU's video buffer.
  */
 void UI::update() {
-    // Define a rectangle covering the entire gbScreen.
-    SDL_Rect rect;
-    rect.x = rect.y = 0;
-    rect.w = rect.h = 0;
-
-    // Loop through each pixel in the video buffer and render it on the gbScreen.
-    // `ly` is the current scanline being rendered.
-    for (int ly = 0; ly < LCD::Y_RESOLUTION; ly++) {
-        for (int lx = 0; lx < LCD::X_RESOLUTION; lx++) {
-            rect.x = lx * SCALE;      // Horizontal position, accounting for scale
-            rect.y = ly * SCALE;      // Vertical position, accounting for scale
-            rect.w = rect.h = SCALE;  // Size of the pixel (scaled)
-
-            // Fill the rectangle on the gbScreen with the corresponding color.
-            SDL_FillRect(gbScreen, &rect, ppu->videoBuffer[lx + (ly * LCD::X_RESOLUTION)]);
-        }
+    // Take the newest frame completed by the PPU (see FrameBuffer.hpp).
+    const FrameBuffer::Frame& frame = ppu->frameBuffer.acquire();
+
+    // Copy the frame straight into the texture, row by row since the texture's pitch may be padded.
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(gbTexture, nullptr, &pixels, &pitch) == 0) {
+        for (int ly = 0; ly < LCD::Y_RESOLUTION; ly++)
+            std::memcpy(static_cast<uint8_t*>(pixels) + ly * pitch, &frame[ly * LCD::X_RESOLUTION],
+                        LCD::X_RESOLUTION * sizeof(uint32_t));
+        SDL_UnlockTexture(gbTexture);
     }
 
-    SDL_UpdateTexture(gbTexture, nullptr, gbScreen->pixels, gbScreen->pitch);
     SDL_RenderClear(gbRenderer);
 
     // Define the destination rectangle for rendering the texture
@@ -143,17 +129,43 @@ void UI::update() {
     SDL_RenderCopy(gbRenderer, gbTexture, nullptr, &dstRect);
 
     SDL_RenderPresent(gbRenderer);
+}
 
-    updateDebugWindow();
+/**
+ * @return How long the main loop can sleep waiting for events: until the next debug window refresh if it is shown, or
+ *         IDLE_TIMEOUT_MS. Frames and input wake it up earlier.
+ */
+uint32_t UI::idleTimeout() const {
+    if (frameEvent == NO_FRAME_EVENT)
+        return 1; // Frames can't wake the main loop up, so it has to poll for them
+    if (!debugShown)
+        return IDLE_TIMEOUT_MS;
+
+    uint32_t elapsed = SDL_GetTicks() - lastDebugRefresh;
+    return elapsed >= debugRefreshMs ? 0 : std::min(debugRefreshMs - elapsed, IDLE_TIMEOUT_MS);
 }
 
 /**
  * Handles SDL events, such as window close events and key presses.
+ * The main loop sleeps in here until the first event arrives, which includes the PPU publishing a frame (see UI::UI).
+ *
+ * @param timeoutMs How long to wait for the first event at most (0 to only handle pending events).
  */
-void UI::handleEvents() {
+void UI::handleEvents(uint32_t timeoutMs) {
     SDL_Event e;
-    while (SDL_PollEvent(&e) > 0) {
-        if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE) {
+    if (!SDL_WaitEventTimeout(&e, static_cast<int>(timeoutMs)))
+        return;
+
+    do {
+        if (e.type == frameEvent) {
+            // Only wakes the main loop up, which then presents the frame.
+        } else if (e.type == SDL_WINDOWEVENT && e.window.windowID == SDL_GetWindowID(debugWindow)) {
+            // Closing the debug window only hides it, and it is drawn again in full once it's uncovered.
+            if (e.window.event == SDL_WINDOWEVENT_CLOSE)
+                showDebugWindow(false);
+            else if (e.window.event == SDL_WINDOWEVENT_EXPOSED)
+                debugRedrawAll = true;
+        } else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE) {
             if (gameBoy->cartridge->needsToSave()) {
                 gameBoy->cartridge->save();
                 std::cout << "Saved cartridge data" << std::endl;
@@ -180,6 +192,74 @@ void UI::handleEvents() {
             if (key == SDLK_z)      joypad->a = true;
             if (key == SDLK_x)      joypad->b = true;
 
+            // The following settings are read by the CPU thread, so they are changed there, between two frames.
+            SM83* cpu = gameBoy->cpu;
+
+            // Switch between the JIT and the interpreter.
+            if (key == SDLK_j) {
+                gameBoy->post([cpu] {
+                    cpu->enableJIT(!cpu->isJITEnabled());
+                    std::cout << (cpu->isJITEnabled() ? "JIT enabled" : "Interpreter enabled") << std::endl;
+                });
+            }
+
+            // Toggle skipping polling loops.
+            if (key == SDLK_i) {
+                gameBoy->post([cpu] {
+                    cpu->enableIdleSkip(!cpu->isIdleSkipEnabled());
+                    std::cout << "Idle loop skipping " << (cpu->isIdleSkipEnabled() ? "enabled" : "disabled")
+                              << std::endl;
+                });
+            }
+
+            // Switch between the scanline renderer and the pixel FIFO.
+            if (key == SDLK_l) {
+                gameBoy->post([ppu = ppu] {
+                    ppu->enableScanlineRenderer(!ppu->isScanlineRendererEnabled());
+                    std::cout << (ppu->isScanlineRendererEnabled() ? "Scanline renderer enabled" : "Pixel FIFO enabled")
+                              << std::endl;
+                });
+            }
+
+            // Cycle the frame skip through 0, 1, 3 and 7 frames skipped after each drawn one, then through only drawing
+            // the frames the UI requests (see GB::emuRun).
+            if (key == SDLK_f) {
+                gameBoy->post([ppu = ppu] {
+                    uint32_t skip = ppu->getFrameSkip();
+                    if (skip == 7) {
+                        ppu->setFrameSkip(PPU::SKIP_UNREQUESTED);
+                        ppu->requestFrame(); // In case the UI's last request was ignored
+                        std::cout << "Frame skip: unrequested" << std::endl;
+                    } else {
+                        ppu->setFrameSkip(skip > 7 ? 0 : skip * 2 + 1);
+                        std::cout << "Frame skip: " << ppu->getFrameSkip() << std::endl;
+                    }
+                });
+            }
+
+            // Cycle the frame pacing through audio, precise, speed and uncapped.
+            if (key == SDLK_p) {
+                gameBoy->post([pacer = gameBoy->pacer] {
+                    FramePacer::Mode mode = pacer->getMode();
+                    pacer->setMode(mode == FramePacer::Mode::audio   ? FramePacer::Mode::precise :
+                                   mode == FramePacer::Mode::precise ? FramePacer::Mode::speed   :
+                                   mode == FramePacer::Mode::speed   ? FramePacer::Mode::uncapped :
+                                                                       FramePacer::Mode::audio);
+                    std::cout << "Frame pacing: " << FramePacer::modeName(pacer->getMode()) << std::endl;
+                });
+            }
+
+            // Show or hide the debug window.
+            if (key == SDLK_d)
+                showDebugWindow(!debugShown);
+
+            // Cycle the debug window through the tile data, the BG tile map and OAM.
+            if (key == SDLK_v) {
+                setDebugView(debugView == DebugView::tiles ? DebugView::bgMap :
+                             debugView == DebugView::bgMap ? DebugView::oam : DebugView::tiles);
+                showDebugWindow(true);
+            }
+
         } else if (e.type == SDL_KEYUP) {
             auto key = e.key.keysym.sym;
 
@@ -192,7 +272,7 @@ void UI::handleEvents() {
             if (key == SDLK_z)      joypad->a = false;
             if (key == SDLK_x)      joypad->b = false;
         }
-    }
+    } while (SDL_PollEvent(&e) > 0);
 }
 
 // Palette colors for rendering tiles (white, light gray, dark gray, black).
@@ -205,74 +285,194 @@ static std::array<uint32_t, 4> tilePalette = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF55555
  * See: https://www.huderlem.com/demos/gameboy2bpp.html
  *
  * @param surface SDL surface to render the tile on
- * @param tileIdx Index of the tile to render
+ * @param tileIdx Index of the tile to render (0-383)
  * @param posX Horizontal position of the tile on the surface
  * @param posY Vertical position of the tile on the surface
+ * @param scale Size of a tile pixel on the surface
+ * @param xFlip Whether to mirror the tile horizontally (for sprites)
+ * @param yFlip Whether to mirror the tile vertically (for sprites)
  */
-void UI::displayTile(SDL_Surface* surface, uint16_t currTileNum, int posX, int posY) {
-    SDL_Rect tileRect;
-
-    for (int tileY = 0; tileY < 16; tileY += 2) {
-        // Read two bytes representing the color data for 8 pixels (2 bits per pixel => 16 bytes).
+void UI::displayTile(SDL_Surface* surface, uint16_t tileIdx, int posX, int posY, int scale, bool xFlip, bool yFlip) {
+    for (int tileY = 0; tileY < 8; tileY++) {
+        // Take the already decoded row (8 color indices) from the PPU's tile cache and convert it to colors.
         // Tile data is stored in VRAM in the memory area at $8000-$97FF.
-        uint8_t loByte = ppu->readVRAM(0x8000 + (currTileNum * 16) + (tileY + 0));
-        uint8_t hiByte = ppu->readVRAM(0x8000 + (currTileNum * 16) + (tileY + 1));
-
-        // Iterate over each bit in the bytes (from MSB to LSB) to determine the color of each pixel.
-        for (int bitPos = 7; bitPos >= 0; bitPos--) {
-            // Extract and combine the higher and lower bits of the two-bitPos color code for each pixel.
-            // Note: Double negation `!!` normalizes the operand (the bit in this case) to either 0 or 1
-            uint8_t colorIdx = !!(loByte & (1 << bitPos)) << 1 | // high bit from loByte
-                               !!(hiByte & (1 << bitPos)) << 0;  // low bit from hiByte
-
-            // Calculate the position and size of the pixel on the surface.
-            tileRect.x = posX + ((7 - bitPos) * SCALE);
-            tileRect.y = posY + (tileY / 2 * SCALE);
-            tileRect.w = SCALE;
-            tileRect.h = SCALE;
-
-            // Fill the rectangle on the surface with the corresponding color.
-            SDL_FillRect(surface, &tileRect, tilePalette[colorIdx]);
+        int rowY = yFlip ? 7 - tileY : tileY;
+        const TileCache::Row& row = ppu->tileCache.rowAt(0x8000 + (tileIdx * 16) + (rowY * 2), xFlip);
+        std::array<uint32_t, 8> colors;
+        PixelKernels::applyPalette(row.data(), row.size(), tilePalette, colors.data());
+
+        // Write the row straight into the surface, each pixel repeated 'scale' times in both directions.
+        for (int y = 0; y < scale; y++) {
+            auto* line = static_cast<uint8_t*>(surface->pixels) + (posY + tileY * scale + y) * surface->pitch;
+            uint32_t* dst = reinterpret_cast<uint32_t*>(line) + posX;
+            for (int x = 0; x < 8; x++)
+                std::fill_n(dst + x * scale, scale, colors[x]);
         }
     }
 }
 
 /**
- * Updates the debug window by rendering the Game Boy's VRAM tiles.
- * This is used for debugging and visualization of the game's tile data.
+ * Redraws the tiles that changed in VRAM, arranged in a 24x16 grid (VRAM can store 384 tiles).
+ *
+ * @param redrawAll Whether to draw every tile, e.g. after switching to this view.
+ */
+void UI::drawTileView(bool redrawAll) {
+    for (uint16_t tile = 0; tile < TileCache::TILE_COUNT; tile++) {
+        if (!redrawAll && !DirtyBits<TileCache::TILE_COUNT>::test(dirtyTiles, tile))
+            continue;
+
+        // Each tile is followed by a 1-pixel gap (scaled).
+        displayTile(debugScreen, tile, (tile % 16) * 9 * SCALE, (tile / 16) * 9 * SCALE, SCALE);
+        debugChanged = true;
+    }
+}
+
+/**
+ * Redraws the entries of the BG tile map selected in LCDC whose tile number or tile data changed, as a 256x256
+ * image (the whole background the screen scrolls over) at half the tile viewer's scale.
+ *
+ * @param redrawAll Whether to draw every entry, e.g. after switching to this view or to another tile map.
+ */
+void UI::drawBGMapView(bool redrawAll) {
+    constexpr int MAP_SCALE = SCALE / 2;
+    constexpr int MAP_X = (DEBUG_SCREEN_WIDTH + (16 * SCALE) - 256 * MAP_SCALE) / 2;
+    constexpr int MAP_Y = (DEBUG_SCREEN_HEIGHT + (64 * SCALE) - 256 * MAP_SCALE) / 2;
+
+    uint16_t mapArea  = ppu->lcd->readLCDC(LCD::bgTileMapArea);
+    uint16_t dataArea = ppu->lcd->readLCDC(LCD::bgwTileDataArea);
+
+    for (uint16_t entry = 0; entry < 32 * 32; entry++) {
+        // Tiles are numbered from 0x8000, or from 0x9000 (signed) in the 0x8800 addressing mode.
+        uint8_t  tileNum = ppu->vram[mapArea - 0x8000 + entry];
+        uint16_t tile    = dataArea == 0x8800 ? static_cast<int8_t>(tileNum) + 256 : tileNum;
+
+        if (!redrawAll && !DirtyBits<0x0800>::test(dirtyMap, mapArea - 0x9800 + entry) &&
+            !DirtyBits<TileCache::TILE_COUNT>::test(dirtyTiles, tile))
+            continue;
+
+        displayTile(debugScreen, tile, MAP_X + (entry % 32) * 8 * MAP_SCALE, MAP_Y + (entry / 32) * 8 * MAP_SCALE,
+                    MAP_SCALE);
+        debugChanged = true;
+    }
+}
+
+/**
+ * Redraws the sprites whose OAM entry or tile data changed, in an 8x5 grid in OAM order, with their flips applied.
+ *
+ * @param redrawAll Whether to draw every sprite, e.g. after switching to this view or to another sprite height.
+ */
+void UI::drawOAMView(bool redrawAll) {
+    constexpr int SLOT_WIDTH  = (DEBUG_SCREEN_WIDTH + (16 * SCALE)) / 8;
+    constexpr int SLOT_HEIGHT = 24 * SCALE;
+    constexpr int GRID_Y      = (DEBUG_SCREEN_HEIGHT + (64 * SCALE) - 5 * SLOT_HEIGHT) / 2;
+
+    bool tall = ppu->lcd->readLCDC(LCD::objHeight) == 16;
+
+    for (uint8_t i = 0; i < ppu->oam.size(); i++) {
+        const PPU::Sprite& sprite = ppu->oam[i];
+
+        // In 8x16 mode, the sprite is made of tileNum & 0xFE (top) and tileNum | 1 (bottom), swapped when Y-flipped.
+        uint8_t top    = tall ? sprite.tileNum & 0xFE : sprite.tileNum;
+        uint8_t bottom = top | 1;
+        if (tall && sprite.attributes.yFlip)
+            std::swap(top, bottom);
+
+        if (!redrawAll && !DirtyBits<0x0028>::test(dirtySprites, i) &&
+            !DirtyBits<TileCache::TILE_COUNT>::test(dirtyTiles, top) &&
+            !(tall && DirtyBits<TileCache::TILE_COUNT>::test(dirtyTiles, bottom)))
+            continue;
+
+        int x = (i % 8) * SLOT_WIDTH + (SLOT_WIDTH - 8 * SCALE) / 2;
+        int y = GRID_Y + (i / 8) * SLOT_HEIGHT;
+        SDL_Rect slot = { x, y, 8 * SCALE, 16 * SCALE };
+        SDL_FillRect(debugScreen, &slot, 0xFF111111);
+
+        displayTile(debugScreen, top, x, y, SCALE, sprite.attributes.xFlip, sprite.attributes.yFlip);
+        if (tall)
+            displayTile(debugScreen, bottom, x, y + (8 * SCALE), SCALE, sprite.attributes.xFlip,
+                        sprite.attributes.yFlip);
+        debugChanged = true;
+    }
+}
+
+/**
+ * Updates the debug window with the parts of VRAM and OAM the CPU wrote since the last refresh (see PPU::dirtyTiles).
+ * Only what changed in the current view is drawn again, and the window is only refreshed as often as set with
+ * setDebugRefreshRate, regardless of how fast frames are emulated. Nothing is done while the window is hidden.
  */
 void UI::updateDebugWindow() {
-    // Initialize variables for tracking the position where tiles are drawn on the debug gbScreen.
-    int drawPosX = 0, drawPosY = 0;
-    int currTileNum = 0;
-
-    // Define a rectangle covering the entire debug gbScreen.
-    SDL_Rect rect;
-    rect.x = rect.y = 0;
-    rect.w = debugScreen->w;
-    rect.h = debugScreen->h;
-    SDL_FillRect(debugScreen, &rect, 0xFF111111);
-
-    // VRAM can store 384 tiles, arranged in a 24x16 grid for debug visualization.
-    for (int y = 0; y < 24; y++) {
-        for (int x = 0; x < 16; x++) {
-            // Display each tile on the debug gbScreen at the calculated position.
-            displayTile(debugScreen, currTileNum, drawPosX + (x * SCALE), drawPosY + (y * SCALE));
-
-            // Move to the next tile position horizontally.
-            drawPosX += (8 * SCALE);
-            currTileNum++;
-        }
-        // Move to the next row and reset horizontal position.
-        drawPosY += (8 * SCALE);
-        drawPosX = 0;
+    uint32_t now = SDL_GetTicks();
+    if (!debugShown || now - lastDebugRefresh < debugRefreshMs)
+        return;
+    lastDebugRefresh = now;
+
+    dirtyTiles   = ppu->dirtyTiles.take();
+    dirtyMap     = ppu->dirtyMap.take();
+    dirtySprites = ppu->dirtySprites.take();
+
+    // The views depend on the tile map, the tile data addressing mode and the sprite height selected in LCDC.
+    uint8_t lcdc = (ppu->lcd->readLCDC(LCD::bgTileMapArea) == 0x9C00) |
+                   (ppu->lcd->readLCDC(LCD::bgwTileDataArea) == 0x8000) << 1 |
+                   (ppu->lcd->readLCDC(LCD::objHeight) == 16) << 2;
+    bool redrawAll = debugRedrawAll || lcdc != debugLCDC;
+    debugRedrawAll = false;
+    debugLCDC      = lcdc;
+
+    if (redrawAll) {
+        SDL_FillRect(debugScreen, nullptr, 0xFF111111);
+        debugChanged = true;
+    }
+
+    switch (debugView) {
+        case DebugView::tiles: drawTileView(redrawAll);  break;
+        case DebugView::bgMap: drawBGMapView(redrawAll); break;
+        case DebugView::oam:   drawOAMView(redrawAll);   break;
     }
 
-    // Update the gbTexture with the rendered pixel data from the debug gbScreen.
+    if (!debugChanged)
+        return;
+    debugChanged = false;
+
+    // Update the debugTexture with the rendered pixel data from the debugScreen.
     SDL_UpdateTexture(debugTexture, nullptr, debugScreen->pixels, debugScreen->pitch);
 
-    // Render the updated gbTexture to the debug gbRenderer.
+    // Render the updated debugTexture to the debugRenderer.
     SDL_RenderClear(debugRenderer);
     SDL_RenderCopy(debugRenderer, debugTexture, nullptr, nullptr);
     SDL_RenderPresent(debugRenderer);
-}
\ No newline at end of file
+}
+
+/**
+ * Shows or hides the debug window. While hidden, it isn't drawn at all.
+ *
+ * @param show Whether to show the debug window.
+ */
+void UI::showDebugWindow(bool show) {
+    if (show == debugShown)
+        return;
+
+    debugShown = show;
+    if (show) {
+        SDL_ShowWindow(debugWindow);
+        debugRedrawAll = true;
+    } else {
+        SDL_HideWindow(debugWindow);
+    }
+}
+
+/**
+ * Switches the debug window to another view, drawn in full on the next refresh.
+ *
+ * @param view The view to show.
+ */
+void UI::setDebugView(DebugView view) {
+    debugView      = view;
+    debugRedrawAll = true;
+}
+
+/**
+ * @param hz Debug window refreshes per second (at least 1).
+ */
+void UI::setDebugRefreshRate(uint32_t hz) {
+    debugRefreshMs = 1000 / std::max<uint32_t>(hz, 1);
+}
@@ -15,19 +15,38 @@ public:
     ~UI();
 
 public:
-    void handleEvents();
-    void update();
+    void     handleEvents(uint32_t timeoutMs = 0); // Waits up to timeoutMs for an event, then handles all pending ones
+    void     update();
+    uint32_t idleTimeout() const;                  // How long the main loop may wait for events (see GB::emuRun)
+
+public:
+    // What the debug window shows: the tile data, the displayed BG tile map, or the sprites in OAM.
+    enum class DebugView { tiles, bgMap, oam };
+
+    void updateDebugWindow();              // Redraws what changed since the last refresh, at most at the refresh rate
+    void showDebugWindow(bool show);
+    bool isDebugWindowShown() const { return debugShown; }
+    void setDebugView(DebugView view);
+    void setDebugRefreshRate(uint32_t hz); // Refreshes per second, independent of the emulation speed
+
+private:
+    void drawTileView(bool redrawAll);
+    void drawBGMapView(bool redrawAll);
+    void drawOAMView(bool redrawAll);
+    void displayTile(SDL_Surface *surface, uint16_t tileIdx, int x, int y, int scale, bool xFlip = false,
+                     bool yFlip = false);
 
 private:
-    void updateDebugWindow();
-    void displayTile(SDL_Surface *surface, uint16_t tileIdx, int x, int y);
+    static constexpr uint32_t IDLE_TIMEOUT_MS = 100;        // Longest wait for events when nothing is due
+    static constexpr uint32_t NO_FRAME_EVENT  = UINT32_MAX; // SDL_RegisterEvents failed
+
+    uint32_t frameEvent = NO_FRAME_EVENT; // SDL event pushed by the CPU thread when the PPU publishes a frame
 
 private:
     // Main window
     SDL_Window*   gbWindow   = nullptr;
     SDL_Renderer* gbRenderer = nullptr;
     SDL_Texture*  gbTexture  = nullptr;
-    SDL_Surface*  gbScreen   = nullptr;
 
 private:
     // For debugging
@@ -36,6 +55,19 @@ private:
     SDL_Texture*  debugTexture  = nullptr;
     SDL_Surface*  debugScreen   = nullptr;
 
+    DebugView debugView        = DebugView::tiles;
+    bool      debugShown       = true;
+    bool      debugRedrawAll   = true;      // Set when the debug surface can't be updated incrementally
+    bool      debugChanged     = false;     // Set when the debug surface was drawn on since it was last presented
+    uint8_t   debugLCDC        = 0;         // The LCDC bits the debug surface was drawn with (map, data area, height)
+    uint32_t  debugRefreshMs   = 1000 / 30; // Minimum time between two refreshes of the debug window
+    uint32_t  lastDebugRefresh = 0;
+
+    // VRAM and OAM changes taken from the PPU for the current refresh (see DirtyBits)
+    DirtyBits<TileCache::TILE_COUNT>::Snapshot dirtyTiles;
+    DirtyBits<0x0800>::Snapshot                dirtyMap;
+    DirtyBits<0x0028>::Snapshot                dirtySprites;
+
 private:
     // Devices connected to the UI
     GB* gameBoy;
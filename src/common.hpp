@@ -11,11 +11,29 @@
 #include <thread>
 #include <chrono>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
 //#define NO_IMPL { std::cerr << "NOT YET IMPLEMENTED" << std::endl; std::exit(-5); }
 
 static std::thread cpuThread;
 
-namespace SDL2Timing {
-    void delay(std::chrono::milliseconds duration);
-    uint32_t getTicks();
-}
\ No newline at end of file
+/**
+ * @param bits A non-zero set of bits.
+ * @return The index of its lowest set bit (e.g. to iterate over the set bits from the lowest).
+ */
+inline int lowestSetBit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    int index = 0;
+    for (; !(bits & 1); bits >>= 1)
+        index++;
+    return index;
+#endif
+}
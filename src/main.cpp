@@ -1,8 +1,45 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 #include "GB.hpp"
 
-int main() {
+int main(int argc, char* argv[]) {
     GB e;
+
+    // --jit: Run hot blocks as native code instead of interpreting them (see JIT.hpp).
+    // --idle-skip: Skip the iterations of loops polling LY, STAT, IF, DIV or the joypad (see SM83::skipIdleLoop).
+    // --scanline: Draw whole scanlines at once instead of pushing pixels through the FIFO (see PPU::renderScanline).
+    // --frame-skip N: Only draw one frame out of N + 1, keeping the timing of the others (see PPU::beginFrame).
+    // --frame-skip unrequested: Only draw the frames the UI is ready to show (see PPU::SKIP_UNREQUESTED).
+    // --pacing MODE: Pace frames with 'audio' (default), 'precise', 'speed' or 'uncapped' (see FramePacer).
+    // --speed X: Run X times as fast as a Game Boy with the 'precise' and 'speed' pacing.
+    // --audio-latency MS: Keep MS milliseconds of audio buffered instead of 40 (see APU::setAudioLatency).
+    // --no-debug: Start with the debug window (tiles, BG map, OAM) hidden.
+    // --debug-refresh HZ: Refresh the debug window HZ times per second instead of 30 (see UI::updateDebugWindow).
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--jit") == 0)
+            e.cpu->enableJIT(true);
+        else if (std::strcmp(argv[i], "--idle-skip") == 0)
+            e.cpu->enableIdleSkip(true);
+        else if (std::strcmp(argv[i], "--scanline") == 0)
+            e.ppu->enableScanlineRenderer(true);
+        else if (std::strcmp(argv[i], "--frame-skip") == 0 && i + 1 < argc) {
+            const char* skip = argv[++i];
+            e.ppu->setFrameSkip(std::strcmp(skip, "unrequested") == 0 ? PPU::SKIP_UNREQUESTED
+                                                                       : std::strtoul(skip, nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--pacing") == 0 && i + 1 < argc)
+            e.pacer->setMode(FramePacer::modeFromName(argv[++i]));
+        else if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+            e.pacer->setSpeed(std::strtod(argv[++i], nullptr));
+        else if (std::strcmp(argv[i], "--audio-latency") == 0 && i + 1 < argc)
+            e.apu->setAudioLatency(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--no-debug") == 0)
+            e.ui->showDebugWindow(false);
+        else if (std::strcmp(argv[i], "--debug-refresh") == 0 && i + 1 < argc)
+            e.ui->setDebugRefreshRate(std::strtoul(argv[++i], nullptr, 10));
+    }
+
     e.emuRun();
 
     return 0;